@@ -29,7 +29,20 @@
 
 namespace fltk {
 
+class BrowserHeights;
+class BrowserRows;
+class BrowserSort;
+class BrowserLabels;
+
+/** Returns the text to sort an item by for a column, see Browser::sort_key() */
+typedef const char* (*Browser_Key_Cb)(Widget* item, int column, void* arg);
+/** Returns whether to show an item, see Browser::filter_match() */
+typedef bool (*Browser_Match_Cb)(Widget* item, int index, void* arg);
+
 class FL_API Browser : public Menu {
+  friend class BrowserHeights;
+  friend class BrowserSort;
+  friend class BrowserLabels;
 public:
   
   /** The Browser's custom handle function \n
@@ -59,6 +72,12 @@ public:
   enum {
     NO_COLUMN_SELECTED = -1 //!< means that no column has been selected by user
   };
+  /** Values for the flags of sort() */
+  enum {
+    SORT_DESCENDING = 1, //!< largest first
+    SORT_NOCASE = 2,	 //!< upper and lower case letters are the same
+    SORT_NUMERIC = 4	 //!< compare the keys as numbers
+  };
 
   /** A "Mark" is like a pointer ot a widget somewhere in the hierarchy
       of the Browser. It is an array of child indicies, and also the
@@ -67,6 +86,7 @@ public:
   */
   class FL_API Mark {
     friend class fltk::Browser;
+    friend class fltk::BrowserHeights;
     unsigned level; //!< depth in hierarchy of the item
     unsigned open_level; //!< depth of highest closed parent
     int position;  //!< distance in pixels from top of browser
@@ -182,6 +202,30 @@ public:
   Widget *header(int col) { if(col<0 || col>=nHeader) return 0; return header_[col]; }
   int nheader() const { return nHeader; }
 
+  void sort(int column, int flags = 0);
+  void unsort();
+  bool sorting() const;
+  int sort_column() const;
+  int sort_flags() const;
+  /** Use \a cb to get the text that sort() compares, instead of the
+      part of the item's label between tab characters. */
+  void sort_key(Browser_Key_Cb cb, void* arg = 0) {sort_key_ = cb; sort_key_arg_ = arg;}
+  int sort_index(int position) const;
+  /** \return Whether clicking a column title sorts by that column */
+  bool click_to_sort() const {return click_to_sort_;}
+  /** Make clicking a column title call sort() for it */
+  void click_to_sort(bool v) {click_to_sort_ = v;}
+
+  void filter_text(const char* text);
+  const char* filter_text() const;
+  void filter_match(Browser_Match_Cb cb, void* arg = 0);
+  bool filtering() const;
+  int find_prefix(const char* text);
+  /** \return Whether typing letters moves to the item starting with them */
+  bool type_to_find() const {return type_to_find_;}
+  /** Make typing letters move to the item starting with them */
+  void type_to_find(bool v) {type_to_find_ = v;}
+
   // Convienence functions for flat browsers:
   void value(int v) {goto_index(v); set_focus();}
   int value() const {return FOCUS.indexes[0];}
@@ -198,6 +242,13 @@ public:
   void display_lines(bool display);
 
   int load(const char *filename);
+
+  /** \return The height of every item, or 0 if they are measured */
+  int row_height() const {return row_height_;}
+  void row_height(int);
+  /** \return Whether the browser keeps the flags of the top-level items */
+  bool row_flags() const {return rows_ != 0;}
+  void row_flags(bool);
   
   /** \return Whether or not this browser has its type() set to include MULTI */
   int multi() const {return type()&IS_MULTI;}
@@ -261,6 +312,22 @@ private:
   Widget* goto_visible_focus();
 
   int siblings; //!< Number of children of the parent of the HERE item
+  BrowserHeights* heights_; //!< Measured height of each visible item
+  int row_height_; //!< Height of every item, or 0 to measure them
+  BrowserRows* rows_; //!< SELECTED and OPENED of each top-level item
+  Widget* child_here(unsigned level);
+  void item_flags_changed();
+  bool select_rows(int from, int to, bool value, int do_callback);
+  BrowserSort* sort_; //!< Order the top-level items are shown in
+  bool click_to_sort_; //!< Clicking a column title sorts by it
+  Browser_Key_Cb sort_key_; //!< Returns the text sort() compares
+  void* sort_key_arg_; //!< Passed to sort_key_
+  void reorder(const int* from, int n);
+  BrowserLabels* labels_; //!< Lower case labels for filter_text() and typing
+  bool type_to_find_; //!< Typing letters moves to the item starting with them
+  Browser_Match_Cb filter_match_; //!< Returns whether to show an item
+  void* filter_match_arg_; //!< Passed to filter_match_
+  int find_typed();
   static void column_click_cb_(Widget*, void*);
 
   const Symbol* leaf_symbol_; //!< The symbol used to draw child items.
@@ -49,6 +49,8 @@ class FL_API FileBrowser : public Browser
   const char	*directory_; /**< The current directory */
   float		icon_size_; /**< The FileBrowser's icon sizes */
   const char	*pattern_; /**< The filename glob pattern \todo regex! */
+  int		ndirs_; /**< Number of directories load() put first */
+  static bool	match_pattern(Widget*, int, void*);
 
 public:
   /** The types of items this browser can show */
@@ -35,7 +35,12 @@
 
 namespace fltk {
 
+class GroupLabels;
+class BrowserLabels;
+
 class FL_API Group : public Widget {
+  friend class GroupLabels;
+  friend class BrowserLabels;
 public:
 
   int children() const {return children_;}
@@ -63,6 +68,11 @@ public:
   void remove(Widget& o) {remove(find(o));}
   void remove(Widget* o) {remove(find(*o));}
   void remove_all();
+  void reserve(int n);
+  void add_many(Widget* const* widgets, int n);
+  void remove_range(int index, int n);
+  void defer_updates(bool);
+  bool defer_updates() const {return deferred_ != 0;}
   void replace(int index, Widget&);
   void replace(Widget& old, Widget& o) {replace(find(old),o);}
   void swap(int indexA, int indexB);
@@ -100,9 +110,20 @@ private:
   int children_;
   int focus_index_;
   Widget** array_;
+  int array_size_; // allocated length of array_
+  int array_gap_; // unused slots before array_
+  int index_bias_; // Widget::index_ minus the child's index
+  int stale_from_, stale_to_; // these children may have a wrong index_
   Widget* resizable_;
   Flags resize_align_;
   int *sizes_; // remembered initial sizes of children
+  GroupLabels* labels_; // hash of the child labels, made by Menu::add()
+  unsigned changes_; // counts children added, removed, moved or relabelled
+  Widget** deferred_; // children added during defer_updates(true)
+  int deferred_count_, deferred_size_;
+  void added(Widget&);
+  void shifted(int oldindex, int newindex);
+  void sizes_changed();
 
   static Group *current_;
 
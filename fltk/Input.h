@@ -34,6 +34,9 @@
 
 namespace fltk {
 
+class InputLines;
+class InputUndo;
+
 class FL_API Input : public Widget {
 public:
   enum { // values for type()
@@ -89,6 +92,7 @@ public:
   bool replace(int a, int b, char c) {return replace(a,b,&c,1);}
   bool copy(bool clipboard = true);
   bool undo();
+  bool redo();
   void maybe_do_callback();
 
   int word_start(int i) const;
@@ -111,14 +115,19 @@ private:
   int xscroll_, yscroll_;
   int mu_p;
   int label_width;
+  InputLines* lines_;
+  InputUndo* undo_;
 
   const char* expand(const char*, char*, int) const;
   float expandpos(const char*, const char*, const char*, int*) const;
   void minimal_update(int, int);
   void minimal_update(int p);
   void erase_cursor_at(int p);
+  void change_text(int, int, const char*, int);
 
   void setfont() const;
+  void layout_lines(int wordwrap) const;
+  int wrap_width() const;
 
   void shift_position(int p);
   void shift_up_down_position(int p);
@@ -92,6 +92,7 @@ public:
   Group*  add_group(const char* label, Group* parent=0, void* data=0);
   Widget* add_leaf(const char* label, Group* parent=0, void* data=0);
   Widget* add_many(const char*);
+  Widget* add_many(const char* const* labels, int n);
   Widget* replace(const char*, void* = 0);
   Widget* insert(int n, const char*, void* = 0);
 
@@ -106,6 +107,8 @@ public:
   void replace(int index, Widget& o) {Group::replace(index, o);}
   /** Calls Group::replace(old, o) */
   void replace(Widget& old, Widget& o) {Group::replace(old,o);}
+  /** Calls Group::add_many(widgets, n) */
+  void add_many(Widget* const* widgets, int n) {Group::add_many(widgets, n);}
   /** Calls Group::remove(index) */
   void remove(int index) {Group::remove(index);}
   /** Calls Group::remove(o) */
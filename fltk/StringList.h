@@ -70,5 +70,20 @@ public:
   void set(const char* s); // nul-seperated list
 };
 
+class FL_API StringLines : public StringList {
+  char* text_;
+  int* lines_;
+  int children_;
+public:
+  // overrides of StringList virtual functions:
+  virtual int children(const Menu*);
+  virtual const char* label(const Menu*, int index);
+  // read the lines of a file:
+  StringLines() : text_(0), lines_(0), children_(0) {}
+  ~StringLines();
+  int load(const char* filename);
+  void clear();
+};
+
 }
 #endif
@@ -31,6 +31,7 @@
 #define _fltk_TextBuffer_h_
 
 #include "FL_API.h"
+#include <stdio.h>
 
 namespace fltk {
 
@@ -73,18 +74,65 @@ protected:
 };
 
 
+class TextPieceTable;
+class TextLineIndex;
+class TextSearch;
+class TextRegexProgram;
+class TextUndo;
+class TextColumnIndex;
+class TextBufferIO;
+
+/** A compiled regular expression for TextBuffer::regex_search_forward()
+    and the other regex searches. Compiling once and reusing it saves
+    parsing the pattern for every search. */
+class FL_API TextRegex {
+public:
+  TextRegex(const char *pattern, bool matchCase = true);
+  ~TextRegex();
+
+  /** NULL if the pattern compiled, otherwise what is wrong with it */
+  const char *error() const { return error_; }
+
+private:
+  friend class TextBuffer;
+  TextRegexProgram *program_;
+  const char *error_;
+};
+
 typedef void (*Text_Modify_Cb)(	int pos, int nInserted, int nDeleted,
 				int nRestyled, const char* deletedText,
 				void* cbArg);
 
 typedef void (*Text_Predelete_Cb)(int pos, int nDeleted, void* cbArg);
 
+typedef int (*Text_Match_Cb)(int start, int end, void* cbArg);
+
+typedef void (*Text_Progress_Cb)(int done, int total, int status, void* cbArg);
+
 /** TextBuffer */
 class FL_API TextBuffer {
 public:
+  /** How the text is stored, see storage() */
+  enum Storage {
+    GAP_BUFFER,		/*!< one block of memory with a gap at the last edit */
+    PIECE_TABLE		/*!< tree of pieces of unmodified blocks of memory */
+  };
+
+  /** Status passed to the Text_Progress_Cb of loadfile_async() and
+      savefile_async() */
+  enum IOStatus {
+    IO_RUNNING = -1,	/*!< still loading or saving */
+    IO_DONE = 0,	/*!< the whole file was loaded or saved */
+    IO_ERROR = 2,	/*!< the file could not be read or written */
+    IO_CANCELED = 3	/*!< stopped by cancel_io() */
+  };
+
   TextBuffer(int requestedsize = 0);
   ~TextBuffer();
 
+  Storage storage() const { return pieces_ ? PIECE_TABLE : GAP_BUFFER; }
+  void storage(Storage);
+
   int length() const { return length_; }
 
   const char *text();
@@ -101,16 +149,30 @@ public:
   void copy(TextBuffer *from_buf, int from_start, int from_end, int to_pos);
 
   int undo(int *cp = 0);
+  int redo(int *cp = 0);
   void canUndo(char flag = 1);
+  void clear_undo();
+  /** Most memory in bytes the undo journal may use, see undo_limit(int) */
+  int undo_limit() const { return undolimit_; }
+  void undo_limit(int bytes);
 
   int insertfile(const char *file, int pos, int buflen = 128*1024);
   int appendfile(const char *file, int buflen = 128*1024)
         { return insertfile(file, length(), buflen); }
   int loadfile(const char *file, int buflen = 128*1024)
         { select(0, length()); remove_selection(); return appendfile(file, buflen); }
+  int mapfile(const char *file);
   int outputfile(const char *file, int start, int end, int buflen = 128*1024);
   int savefile(const char *file, int buflen = 128*1024)
         { return outputfile(file, 0, length(), buflen); }
+  int loadfile_async(const char *file, Text_Progress_Cb cb = 0,
+                     void *cbArg = 0, int buflen = 1024*1024);
+  int savefile_async(const char *file, Text_Progress_Cb cb = 0,
+                     void *cbArg = 0, int buflen = 1024*1024);
+  void cancel_io();
+  /** True while loadfile_async() or savefile_async() is running */
+  bool io_busy() const { return io_ != 0; }
+  bool io_inserting() const;
 
   void insert_column(int column, int startpos, const char *text,
                      int *chars_inserted, int *chars_deleted);
@@ -170,6 +232,20 @@ public:
 
   void call_predelete_callbacks() { call_predelete_callbacks(0, 0); }
 
+  void begin_batch();
+  void end_batch();
+  /** True between begin_batch() and end_batch() */
+  bool batching() const { return batchdepth_ > 0; }
+
+  void append_lines(const char *text, int length = -1);
+  void flush_appends();
+  /** Most bytes kept by append_lines(), see max_bytes(int) */
+  int max_bytes() const { return maxbytes_; }
+  void max_bytes(int bytes);
+  /** Most lines kept by append_lines(), see max_lines(int) */
+  int max_lines() const { return maxlines_; }
+  void max_lines(int lines);
+
   char* line_text(int pos);
   int line_start(int pos);
   int line_end(int pos);
@@ -188,6 +264,8 @@ public:
   int count_lines(int startPos, int endPos);
   int skip_lines(int startPos, int nLines);
   int rewind_lines(int startPos, int nLines);
+  int position_to_line(int pos);
+  int line_to_position(int line);
   
   bool findchar_forward(int startPos, char searchChar, int* foundPos);
   bool findchar_backward(int startPos, char searchChar, int* foundPos);
@@ -201,6 +279,26 @@ public:
   bool search_backward(int startPos, const char* searchString, int* foundPos,
                        bool matchCase = false);
 
+  int search_all(int startPos, int endPos, const char* searchString,
+                 int** foundPositions, bool matchCase = false);
+
+  int replace_all(int startPos, int endPos, const char* searchString,
+                  const char* replaceString, bool matchCase = false);
+
+  bool regex_search_forward(int startPos, int endPos, const TextRegex& regex,
+                            int* foundStart, int* foundEnd);
+
+  bool regex_search_backward(int startPos, int endPos, const TextRegex& regex,
+                             int* foundStart, int* foundEnd);
+
+  int regex_search_all(int startPos, int endPos, const TextRegex& regex,
+                       Text_Match_Cb matchCB, void* cbArg);
+
+  bool regex_search_some(int* pos, int endPos, const TextRegex& regex,
+                         Text_Match_Cb matchCB, void* cbArg, int maxScan);
+
+  const char *chunk(int pos, int *chunkstart, int *chunklength);
+
   char null_substitution_character() { return nullsubschar_; }
   TextSelection* primary_selection() { return &primary_; }
   TextSelection* secondary_selection() { return &secondary_; }
@@ -210,8 +308,20 @@ protected:
   void call_modify_callbacks(int pos, int nDeleted, int nInserted,
                              int nRestyled, const char* deletedText);
   void call_predelete_callbacks(int pos, int nDeleted);
+  void batch_change_(int pos, int nDeleted, int nInserted, int nRestyled,
+                     const char* deletedText);
 
   int insert_(int pos, const char* text);
+  void record_insert_(int pos, int length);
+  void record_remove_(int start, int end);
+  void begin_undo_group_();
+  void end_undo_group_();
+  int undo_step_(TextUndo *from, char mode, int *cursorPos);
+  int insertfile_pieces_(FILE *fp, int pos);
+  void reserve_(int pos, long size);
+  void unmap_(const char *file);
+  void delete_io_();
+  friend class TextBufferIO;
   void remove_(int start, int end);
 
   void remove_rectangular_(int start, int end, int rectStart, int rectEnd,
@@ -227,6 +337,15 @@ protected:
   void redisplay_selection(TextSelection* oldSelection,
                            TextSelection* newSelection);
 
+  void copy_range_(char *to, int start, int end);
+
+  void trim_();
+  void scan_columns_(int linestart, int *pos, int *column, int target,
+                     int ncolumns, bool stopatnewline);
+  static void flush_appends_cb(void *);
+  void update_line_index_(int from, int to, int sign);
+  int search_forward_(int startPos, int endPos, TextSearch* search);
+  int search_backward_(int endPos, TextSearch* search);
   void move_gap(int pos);
   void reallocate_with_gap(int newGapStart, int newGapLen);
   char *selection_text_(TextSelection *sel);
@@ -249,6 +368,13 @@ protected:
   char *buf_;     /*!< allocated memory where the text is stored */
   int gapstart_;  /*!< points to the first character of the gap */
   int gapend_;    /*!< points to the first char after the gap */
+  TextPieceTable *pieces_; /*!< text storage when storage() is PIECE_TABLE,
+                                buf_ is unused then */
+  TextLineIndex *lineindex_; /*!< where the newlines in buf_ are, built
+                                  the first time it is needed */
+  TextColumnIndex *columns_; /*!< columns found on long lines, see
+                                  count_displayed_characters_utf() */
+  unsigned columnsused_;
   
   int tabdist_;		/*!< equiv. number of characters in a tab */
   bool usetabs_;	/*!< True if buffer routines are allowed to use
@@ -263,6 +389,22 @@ protected:
  	                                    /*   from the buffer; at most one is supported. */
   void **prepeletecbargs_;	          /*!< caller argument for pre-delete proc above */
   
+  int batchdepth_;	/*!< nesting of begin_batch() calls */
+  int batchstart_;	/*!< start of the text changed in the batch, or -1 */
+  int batchend_;	/*!< end of the text changed in the batch */
+  char *batchdeleted_;	/*!< what was between batchstart_ and batchend_ */
+  int batchdeletedlength_;
+  int batchdeletedsize_;
+  bool batchchanged_;	/*!< text was changed, not just restyled */
+  bool batchnotify_;	/*!< call_modify_callbacks() was called with no change */
+
+  char *appended_;	/*!< text from append_lines() not yet in the buffer */
+  int appendedlength_;
+  int appendedsize_;
+  int maxbytes_;	/*!< see max_bytes() */
+  int maxlines_;	/*!< see max_lines() */
+  TextBufferIO *io_;	/*!< running loadfile_async() or savefile_async() */
+
   int cursorposhint_; /*!< hint for reasonable cursor position after
     				               a buffer modification operation */
   char nullsubschar_;	/*!< TextBuffer is based on C null-terminated strings,
@@ -273,6 +415,12 @@ protected:
 
   char mCanUndo;		  /*!< if this buffer is used for attributes, it must
 				                   not do any undo calls */
+  TextUndo *undojournal_; /*!< edits undo() can reverse, NULL if none yet */
+  TextUndo *redojournal_; /*!< edits redo() can make again */
+  int undolimit_;	  /*!< see undo_limit() */
+  char undoing_;	  /*!< 1 in undo(), 2 in redo(), otherwise 0 */
+  int undogroup_;	  /*!< nesting of edits to undo all at once */
+  bool undogrouped_;	  /*!< a record was made in the current group */
 };
 
 } /* namespace fltk */
@@ -41,6 +41,14 @@ namespace fltk {
 
 typedef void (*UnfinishedStyleCb)(int, void *);
 
+/** Styles one line of text for TextDisplay::highlight() */
+typedef int (*TextHighlightCb)(const char *text, int length, char *style,
+                               int state, void *arg);
+
+class TextHighlighter;
+class TextWrapIndex;
+class TextMatcher;
+
 /** TextDisplay */
 class FL_API TextDisplay: public Group {
 public:
@@ -148,6 +156,20 @@ public:
 		      int nStyles, char unfinishedStyle,
 		      UnfinishedStyleCb unfinishedHighlightCB,
 		      void *cbArg);
+  /** Style the text one line at a time as it is edited */
+  void highlight(StyleTableEntry *styleTable, int nStyles,
+		 TextHighlightCb cb, void *arg = 0);
+
+  /** Highlight every place a string is found */
+  void highlight_matches(const char *string, bool matchCase = false,
+			 Text_Progress_Cb cb = 0, void *arg = 0);
+  int match_count() const;
+  bool next_match(int pos, int *start, int *end) const;
+  bool previous_match(int pos, int *start, int *end) const;
+  /** Return the color drawn behind matches */
+  Color match_color() const { return match_color_; }
+  /** Set the color drawn behind matches */
+  void match_color(Color c) { match_color_ = c; redraw(); }
 
   /** Move cursor right */
   bool move_right();
@@ -280,9 +302,6 @@ protected:
   int range_touches_selection(TextSelection *sel, int rangeStart, int rangeEnd);
   void text_drag_me(int pos);
 
-  int damage_range1_start, damage_range1_end;
-  int damage_range2_start, damage_range2_end;
-
   int cursor_pos_;
   bool cursor_on_;
   int cursor_oldx_;           /* X pos. of cursor for blanking */
@@ -306,6 +325,14 @@ protected:
   int wrapmargin_;            /* Margin in # of char positions for
 				 wrapping in continuousWrap mode */
   int *linestarts_;
+  int *linedamage_;           /* First and last changed character of
+				 each visible line, to be redrawn */
+  int scrolldy_;              /* Pixels the drawn text has to move
+				 down by the next draw() */
+  int *linewidths_;           /* Start and width in pixels of each
+				 visible line when it was last measured */
+  Font *widthfont_;           /* Font and size the widths are for */
+  float widthsize_;
   int topline_num_;           /* Line number of top displayed line
 				 of file (first line of file is 1) */
   int abs_topline_num_;       /* In continuous wrap mode, the line
@@ -346,6 +373,34 @@ protected:
 
   int dragpos_, dragtype_, dragging_;
   int linenumleft_, linenumwidth_; /* Line number margin and width */
+
+private:
+  friend class TextHighlighter;
+  TextHighlighter *highlighter_; /* Styles the text for highlight() */
+  void highlight_buffer_(TextBuffer *buf);
+  void highlight_delete_(TextBuffer *styleBuffer);
+
+  friend class TextMatcher;
+  TextMatcher *matcher_; /* Matches of highlight_matches() */
+  Color match_color_;
+  bool in_match_(int pos);
+  void matches_buffer_(TextBuffer *buf);
+  void matches_delete_();
+
+  TextWrapIndex *wrapindex_; /* Rows of each line in continuous wrap mode */
+  int wrap_measure_(int line, int start = -1);
+  int wrap_row_(int pos);
+  int wrap_row_start_(int row);
+  void wrap_reset_(int lines = 0);
+  void wrap_delete_();
+  void wrap_modified_(int pos, int nInserted, int nDeleted,
+                      const char *deletedText);
+  void wrap_sync_();
+  static void wrap_idle_cb(void *);
+
+  void damage_vline_(int visLineNum, int leftCharIndex, int rightCharIndex);
+  void forget_widths_();
+  static void draw_area_cb(void *, const Rectangle &);
 };
 
 } /* namespace fltk */
@@ -100,6 +100,7 @@ public:
   static int kf_paste(int c, TextEditor* e);
   static int kf_select_all(int c, TextEditor* e);
   static int kf_undo(int c, TextEditor* e);
+  static int kf_redo(int c, TextEditor* e);
 
 protected:
   int handle_key();
@@ -50,6 +50,7 @@ class FL_API Widget : public Rectangle {
   // disable the copy assignment/constructors:
   Widget & operator=(const Widget &);
   Widget(const Widget &);
+  friend class Group;
 
 public:
 
@@ -312,6 +313,7 @@ private:
   uchar			damage_;
   uchar			layout_damage_;
   uchar			when_;
+  int			index_; // position in parent(), checked by Group::find()
 
 };
 
@@ -33,6 +33,7 @@
 #include <fltk/draw.h>
 #include <fltk/error.h>
 #include <fltk/Cursor.h>
+#include "BrowserSort.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -236,7 +237,7 @@ Widget* Browser::goto_top() {
   if (siblings <= 0) {
     item(0);
   } else {
-    item(child(HERE.indexes,0));
+    child_here(0);
     // skip leading invisible widgets:
     if (!item()->visible()) return next_visible();
   }
@@ -260,7 +261,7 @@ Widget* Browser::goto_mark(const Mark& mark) {
     siblings = children(HERE.indexes, L);
     if (i < 0 || i >= siblings) {item(0); return 0;}
   }
-  item(child(HERE.indexes, HERE.level));
+  child_here(HERE.level);
   return item();
 }
 
@@ -348,9 +349,10 @@ bool Browser::item_is_open() const {
 }
 
 /** Gets the current item's height and calls layout if needed
-  \return The current item's height. 
+  \return The current item's height, or row_height() if that is set.
 */
 int Browser::item_h() const {
+  if (row_height_) return row_height_;
   if (!item()->h()) item()->layout();
   return item()->h();
 }
@@ -392,7 +394,7 @@ Widget* Browser::next_visible() {
       continue;
     }
 
-    item(child(HERE.indexes, HERE.level));
+    child_here(HERE.level);
 
     // skip invisible items:
     if (item()->visible()) break;
@@ -424,14 +426,14 @@ Widget* Browser::previous_visible() {
 	return 0;
       }
       HERE.open_level = --HERE.level;
-      item(child(HERE.indexes, HERE.level));
+      child_here(HERE.level);
       siblings = children(HERE.indexes, HERE.level);
       break;
     }
 
     // go back to previous item in this group:
     HERE.indexes[HERE.level] --;
-    item(child(HERE.indexes, HERE.level));
+    child_here(HERE.level);
 
     // go to last child in a group:
     while (item_is_open() && item()->visible() && item_is_parent()) {
@@ -440,7 +442,7 @@ Widget* Browser::previous_visible() {
       set_level(HERE.level+1);
       HERE.open_level = HERE.level;
       HERE.indexes[HERE.level] = n-1;
-      item(child(HERE.indexes, HERE.level));
+      child_here(HERE.level);
       siblings = n;
     }
 
@@ -475,7 +477,7 @@ Widget* Browser::next() {
   }
   for (;;) {
     if (HERE.indexes[HERE.level] < siblings) {
-      item(child(HERE.indexes, HERE.level));
+      child_here(HERE.level);
       return item();
     }
     if (HERE.level <= 0) {item(0); return 0;}
@@ -485,12 +487,536 @@ Widget* Browser::next() {
   }
 }
 
+////////////////////////////////////////////////////////////////
+// Row flags:
+
+/* One bit per top-level item for each of SELECTED and OPENED, used
+   by row_flags() for a List that has nowhere to keep them. */
+class fltk::BrowserRows {
+public:
+  enum {SELECTED_BITS, OPENED_BITS};
+  uchar* bits[2];
+  int size;		// number of items there is room for
+
+  BrowserRows() : size(0) {bits[0] = bits[1] = 0;}
+  ~BrowserRows() {free(bits[0]); free(bits[1]);}
+  bool get(int which, int i) const {
+    return i >= 0 && i < size && (bits[which][i>>3]>>(i&7)&1);
+  }
+  void set(int which, int i, bool value);
+  bool set_range(int which, int from, int to, bool value);
+  bool clear(int which);
+  void reserve(int n);
+  void reorder(const int* from, int n);
+};
+
+void BrowserRows::reserve(int n) {
+  if (n <= size) return;
+  int newsize = size ? size : 1024;
+  while (newsize < n) newsize *= 2;
+  int oldbytes = (size+7)/8;
+  int bytes = (newsize+7)/8;
+  for (int j = 0; j < 2; j++) {
+    bits[j] = (uchar*)realloc(bits[j], bytes);
+    memset(bits[j]+oldbytes, 0, bytes-oldbytes);
+  }
+  size = newsize;
+}
+
+/* The first n items are now the ones that were at from[i], or ones
+   that were not shown if it is -1, and there are none after them */
+void BrowserRows::reorder(const int* from, int n) {
+  reserve(n);
+  int bytes = (size+7)/8;
+  for (int j = 0; j < 2; j++) {
+    uchar* old = bits[j];
+    bits[j] = (uchar*)calloc(bytes, 1);
+    for (int i = 0; i < n; i++) {
+      int k = from[i];
+      if (k >= 0 && k < size && (old[k>>3]>>(k&7)&1)) bits[j][i>>3] |= 1<<(i&7);
+    }
+    free(old);
+  }
+}
+
+void BrowserRows::set(int which, int i, bool value) {
+  if (i < 0) return;
+  if (i >= size) {
+    if (!value) return;
+    reserve(i+1);
+  }
+  if (value) bits[which][i>>3] |= 1<<(i&7);
+  else bits[which][i>>3] &= ~(1<<(i&7));
+}
+
+/* Set the bits from..to inclusive, return true if any changed */
+bool BrowserRows::set_range(int which, int from, int to, bool value) {
+  if (from < 0) from = 0;
+  if (!value && to >= size) to = size-1;
+  if (to < from) return false;
+  reserve(to+1);
+  bool changed = false;
+  // do the partial bytes at the ends one bit at a time:
+  for (; from <= to && (from&7); from++) {
+    if (get(which, from) != value) changed = true;
+    set(which, from, value);
+  }
+  for (; to >= from && ((to+1)&7); to--) {
+    if (get(which, to) != value) changed = true;
+    set(which, to, value);
+  }
+  // and the rest a byte at a time:
+  uchar c = value ? 0xff : 0;
+  for (int i = from>>3; from <= to && i <= to>>3; i++) {
+    if (bits[which][i] != c) {changed = true; bits[which][i] = c;}
+  }
+  return changed;
+}
+
+/* Turn off all the bits, return true if any were on */
+bool BrowserRows::clear(int which) {
+  int bytes = (size+7)/8;
+  for (int i = 0; i < bytes; i++) {
+    if (bits[which][i]) {memset(bits[which], 0, bytes); return true;}
+  }
+  return false;
+}
+
+/* Set item() to the child at HERE.indexes, level. If row_flags() is on
+   the top-level items get their SELECTED and OPENED from it. */
+Widget* Browser::child_here(unsigned level) {
+  item(child(HERE.indexes, level));
+  if (rows_ && !level && item()) {
+    int i = HERE.indexes[0];
+    if (rows_->get(BrowserRows::SELECTED_BITS, i)) item()->set_flag(SELECTED);
+    else item()->clear_flag(SELECTED);
+    if (rows_->get(BrowserRows::OPENED_BITS, i)) item()->set_flag(OPENED);
+    else item()->clear_flag(OPENED);
+  }
+  return item();
+}
+
+/* Remember the flags of item() and tell the list() they changed */
+void Browser::item_flags_changed() {
+  if (rows_ && !HERE.level) {
+    int i = HERE.indexes[0];
+    rows_->set(BrowserRows::SELECTED_BITS, i, item()->flag(SELECTED));
+    rows_->set(BrowserRows::OPENED_BITS, i, item()->flag(OPENED));
+  }
+  list()->flags_changed(this, item());
+}
+
+/* The top-level item at each position i < n was at position from[i]
+   before, or was not shown if it is -1, because sort() or the filter
+   changed what is shown. Move the focus and the row_flags() along with
+   them. The focus is unset if its item is no longer shown. */
+void Browser::reorder(const int* from, int n) {
+  if (rows_) rows_->reorder(from, n);
+  if (FOCUS.is_set()) {
+    int i;
+    for (i = 0; i < n && from[i] != FOCUS.indexes[0]; i++);
+    if (i < n) {
+      FOCUS.indexes[0] = i;
+      HERE = FOCUS;
+    } else {
+      FOCUS.unset();
+    }
+  }
+  OPEN.unset();
+  BELOWMOUSE.unset();
+  for (int i = 0; i < NUM_REDRAW; i++) REDRAW[i].unset();
+  relayout();
+  redraw();
+}
+
+/*! Turn on or off the keeping of the fltk::SELECTED and fltk::OPENED
+  flags of the top-level items by the browser. This is for a List,
+  such as a StringList, that returns the same reused widget for every
+  item and has nowhere to store them. It takes one bit per item for
+  each flag.
+
+  While this is on, select_only_this() and selecting a range with
+  shift+drag only change the top-level items, and take time
+  proportional to the number of items divided by 8, rather than going
+  to each of them. The callback is done once for the range, rather
+  than once per item.
+
+  Turning it off forgets the flags.
+*/
+void Browser::row_flags(bool value) {
+  if (value == (rows_ != 0)) return;
+  if (value) rows_ = new BrowserRows;
+  else {delete rows_; rows_ = 0;}
+  relayout();
+}
+
+/*! Make every item \a h pixels tall, or measure each of them if \a h
+  is zero, which is the default.
+
+  The position of an item is then its index times \a h, so layout()
+  and scrolling take the same time no matter how many items there
+  are, and no item is laid out to find its size. This is meant for
+  a flat list where every item is visible, such as a StringList with
+  millions of lines. Hidden items and the children of open parents
+  are not accounted for, and the browser is not scrolled horizontally.
+*/
+void Browser::row_height(int h) {
+  if (h < 0) h = 0;
+  if (h == row_height_) return;
+  row_height_ = h;
+  relayout();
+}
+
+/* Set the SELECTED flag of the top-level items from..to using the
+   row_flags(). Returns true if any changed. */
+bool Browser::select_rows(int from, int to, bool value, int do_callback) {
+  if (from > to) {int t = from; from = to; to = t;}
+  if (!rows_->set_range(BrowserRows::SELECTED_BITS, from, to, value))
+    return false;
+  if (item() && !HERE.level) child_here(0);
+  redraw(DAMAGE_CONTENTS);
+  if (when() & do_callback) {
+    clear_changed();
+    Mark TEMP(HERE);
+    this->do_callback();
+    goto_mark(TEMP);
+  } else if (do_callback) {
+    set_changed();
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////
+// Height index:
+
+/* The height of every visible item is kept in a tree matching the
+   hierarchy: a node for the top level and for each open parent, with
+   the height of each child, and of it plus everything shown under it.
+   The sums of the second are kept in a Fenwick tree, so the position
+   of any item, and the item at any position, is found in log time.
+
+   layout() only measures items that are new or have been changed
+   (their h() is zero or they called relayout()), and opening, closing,
+   hiding or showing an item only updates the nodes above it. */
+class fltk::BrowserHeights {
+public:
+  struct Node {
+    int n;		// number of children
+    Widget** widget;	// each child, to find them if the list is changed
+    int* own;		// height of each child, -1 if invisible
+    int* total;		// height of it and everything shown under it
+    int* width;		// width, or 0 if it fits in the browser
+    Node** sub;		// node for each open parent
+    int* sums;		// Fenwick tree of total, 1-based
+    int height;		// sum of total
+    int maxwidth;	// widest of width and sub->maxwidth
+    int shown;		// number of visible items including sub
+  };
+  Node* root;
+  bool stale;		// the tree does not match the children any more
+  int* path;
+  unsigned pathsize;
+
+  BrowserHeights() : root(0), stale(true), path(0), pathsize(0) {}
+  ~BrowserHeights() {destroy(root); delete[] path;}
+  static Node* create(int n);
+  static void destroy(Node*);
+  static void build_sums(Node*);
+  static int prefix(const Node*, int i);
+  static void add(Node*, int i, int delta);
+  static int search(const Node*, int& y);
+  static void summarize(Node*);
+  void reserve(unsigned level);
+  bool is_open(Browser*, Widget*, unsigned level);
+  void update(Browser*, Node*, int i, unsigned level, bool measure, bool deep);
+  Node* sync(Browser*, Node* old, unsigned level, bool deep);
+  void refresh(Browser*, const int* indexes, unsigned level);
+  bool locate(Browser::Mark&);
+};
+
+BrowserHeights::Node* BrowserHeights::create(int n) {
+  Node* node = new Node;
+  node->n = n;
+  node->widget = new Widget*[n];
+  node->own = new int[n];
+  node->total = new int[n];
+  node->width = new int[n];
+  node->sub = new Node*[n];
+  node->sums = new int[n+1];
+  for (int i = 0; i < n; i++) {
+    node->widget[i] = 0;
+    node->own[i] = node->total[i] = node->width[i] = 0;
+    node->sub[i] = 0;
+  }
+  node->height = node->maxwidth = node->shown = 0;
+  return node;
+}
+
+void BrowserHeights::destroy(Node* node) {
+  if (!node) return;
+  for (int i = 0; i < node->n; i++) destroy(node->sub[i]);
+  delete[] node->widget;
+  delete[] node->own;
+  delete[] node->total;
+  delete[] node->width;
+  delete[] node->sub;
+  delete[] node->sums;
+  delete node;
+}
+
+void BrowserHeights::build_sums(Node* node) {
+  int n = node->n;
+  for (int i = 1; i <= n; i++) node->sums[i] = node->total[i-1];
+  for (int i = 1; i <= n; i++) {
+    int j = i+(i&-i);
+    if (j <= n) node->sums[j] += node->sums[i];
+  }
+  node->height = prefix(node, n);
+}
+
+/* Sum of total of the children before i */
+int BrowserHeights::prefix(const Node* node, int i) {
+  int s = 0;
+  for (; i > 0; i -= i&-i) s += node->sums[i];
+  return s;
+}
+
+void BrowserHeights::add(Node* node, int i, int delta) {
+  for (i++; i <= node->n; i += i&-i) node->sums[i] += delta;
+  node->height += delta;
+}
+
+/* Return the child that y is in, and change y to be relative to the
+   top of it. Returns n if y is below the last one. */
+int BrowserHeights::search(const Node* node, int& y) {
+  int step = 1;
+  while (step*2 <= node->n) step *= 2;
+  int i = 0;
+  for (; step; step /= 2) {
+    if (i+step <= node->n && node->sums[i+step] <= y) {
+      i += step;
+      y -= node->sums[i];
+    }
+  }
+  return i;
+}
+
+/* Recalculate maxwidth and shown from the children */
+void BrowserHeights::summarize(Node* node) {
+  node->maxwidth = node->shown = 0;
+  for (int i = 0; i < node->n; i++) {
+    if (node->own[i] < 0) continue;
+    node->shown++;
+    if (node->width[i] > node->maxwidth) node->maxwidth = node->width[i];
+    if (Node* sub = node->sub[i]) {
+      node->shown += sub->shown;
+      if (sub->maxwidth > node->maxwidth) node->maxwidth = sub->maxwidth;
+    }
+  }
+}
+
+void BrowserHeights::reserve(unsigned level) {
+  if (level < pathsize) return;
+  int* newpath = new int[2*level+2];
+  memcpy(newpath, path, pathsize*sizeof(int));
+  delete[] path;
+  path = newpath;
+  pathsize = 2*level+2;
+}
+
+/* Same as Browser::item_is_open() for the item at path */
+bool BrowserHeights::is_open(Browser* b, Widget* w, unsigned level) {
+  if (w->flag(fltk::OPENED)) return true;
+  if (b->rows_ && !level &&
+      b->rows_->get(BrowserRows::OPENED_BITS, path[0])) return true;
+  for (unsigned i = 0; i <= level; i++) {
+    if (i > b->OPEN.level) return false;
+    if (path[i] != b->OPEN.indexes[i]) return false;
+  }
+  return true;
+}
+
+/* Update child i of the node, which is at path and was just returned
+   by child(). If it is an open parent its children are synced, or if
+   \a deep is false, only if it or one of them called relayout(), or
+   they were not shown before. */
+void BrowserHeights::update(Browser* b, Node* node, int i, unsigned level,
+			    bool measure, bool deep) {
+  Widget* w = node->widget[i];
+  bool damaged = w->layout_damage() != 0;
+  if (!w->visible()) {
+    node->own[i] = -1;
+    destroy(node->sub[i]); node->sub[i] = 0;
+    node->total[i] = 0;
+    return;
+  }
+  if (measure || !w->h() || damaged) {
+    int border = (int(b->textsize())|1)*level;
+    int bw = b->interior.w()-border;
+    w->x(b->interior.x()+border);
+    w->w(bw);
+    w->layout_damage(LAYOUT_X|LAYOUT_W);
+    w->layout();
+    node->width[i] = w->w() == bw ? 0 : w->w()+border;
+  }
+  node->own[i] = w->h();
+  reserve(level+1);
+  if (is_open(b, w, level) && b->children(path, level+1) >= 0) {
+    if (deep || damaged || !node->sub[i])
+      node->sub[i] = sync(b, node->sub[i], level+1, deep);
+  } else {
+    destroy(node->sub[i]); node->sub[i] = 0;
+  }
+  node->total[i] = node->own[i] + (node->sub[i] ? node->sub[i]->height : 0);
+}
+
+/* Make a node match the children at path[0..level-1]. Children that
+   are the same widgets as in the old node keep their measurements.
+   \a deep is passed to update(). */
+BrowserHeights::Node* BrowserHeights::sync(Browser* b, Node* old,
+					   unsigned level, bool deep) {
+  reserve(level);
+  int n = b->children(path, level);
+  if (n < 0) n = 0;
+  Node* node = old;
+  int same_start = n, same_end = n; // children in these ranges are kept
+  if (!old || old->n != n) {
+    node = create(n);
+    int m = old ? old->n : 0;
+    // find the children at the start and end that did not change:
+    int a = 0;
+    for (; a < n && a < m; a++) {
+      path[level] = a;
+      if (b->child(path, level) != old->widget[a]) break;
+    }
+    int e = 0;
+    for (; e < n-a && e < m-a; e++) {
+      path[level] = n-1-e;
+      if (b->child(path, level) != old->widget[m-1-e]) break;
+    }
+    for (int i = 0; i < m; i++) {
+      int j = i < a ? i : i >= m-e ? i-m+n : -1;
+      if (j < 0) {destroy(old->sub[i]); continue;}
+      node->widget[j] = old->widget[i];
+      node->own[j] = old->own[i];
+      node->width[j] = old->width[i];
+      node->sub[j] = old->sub[i];
+    }
+    if (old) {
+      for (int i = 0; i < m; i++) old->sub[i] = 0;
+      destroy(old);
+    }
+    same_start = a;
+    same_end = n-e;
+  }
+  for (int i = 0; i < n; i++) {
+    path[level] = i;
+    Widget* w = b->child(path, level);
+    bool changed = w != node->widget[i] || (i >= same_start && i < same_end);
+    node->widget[i] = w;
+    update(b, node, i, level, changed, deep);
+  }
+  build_sums(node);
+  summarize(node);
+  return node;
+}
+
+/* Update the item at indexes, and each parent of it, after it was
+   opened, closed, shown or hidden. */
+void BrowserHeights::refresh(Browser* b, const int* indexes, unsigned level) {
+  if (stale || !root) return;
+  reserve(level+1);
+  Node* nodes[64]; // deeper items are updated by the next layout()
+  int totals[64];
+  if (level >= 64) {stale = true; return;}
+  Node* node = root;
+  unsigned L = 0;
+  for (;; L++) {
+    int i = indexes[L];
+    if (i < 0 || i >= node->n) {stale = true; return;}
+    path[L] = i;
+    Widget* w = b->child(path, L);
+    if (w != node->widget[i]) {stale = true; return;}
+    nodes[L] = node;
+    totals[L] = node->total[i];
+    Node* sub = node->sub[i];
+    update(b, node, i, L, false, false);
+    // stop if this is the item, or if the children were just synced:
+    if (L == level || !node->sub[i] || node->sub[i] != sub) break;
+    node = node->sub[i];
+  }
+  // fix up the sums, the heights under each parent may have changed:
+  for (;; L--) {
+    node = nodes[L];
+    int i = indexes[L];
+    if (node->own[i] >= 0)
+      node->total[i] = node->own[i] + (node->sub[i] ? node->sub[i]->height : 0);
+    add(node, i, node->total[i]-totals[L]);
+    summarize(node);
+    if (!L) break;
+  }
+}
+
+/* Set the position of a mark to where the item is shown, and return
+   true, or return false if it is not visible */
+bool BrowserHeights::locate(Browser::Mark& mark) {
+  Node* node = root;
+  int position = 0;
+  for (unsigned L = 0; ; L++) {
+    if (!node) return false;
+    int i = mark.indexes[L];
+    if (i < 0 || i >= node->n || node->own[i] < 0) return false;
+    position += prefix(node, i);
+    if (L == mark.level) break;
+    position += node->own[i];
+    node = node->sub[i];
+  }
+  mark.position = position;
+  mark.open_level = mark.level;
+  return true;
+}
+
 /*! Set the current item() to the last one whose top is at or before
   \a Y pixels from the top. 
   \param Y The minimum distance from the top
   \return The last Item's Widget whose top is at or before \a Y*/
 Widget* Browser::goto_position(int Y) {
   if (Y < 0) Y = 0;
+  if (row_height_) {
+    // all items are the same height, so just divide:
+    HERE.level = 0;
+    HERE.open_level = 0;
+    siblings = children(HERE.indexes, 0);
+    int i = Y/row_height_;
+    bool below = i >= siblings;
+    if (below) i = siblings-1;
+    if (i < 0) {HERE.indexes[0] = HERE.position = 0; item(0); return 0;}
+    HERE.indexes[0] = i;
+    HERE.position = i*row_height_;
+    child_here(0);
+    return below ? 0 : item();
+  }
+  if (!layout_damage() && heights_ && !heights_->stale &&
+      heights_->root->height > 0) {
+    // find it in the heights measured by layout():
+    BrowserHeights::Node* node = heights_->root;
+    bool below = Y >= node->height;
+    if (below) Y = node->height-1;
+    int y = Y;
+    for (unsigned L = 0; ; L++) {
+      int i = BrowserHeights::search(node, y);
+      set_level(L);
+      HERE.indexes[L] = i;
+      if (y < node->own[i]) break;
+      y -= node->own[i];
+      node = node->sub[i];
+    }
+    HERE.open_level = HERE.level;
+    HERE.position = Y-y;
+    siblings = children(HERE.indexes, HERE.level);
+    child_here(HERE.level);
+    return below ? 0 : item();
+  }
   if (layout_damage() || Y<=yposition_/2 || !goto_mark(FIRST_VISIBLE)) {
     goto_top();
   } else {
@@ -689,6 +1215,7 @@ void Browser::draw_item(int damage) {
   }
 
   push_matrix();
+  if (row_height_) item()->h(row_height_);
   item()->x(x);
   item()->y(y+(int(leading())-1)/2);
   item()->w(interior.w()+xposition_-inset);
@@ -850,6 +1377,7 @@ void Browser::draw() {
 bool Browser::set_item_opened(bool open)
 {
   if (!item() || item_is_open()==open || !item_is_parent()) return false;
+  Mark OLD_OPEN(OPEN);
   if (open) {
     item()->set_flag(fltk::OPENED);
     set_mark(OPEN);
@@ -860,7 +1388,13 @@ bool Browser::set_item_opened(bool open)
       else OPEN.unset();
     }
   }
-  list()->flags_changed(this, item());
+  item_flags_changed();
+  if (heights_ && !(layout_damage()&LAYOUT_DAMAGE)) {
+    // items that were open because they were in the OPEN mark may be closed:
+    if (OLD_OPEN.is_set()) heights_->refresh(this, OLD_OPEN.indexes, OLD_OPEN.level);
+    heights_->refresh(this, HERE.indexes, HERE.level);
+    goto_mark(HERE);
+  }
   relayout(LAYOUT_CHILD);
   return true;
 }
@@ -880,14 +1414,24 @@ bool Browser::set_item_visible(bool value)
     if (!item()->visible()) return false;
     item()->set_flag(INVISIBLE);
   }
-  list()->flags_changed(this, item());
-  if (HERE.open_level >= HERE.level) relayout(LAYOUT_CHILD);
+  item_flags_changed();
+  // HERE.open_level is not right after next(), so also check if the
+  // height of the browser changed:
+  bool shown = HERE.open_level >= HERE.level;
+  if (heights_ && !(layout_damage()&LAYOUT_DAMAGE)) {
+    int height = heights_->root ? heights_->root->height : 0;
+    heights_->refresh(this, HERE.indexes, HERE.level);
+    goto_mark(HERE);
+    if (heights_->root && heights_->root->height != height) shown = true;
+  }
+  if (shown) relayout(LAYOUT_CHILD);
   return true;
 }
 
 void Browser::layout() {
   // This flag is used by relayout() to indicate that autoscroll is needed:
-  bool scroll_to_item = (layout_damage()&LAYOUT_CHILD) != 0;
+  uchar damage = layout_damage();
+  bool scroll_to_item = (damage&LAYOUT_CHILD) != 0;
 
   // clear the flags first so the other methods know it is ok to measure
   // the widgets:
@@ -913,29 +1457,36 @@ void Browser::layout() {
     interior.move_y(headerh);
   }
 
-  // Measure the height of all items and find widest one, also
-  // find vertical position of focus & first visible.
-  width_ = 0;
+  // Measure the items that are new or changed, and find the widest one
+  // and the vertical position of the focus & first visible:
   int arrow_size = int(textsize())|1;
-  bool saw_first_visible = false;
-  for (goto_top(); item(); next_visible()) {
-    int border = arrow_size*HERE.level;
-    item()->x(interior.x()+border);
-    item()->w(interior.w()-border);
-    item()->layout_damage(LAYOUT_X|LAYOUT_W);
-    item()->layout();
-    //if (!indented_ && item_is_parent()) indented_ = true;
-    int w = item()->w()+border;
-    if (w > width_) width_ = w;
-    if (at_mark(FOCUS)) set_mark(FOCUS);
-    if (!saw_first_visible && HERE.position+item()->h() > yposition_) {
-      saw_first_visible = true;
-      set_mark(FIRST_VISIBLE);
+  if (row_height_) {
+    // all items are the same height, so none of them are measured:
+    if (heights_) heights_->stale = true;
+    int n = children(HERE.indexes, 0);
+    if (n < 0) n = 0;
+    width_ = n ? interior.w() : 0;
+    height_ = n*row_height_;
+    if (FOCUS.is_set() && !FOCUS.level)
+      FOCUS.position = FOCUS.indexes[0]*row_height_;
+  } else {
+    if (!heights_) heights_ = new BrowserHeights;
+    if (heights_->stale || (damage & (LAYOUT_DAMAGE|LAYOUT_CHILD))) {
+      // if only a child called relayout(), the parents that did not get
+      // LAYOUT_CHILD from it are not looked into:
+      bool deep = heights_->stale || (damage & LAYOUT_DAMAGE);
+      heights_->root = heights_->sync(this, heights_->root, 0, deep);
+      heights_->stale = false;
     }
+    BrowserHeights::Node* root = heights_->root;
+    width_ = root->shown ? interior.w() : 0;
+    if (root->maxwidth > width_) width_ = root->maxwidth;
+    height_ = root->height;
+    heights_->locate(FOCUS);
   }
-  if (!saw_first_visible) set_mark(FIRST_VISIBLE);
+  if (!goto_position(yposition_) && item()) next_visible();
+  set_mark(FIRST_VISIBLE);
   if (indented()) width_ += arrow_size;
-  height_ = HERE.position;
 
   // Do we have flexible column?
   bool has_flex = false;
@@ -1153,9 +1704,14 @@ bool Browser::make_item_visible(linepos where) {
       Widget* i = child(HERE.indexes, n);
       i->set_visible();
       i->set_flag(fltk::OPENED);
+      if (rows_ && !n) rows_->set(BrowserRows::OPENED_BITS, HERE.indexes[0], true);
       list()->flags_changed(this, item());
     }
     changed = true;
+    if (heights_ && !(layout_damage()&LAYOUT_DAMAGE)) {
+      heights_->refresh(this, HERE.indexes, HERE.level);
+      goto_mark(HERE);
+    }
     relayout(LAYOUT_CHILD);
   } else if (!layout_damage()) {
     Mark TEMP(HERE);
@@ -1236,7 +1792,7 @@ bool Browser::set_item_selected(bool value, int do_callback) {
       if (!item()->selected()) return false;
       item()->clear_selected();
     }
-    list()->flags_changed(this, item());
+    item_flags_changed();
     damage_item(HERE);
     // allow callbacks to search through items to see what is on/off
     // by remembering the current location and then restoring it
@@ -1293,18 +1849,36 @@ bool Browser::select_only_this(int do_callback) {
   if (multi()) {
     set_focus();
     bool ret = false;
-    // Turn off all other items and set damage:
-    if (goto_top()) do {
-      if (!at_mark(FOCUS))
-        if (set_item_selected(false,do_callback)) ret = true;
-    } while (next_visible());
-    // Turn off closed items:
-    nodamage = true;
-    if (goto_top()) do {
-      if (!at_mark(FOCUS))
-        if (set_item_selected(false,do_callback)) ret = true;
-    } while (next());
-    nodamage = false;
+    if (rows_) {
+      // Turn off all other top-level items without going to them:
+      int f = FOCUS.level ? -1 : FOCUS.indexes[0];
+      bool on = rows_->get(BrowserRows::SELECTED_BITS, f);
+      rows_->set(BrowserRows::SELECTED_BITS, f, false);
+      ret = rows_->clear(BrowserRows::SELECTED_BITS);
+      rows_->set(BrowserRows::SELECTED_BITS, f, on);
+      if (ret) {
+        redraw(DAMAGE_CONTENTS);
+        if (when() & do_callback) {
+          clear_changed();
+          this->do_callback();
+        } else if (do_callback) {
+          set_changed();
+        }
+      }
+    } else {
+      // Turn off all other items and set damage:
+      if (goto_top()) do {
+        if (!at_mark(FOCUS))
+          if (set_item_selected(false,do_callback)) ret = true;
+      } while (next_visible());
+      // Turn off closed items:
+      nodamage = true;
+      if (goto_top()) do {
+        if (!at_mark(FOCUS))
+          if (set_item_selected(false,do_callback)) ret = true;
+      } while (next());
+      nodamage = false;
+    }
     goto_mark(FOCUS);
     if (set_item_selected(true,do_callback)) ret = true;
     return ret;
@@ -1461,7 +2035,10 @@ int Browser::handle(int event) {
     if (multi()) {
       if (hit) {
         int direction = FOCUS.compare(HERE);
-        if (direction) {
+        if (direction && rows_ && FOCUS.is_set() && !FOCUS.level && !HERE.level) {
+          select_rows(FOCUS.indexes[0], HERE.indexes[0], drag_type, WHEN_CHANGED);
+          set_focus();
+        } else if (direction) {
           Mark TEMP(HERE);
           if (goto_mark(FOCUS)) {
             for (;;) {
@@ -1476,6 +2053,11 @@ int Browser::handle(int event) {
           set_focus();
           set_item_selected(drag_type, WHEN_CHANGED);
         }
+      } else if (rows_ && FOCUS.is_set() && !FOCUS.level) {
+        int n = children(HERE.indexes, 0);
+        select_rows(FOCUS.indexes[0], n-1, drag_type, WHEN_CHANGED);
+        goto_index(n-1);
+        set_focus(); // leave focus on last item
       } else if (goto_mark(FOCUS)) {
         // drag from inside to below last item
         for (;;) {
@@ -1554,6 +2136,16 @@ int Browser::handle(int event) {
       execute(item());
       return 1;
     default:
+      if (type_to_find_) {
+        int found = find_typed();
+        if (found > 0) {
+          bool did_callback = when()&WHEN_CHANGED;
+          select_only_this(WHEN_CHANGED);
+          if (did_callback) return 1;
+          goto RELEASE;
+        }
+        if (!found) return 1;
+      }
       if (scrollbar.send(event)) return 1;
       if (hscrollbar.send(event)) return 1;
     }
@@ -1619,6 +2211,16 @@ Widget* Browser::goto_index(const int* indexes, unsigned level) {
     item(0);
     return 0;
   }
+  if (row_height_ && !level) {
+    // all items are the same height, so the position is known:
+    HERE.level = 0;
+    HERE.open_level = 0;
+    HERE.indexes[0] = indexes[0];
+    HERE.position = indexes[0]*row_height_;
+    siblings = children(HERE.indexes, 0);
+    if (indexes[0] >= siblings) {item(0); return 0;}
+    return child_here(0);
+  }
   // go to the 0'th item if needed (otherwise go to the focus):
   if (!(indexes[0] || level) || layout_damage() || !goto_mark(FOCUS)) {
     HERE.level = 0;
@@ -1627,7 +2229,7 @@ Widget* Browser::goto_index(const int* indexes, unsigned level) {
     HERE.indexes[0] = 0;
     siblings = children(HERE.indexes,0);
     if (siblings <= 0) {item(0); return 0;}// empty browser
-    item(child(HERE.indexes,0));
+    child_here(0);
     // quit if this is correct:
     if (!level && !indexes[0]) return item();
   } else {
@@ -1646,7 +2248,7 @@ Widget* Browser::goto_index(const int* indexes, unsigned level) {
   set_level(level);
   for (unsigned n = 0; n <= level; n++)
     HERE.indexes[n] = indexes[n];
-  item(child(HERE.indexes, HERE.level));
+  child_here(HERE.level);
   return item();
 }
 
@@ -1798,6 +2400,13 @@ RETURN:
 void Browser::column_click_cb_(Widget *ww, void *d) {
   Browser *w = (Browser*)(ww->parent());
   w->selected_column_ = int(long(d));
+  if (w->click_to_sort()) {
+    // clicking the same column again reverses it:
+    if (w->sort_column() == w->selected_column_)
+      w->sort(w->selected_column_, w->sort_flags()^SORT_DESCENDING);
+    else
+      w->sort(w->selected_column_);
+  }
   w->do_callback();
   w->selected_column_ = NO_COLUMN_SELECTED;
 }
@@ -2042,6 +2651,17 @@ Browser::Browser(int X,int Y,int W,int H,const char* L)
   leaf_symbol_ = 0;
   group_symbol_ = 0;
   displaylines_ = true;
+  heights_ = 0;
+  row_height_ = 0;
+  rows_ = 0;
+  sort_ = 0;
+  click_to_sort_ = false;
+  sort_key_ = 0;
+  sort_key_arg_ = 0;
+  labels_ = 0;
+  type_to_find_ = false;
+  filter_match_ = 0;
+  filter_match_arg_ = 0;
   OPEN.unset();
   Group::current(parent());
 }
@@ -2049,6 +2669,13 @@ Browser::Browser(int X,int Y,int W,int H,const char* L)
 /*! The destructor deletes all the list items (because they are child
   fltk::Widgets of an fltk::Group) and destroys the browser. */
 Browser::~Browser() {
+  if (sort_) {
+    if (list() == sort_) list(sort_->list);
+    delete sort_;
+  }
+  delete labels_;
+  delete heights_;
+  delete rows_;
   delete[] column_widths_p;
   delete[] column_widths_i;
   if (header_) {
@@ -0,0 +1,137 @@
+/* The List a sorted or filtered Browser shows its top-level items
+   through, and the index of their labels used to find them by typing.
+   Browser_sort.cxx sorts and Browser_find.cxx filters and finds. This
+   is not a public header. */
+
+#ifndef fltk_BrowserSort_h
+#define fltk_BrowserSort_h
+
+#include <fltk/Browser.h>
+#include "GroupLabels.h"
+#include <ctype.h>
+
+namespace fltk {
+
+/* Most columns remembered by sort() */
+#define SORT_KEYS 4
+
+struct SortKey {
+  int column;
+  int flags;
+};
+
+class BrowserSorter;
+class BrowserLabels;
+
+/* The list() of a sorted or filtered browser. It passes every call on
+   to the list the browser had before, after changing the first index
+   from a position to the index of the item shown there. */
+class BrowserSort : public List {
+public:
+  BrowserSort(Browser* browser);
+  ~BrowserSort();
+  int children(const Menu*, const int* indexes, int level);
+  Widget* child(const Menu*, const int* indexes, int level);
+  void flags_changed(const Menu*, Widget*);
+
+  Browser* browser;
+  List* list;		/* the list being sorted */
+  int* order;		/* index of the item at each sorted position */
+  int count;
+  int* rows;		/* the items of order the filter shows */
+  int nrows;
+  SortKey keys[SORT_KEYS];	/* the last column sorted is first */
+  int nkeys;
+  BrowserSorter* sorter;	/* the sort being done in the background */
+
+  /* flags of each item in state: */
+  enum {SHOWN = 1, CHECKED = 2, MATCHED = 4};
+  char* text;		/* lower case text the items must contain, or null */
+  char* shown_text;	/* what SHOWN was found for, null if not known */
+  unsigned char* state;
+  int* candidates;	/* items the filter is checking, null when done */
+  int ncandidates;
+  int checked;		/* candidates checked so far */
+
+  static BrowserSort* get(Browser*);
+  /* the list holding the items, whether or not the browser is sorted */
+  static List* items(const Browser* b) {
+    return b->sort_ && b->list() == b->sort_ ? b->sort_->list : b->list();
+  }
+  bool filtered() const { return text || browser->filter_match_; }
+  void fit(int n);
+  void start();
+  void stop();
+  void install(int* neworder);
+  void poll();
+  static void timeout_cb(void* v);
+  void show();
+  int position(int index);
+  void filter(bool narrower);
+  void filter_stop();
+  bool filter_slice(int n);
+  static void filter_cb(void* v);
+
+private:
+  int* where_;		/* position of each item, or -1, made by position() */
+  bool matches(int index, const BrowserLabels* labels);
+  void display(int* newrows, int n);
+};
+
+/* Lower case copies of the labels of the top-level items, and a bit
+   for each group of 3 letters in them, so the filter can skip most of
+   the items that do not contain a text without looking at them. They
+   are also sorted, so typing finds an item with a binary search. */
+class BrowserLabels {
+public:
+  BrowserLabels();
+  ~BrowserLabels();
+  static BrowserLabels* get(Browser*);
+
+  int count;		/* items indexed */
+  bool stale;		/* copy the labels again before use */
+  char typed[64];	/* letters typed to find an item */
+  int ntyped;
+  double typed_time;	/* when the last one was typed */
+
+  const char* text(int i) const { return pool_ + entries_[i].text; }
+  bool may_contain(int i, const unsigned* trigrams) const {
+    const unsigned* t = entries_[i].trigrams;
+    return (t[0]&trigrams[0]) == trigrams[0] && (t[1]&trigrams[1]) == trigrams[1];
+  }
+  void sort();
+  /* item and text at each place in the sorted order, after sort() */
+  int item(int rank) const { return ((const int*)sorted_[rank])[-1]; }
+  const char* sorted_text(int rank) const { return sorted_[rank]; }
+  int lower_bound(const char* text) const;
+  int rank(int item) const;
+  static int find(Browser*, const char* prefix, int after);
+  static int position(Browser*, int item);
+
+  static void signature(const char* text, unsigned trigrams[2]);
+  /* Return the next letter of a label the way Menu compares them,
+     skipping @-commands and '&', in lower case, or 0 at the end */
+  static int next_letter(const char*& s) {
+    if (*s == '@') GroupLabels::skip_embedded(s);
+    if (*s == '&') s++;
+    if (!*s) return 0;
+    return tolower((unsigned char)*s++);
+  }
+
+private:
+  struct Entry {
+    int text;			/* where the label is in pool_ */
+    unsigned trigrams[2];	/* 64 bits, see signature() */
+  };
+  Entry* entries_;
+  char* pool_;		/* each label follows the int index of its item */
+  int poolsize_, poolused_;
+  const char** sorted_;	/* the labels in pool_ sorted, or null */
+  const List* list_;
+  unsigned changes_;	/* Group::changes_ of the browser when copied */
+  void build(Browser*, List*, int n);
+};
+
+} /* namespace fltk */
+
+#endif
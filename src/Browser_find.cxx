@@ -0,0 +1,411 @@
+//
+// "$Id$"
+//
+// Finding and filtering the items of the Browser widget.
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+/* Typing to find an item and filtering both used to look at every
+   item for each key. The browser keeps a lower case copy of the labels
+   instead, made again when items are added, removed or relabelled.
+   Typing does a binary search of them sorted.
+
+   The filter hides items the same way sort() moves them, by leaving
+   them out of the BrowserSort list. It checks the items a slice at a
+   time from a timeout, showing what it found so far, and only looks at
+   the items still shown when the text gets longer. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fltk/run.h>
+#include <fltk/events.h>
+#include "BrowserSort.h"
+
+using namespace fltk;
+
+/* Browsers with fewer items than this are filtered right away */
+#define FILTER_NOW 10000
+
+/* Items checked by the filter each time the timeout is called */
+#define FILTER_SLICE 50000
+
+/* Seconds after which the next letter typed starts a new search */
+#define TYPE_TIME 1.0
+
+////////////////////////////////////////////////////////////////
+// BrowserLabels
+
+BrowserLabels::BrowserLabels()
+  : count(0), stale(true), ntyped(0), typed_time(0),
+    entries_(0), pool_(0), poolsize_(0), poolused_(0), sorted_(0),
+    list_(0), changes_(0) {
+  typed[0] = 0;
+}
+
+BrowserLabels::~BrowserLabels() {
+  free(entries_);
+  free(pool_);
+  free(sorted_);
+}
+
+/* Return the labels of the browser's items, copying them again if any
+   child of the browser was added, removed, moved or relabelled since,
+   or the list() has a different number of items */
+BrowserLabels* BrowserLabels::get(Browser* b) {
+  if (!b->labels_) b->labels_ = new BrowserLabels;
+  BrowserLabels* l = b->labels_;
+  List* list = BrowserSort::items(b);
+  int n = list->children(b, 0, 0);
+  if (n < 0) n = 0;
+  if (l->stale || n != l->count || list != l->list_ ||
+      b->changes_ != l->changes_) l->build(b, list, n);
+  return l;
+}
+
+/* Set one of 64 bits for each 3 letters in a row in the text. An item
+   that is missing any of the bits of a text cannot contain it. */
+void BrowserLabels::signature(const char* text, unsigned trigrams[2]) {
+  trigrams[0] = trigrams[1] = 0;
+  const unsigned char* s = (const unsigned char*)text;
+  for (; s[0] && s[1] && s[2]; s++) {
+    unsigned h = (((s[0]*31u) + s[1])*31u + s[2]) * 2654435761u >> 26;
+    trigrams[h>>5] |= 1u << (h&31);
+  }
+}
+
+void BrowserLabels::build(Browser* b, List* list, int n) {
+  entries_ = (Entry*)realloc(entries_, (n ? n : 1)*sizeof(Entry));
+  free(sorted_);
+  sorted_ = 0;
+  poolused_ = 0;
+  for (int i = 0; i < n; i++) {
+    Widget* w = list->child(b, &i, 0);
+    const char* label = w ? w->label() : 0;
+    if (!label) label = "";
+    /* the index of the item goes before its label, lined up for an int: */
+    int at = (poolused_ + int(sizeof(int)) - 1) & ~(int(sizeof(int)) - 1);
+    int need = at + int(sizeof(int)) + int(strlen(label)) + 1;
+    if (need > poolsize_) {
+      poolsize_ = poolsize_ ? 2*poolsize_ : 64*1024;
+      while (need > poolsize_) poolsize_ *= 2;
+      pool_ = (char*)realloc(pool_, poolsize_);
+    }
+    *(int*)(pool_ + at) = i;
+    char* t = pool_ + at + sizeof(int);
+    entries_[i].text = t - pool_;
+    int c;
+    while ((c = next_letter(label))) *t++ = c;
+    *t = 0;
+    poolused_ = t + 1 - pool_;
+    signature(pool_ + entries_[i].text, entries_[i].trigrams);
+  }
+  count = n;
+  list_ = list;
+  changes_ = b->changes_;
+  stale = false;
+}
+
+static int compare_labels(const void* a, const void* b) {
+  const char* x = *(const char**)a;
+  const char* y = *(const char**)b;
+  int c = strcmp(x, y);
+  if (c) return c;
+  /* the same labels stay in the order of the items: */
+  return x < y ? -1 : 1;
+}
+
+/* Sort the labels, if they were not sorted since they were copied */
+void BrowserLabels::sort() {
+  if (sorted_) return;
+  sorted_ = (const char**)malloc((count ? count : 1)*sizeof(const char*));
+  for (int i = 0; i < count; i++) sorted_[i] = text(i);
+  qsort(sorted_, count, sizeof(const char*), compare_labels);
+}
+
+/* Return the first place in the sorted order of a label not less
+   than text, which is the first one starting with it if there is one */
+int BrowserLabels::lower_bound(const char* text) const {
+  int lo = 0;
+  int hi = count;
+  while (lo < hi) {
+    int m = (lo + hi) / 2;
+    if (strcmp(sorted_[m], text) < 0) lo = m+1;
+    else hi = m;
+  }
+  return lo;
+}
+
+/* Return the place of an item in the sorted order */
+int BrowserLabels::rank(int item) const {
+  const char* t = text(item);
+  for (int r = lower_bound(t); r < count && !strcmp(sorted_[r], t); r++)
+    if (sorted_[r] == t) return r;
+  return -1;
+}
+
+/* Return the position an item is shown at, or -1 if it is hidden */
+int BrowserLabels::position(Browser* b, int item) {
+  int p = b->sort_ && b->list() == b->sort_ ? b->sort_->position(item) : item;
+  if (p < 0) return -1;
+  Widget* w = BrowserSort::items(b)->child(b, &item, 0);
+  return w && w->visible() ? p : -1;
+}
+
+static bool starts_with(const char* label, const char* prefix) {
+  for (; *prefix; prefix++)
+    if (BrowserLabels::next_letter(label) != (unsigned char)*prefix)
+      return false;
+  return true;
+}
+
+/* Return the position of the first item shown whose label starts with
+   the lower case prefix, in the sorted order of the labels. If after
+   is an item starting with it, the one after that is found, going
+   around to the first if it is the last. Returns -1 if none is found. */
+int BrowserLabels::find(Browser* b, const char* prefix, int after) {
+  int len = strlen(prefix);
+  for (int tries = 0; tries < 2; tries++) {
+    BrowserLabels* l = get(b);
+    l->sort();
+    int first = l->lower_bound(prefix);
+    int start = first;
+    if (after >= 0 && after < l->count && !strncmp(l->text(after), prefix, len))
+      start = l->rank(after) + 1;
+    int item = -1;
+    int p = -1;
+    for (int pass = 0; pass < 2 && p < 0; pass++) {
+      for (int r = pass ? first : start;
+           r < l->count && !strncmp(l->sorted_text(r), prefix, len); r++) {
+        item = l->item(r);
+        p = position(b, item);
+        if (p >= 0) break;
+      }
+      if (start == first) break;
+    }
+    if (p < 0) return -1;
+    /* copy the labels again if the list() changed this one: */
+    Widget* w = BrowserSort::items(b)->child(b, &item, 0);
+    if (!w || starts_with(w->label() ? w->label() : "", prefix)) return p;
+    l->stale = true;
+  }
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////
+// BrowserSort filter
+
+/* Stop checking the items, leaving the ones shown before */
+void BrowserSort::filter_stop() {
+  remove_timeout(filter_cb, this);
+  free(candidates);
+  candidates = 0;
+  ncandidates = checked = 0;
+}
+
+/* Start showing only the items that match. If narrower is true, all
+   the items that match now are among the ones shown, so only they are
+   checked. Large browsers are checked in the background. */
+void BrowserSort::filter(bool narrower) {
+  filter_stop();
+  fit(list->children(browser, 0, 0));
+  if (!filtered()) {
+    for (int i = 0; i < count; i++) state[i] = SHOWN;
+    free(shown_text);
+    shown_text = strdup("");
+    show();
+    return;
+  }
+  if (!shown_text) narrower = false;
+  unsigned trigrams[2] = {0, 0};
+  const BrowserLabels* labels = 0;
+  if (text) {
+    labels = BrowserLabels::get(browser);
+    BrowserLabels::signature(text, trigrams);
+  }
+  candidates = (int*)malloc((count ? count : 1)*sizeof(int));
+  /* the candidates are put in the order shown, so the first items
+     shown are found first: */
+  for (int i = 0; i < count; i++) {
+    int c = order[i];
+    state[c] &= SHOWN;
+    if ((!narrower || (state[c] & SHOWN)) &&
+        (!labels || labels->may_contain(c, trigrams)))
+      candidates[ncandidates++] = c;
+    else
+      state[c] |= CHECKED;
+  }
+  if (count < FILTER_NOW) filter_slice(count);
+  else if (!filter_slice(FILTER_SLICE)) add_timeout(0, filter_cb, this);
+}
+
+bool BrowserSort::matches(int index, const BrowserLabels* labels) {
+  if (labels && !strstr(labels->text(index), text)) return false;
+  if (browser->filter_match_) {
+    Widget* w = list->child(browser, &index, 0);
+    if (!w || !browser->filter_match_(w, index, browser->filter_match_arg_))
+      return false;
+  }
+  return true;
+}
+
+/* Check the next n candidates, and show the items found so far.
+   Returns true when all of them are checked. */
+bool BrowserSort::filter_slice(int n) {
+  const BrowserLabels* labels = text ? BrowserLabels::get(browser) : 0;
+  for (; checked < ncandidates && n > 0; checked++, n--) {
+    int c = candidates[checked];
+    if (c >= count) continue;
+    if (matches(c, labels)) state[c] |= MATCHED;
+    state[c] |= CHECKED;
+  }
+  bool done = checked >= ncandidates;
+  if (done) {
+    for (int i = 0; i < count; i++) state[i] = (state[i] & MATCHED) ? SHOWN : 0;
+    free(shown_text);
+    shown_text = strdup(text ? text : "");
+    free(candidates);
+    candidates = 0;
+    ncandidates = checked = 0;
+  }
+  show();
+  return done;
+}
+
+void BrowserSort::filter_cb(void* v) {
+  BrowserSort* s = (BrowserSort*)v;
+  /* start over if items were added or removed: */
+  if (!s->candidates) {s->filter(false); return;}
+  if (!s->filter_slice(FILTER_SLICE)) repeat_timeout(0, filter_cb, v);
+}
+
+////////////////////////////////////////////////////////////////
+// Browser
+
+static char* lower_case(const char* text) {
+  char* r = (char*)malloc(strlen(text)+1);
+  char* p = r;
+  while (*text) *p++ = tolower((unsigned char)*text++);
+  *p = 0;
+  return r;
+}
+
+/*! Show only the top-level items whose label contains \a text,
+  ignoring upper and lower case, @-commands and '&' characters. A null
+  or empty \a text shows all of them again.
+
+  The items are not moved or hidden. Like sort(), the browser leaves
+  them out of the positions it shows and counts, see sort_index().
+  The focus is unset if its item is left out.
+
+  The browser keeps a lower case copy of the labels, made again when
+  items are added, removed or relabelled, so each call
+  only checks the items that may contain \a text. If \a text contains
+  the text before, only the items shown are checked. A large browser
+  is checked in the background, showing the items found so far, see
+  filtering().
+*/
+void Browser::filter_text(const char* text) {
+  char* lower = text && *text ? lower_case(text) : 0;
+  if (!lower && !filter_match_ && !(sort_ && list() == sort_)) return;
+  BrowserSort* s = BrowserSort::get(this);
+  bool narrower = s->shown_text && strstr(lower ? lower : "", s->shown_text);
+  free(s->text);
+  s->text = lower;
+  s->filter(narrower);
+  if (!s->filtered() && !s->nkeys) unsort();
+}
+
+/*! Returns the text passed to filter_text() in lower case, or null */
+const char* Browser::filter_text() const {
+  return sort_ ? sort_->text : 0;
+}
+
+/*! Show only the top-level items for which \a cb returns true, and
+  which contain the filter_text(). It is passed each item and its index
+  in the list(), the same as sort_index() returns. Call this again,
+  even with the same callback, when what it returns may have changed.
+  A null \a cb shows all of them again. This is how FileBrowser::filter()
+  hides files. */
+void Browser::filter_match(Browser_Match_Cb cb, void* arg) {
+  if (!cb && !(sort_ && list() == sort_)) {filter_match_ = 0; return;}
+  BrowserSort* s = BrowserSort::get(this);
+  filter_match_ = cb;
+  filter_match_arg_ = arg;
+  free(s->shown_text);
+  s->shown_text = 0;
+  s->filter(false);
+  if (!s->filtered() && !s->nkeys) unsort();
+}
+
+/*! Returns true while the filter is checking items in the background */
+bool Browser::filtering() const {
+  return sort_ && sort_->candidates;
+}
+
+/*! Returns the position of the first item shown whose label starts
+  with \a text, ignoring upper and lower case, in the order of the
+  labels rather than the positions, or -1 if there is none. This does a
+  binary search of the copy of the labels kept for filter_text(). */
+int Browser::find_prefix(const char* text) {
+  char* lower = lower_case(text ? text : "");
+  int p = BrowserLabels::find(this, lower, -1);
+  free(lower);
+  return p;
+}
+
+/* Go to the item starting with the letters typed so far, for
+   type_to_find(). Typing the same letter again goes to the next item
+   starting with it. Returns 1 if it found one, 0 if the key was used
+   but none was found, or -1 if the key is not a letter. */
+int Browser::find_typed() {
+  const char* t = event_text();
+  int n = event_length();
+  if (n < 1 || (unsigned char)t[0] <= ' ' || t[0] == 127 ||
+      event_state(CTRL|ALT|META)) return -1;
+  BrowserLabels* l = BrowserLabels::get(this);
+  double now = get_time_secs();
+  if (now - l->typed_time > TYPE_TIME) l->ntyped = 0;
+  l->typed_time = now;
+  char c = tolower((unsigned char)t[0]);
+  bool again = n == 1 && l->ntyped > 0;
+  for (int i = 0; again && i < l->ntyped; i++)
+    if (l->typed[i] != c) again = false;
+  for (int i = 0; i < n && l->ntyped < int(sizeof(l->typed))-1; i++)
+    l->typed[l->ntyped++] = tolower((unsigned char)t[i]);
+  l->typed[l->ntyped] = 0;
+  int p = -1;
+  if (again) {
+    char letter[2] = {c, 0};
+    int after = FOCUS.is_set() && !FOCUS.level ? sort_index(FOCUS.indexes[0]) : -1;
+    p = BrowserLabels::find(this, letter, after);
+  } else {
+    p = BrowserLabels::find(this, l->typed, -1);
+  }
+  if (p < 0) return 0;
+  goto_index(p);
+  return 1;
+}
+
+//
+// End of "$Id$".
+//
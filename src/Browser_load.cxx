@@ -25,9 +25,9 @@
 //    http://www.fltk.org/str.php
 //
 
-#include <fltk/events.h>
 #include <fltk/Browser.h>
-#include <stdio.h>
+#include <fltk/Item.h>
+#include <fltk/StringList.h>
 
 using namespace fltk;
 
@@ -35,29 +35,32 @@ using namespace fltk;
     This is useful if the browser was storing items that should be saved
     on program exit and reloaded next time the program is started
 
+    Each line becomes an Item with a copy of the line as the label,
+    exactly as it is in the file (it is not split at '/' like add()
+    does). For very big files it is much faster and smaller to
+    load them into a StringLines and make that the list() of the
+    browser, so no widget is created for each line.
+
     \param filename The name of the file to load
-    \return 0 if the file couldn't be opened, -1 if filename is NULL or
-    contains no text and 1 otherwise
+    \return 0 if the file couldn't be opened or is too big to read into
+    memory, -1 if filename is NULL or contains no text and 1 otherwise
 */
 int Browser::load(const char *filename) {
-#define MAXBLINE 1024
-  char newtext[MAXBLINE];
-  int c;
-  int i;
   clear();
-  if (!filename || !(filename[0])) return -1;
-  FILE *fl = fopen(filename,"r");
-  if (!fl) return 0;
-  i = 0;
-  do {
-    c = getc(fl);
-    if (c == '\n' || c <= 0 || i>=(MAXBLINE-1)) {
-      newtext[i] = 0;
-      add(newtext);
-      i = 0;
-    } else newtext[i++] = c;
-  } while (c >= 0);
-  fclose(fl);
+  StringLines lines;
+  int r = lines.load(filename);
+  if (r <= 0) return r;
+  Group* saved = Group::current();
+  Group::current(0);
+  int n = lines.children(this);
+  reserve(n);
+  for (int i = 0; i < n; i++) {
+    Widget* o = new Item();
+    o->copy_label(lines.label(this, i));
+    add(o);
+  }
+  Group::current(saved);
+  relayout();
   return 1;
 }
 
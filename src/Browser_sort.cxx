@@ -0,0 +1,728 @@
+//
+// "$Id$"
+//
+// Sorting the items of the Browser widget.
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+/* A sorted or filtered browser has a BrowserSort as its list(). It
+   passes every call on to the list the browser had before, after
+   changing the first index from a position to the index of the item
+   shown there. No widget is moved, and the rest of Browser only ever
+   sees positions. The filter is in Browser_find.cxx.
+
+   Sorting copies the keys of every item, a slice at a time from a
+   timeout, as only the main thread may look at the items.  Threads
+   then sort runs of the copy, and then merge pairs of runs, until
+   there is one.  The timeout starts each round of merges when the one
+   before it is done, and puts the new order in place at the end. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fltk/run.h>
+#include "BrowserSort.h"
+
+#if HAVE_PTHREAD || (defined(_WIN32) && !defined(__CYGWIN__))
+# define USE_SORT_THREADS 1
+# include <fltk/Threads.h>
+# if !defined(_WIN32) || defined(__CYGWIN__)
+#  include <unistd.h>
+# endif
+#else
+# define USE_SORT_THREADS 0
+#endif
+
+using namespace fltk;
+
+/* Browsers with fewer items than this are sorted right away */
+#define SORT_NOW 10000
+
+/* Items whose keys are copied each time the timeout is called */
+#define SORT_SLICE 20000
+
+/* Smallest run of items sorted by one job */
+#define SORT_RUN 4096
+
+/* Most threads sorting for one browser */
+#define SORT_THREADS 8
+
+/* How often the main thread checks on the threads, in seconds */
+#define SORT_POLL_TIME .02f
+
+namespace fltk {
+
+/* The copied keys and the order being sorted. This is shared with the
+   threads, and deleted when the browser and the threads let go. */
+class BrowserSorter {
+public:
+  BrowserSorter(int n, const SortKey* keys, int nkeys);
+  void release();
+  int count() const { return n_; }
+  bool copy(Browser* browser, List* list, Browser_Key_Cb cb, void* arg,
+            int rows);
+  void sort_all();
+  bool poll();
+  int* take_order() { int* o = order_; order_ = 0; return o; }
+
+private:
+  /* a run to sort if mid < 0, otherwise two sorted runs to merge */
+  struct Job {
+    int from, mid, to;
+  };
+
+#if USE_SORT_THREADS
+  Mutex mutex_;
+#endif
+  /* shared by the threads, protected by lock() */
+  Job* jobs_;		/* the jobs of this round */
+  int njobs_;
+  int waiting_;		/* first job no thread has taken */
+  int done_;		/* jobs of this round that are finished */
+  int running_;		/* threads sorting */
+  bool quit_;
+  int refs_;
+
+  /* written by the main thread, read by the threads once copied */
+  int n_;
+  SortKey keys_[SORT_KEYS];
+  int nkeys_;
+  int* text_[SORT_KEYS];	/* where the key of each item is in pool_ */
+  double* number_[SORT_KEYS];	/* or its value for SORT_NUMERIC */
+  char* pool_;
+  int poolsize_, poolused_;
+  int* order_;		/* index of the item at each position */
+  int* temp_;		/* merged into, then copied back to order_ */
+
+  /* used by the main thread */
+  int copied_;		/* items whose keys have been copied */
+  int threads_;		/* most threads to start */
+
+  ~BrowserSorter();
+  void lock() {
+#if USE_SORT_THREADS
+    mutex_.lock();
+#endif
+  }
+  void unlock() {
+#if USE_SORT_THREADS
+    mutex_.unlock();
+#endif
+  }
+  int compare(int a, int b) const;
+  void merge(const int* src, int from, int mid, int to, int* dst) const;
+  void sort_run(int from, int to);
+  void run(const Job& job);
+  void start_threads();
+  static void* thread(void* v);
+};
+
+} /* namespace fltk */
+
+#if USE_SORT_THREADS
+/* Number of threads to sort with, one for each processor */
+static int cpu_count() {
+# if defined(_WIN32) && !defined(__CYGWIN__)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = info.dwNumberOfProcessors;
+# elif defined(_SC_NPROCESSORS_ONLN)
+  int n = sysconf(_SC_NPROCESSORS_ONLN);
+# else
+  int n = 1;
+# endif
+  if (n < 1) n = 1;
+  return n > SORT_THREADS ? SORT_THREADS : n;
+}
+#else
+# define cpu_count() 0
+#endif
+
+////////////////////////////////////////////////////////////////
+// BrowserSorter
+
+BrowserSorter::BrowserSorter(int n, const SortKey* keys, int nkeys)
+  : jobs_(0), njobs_(0), waiting_(0), done_(0), running_(0), quit_(false),
+    refs_(1), n_(n), nkeys_(nkeys), pool_(0), poolsize_(0), poolused_(0),
+    copied_(0), threads_(cpu_count()) {
+  for (int k = 0; k < nkeys; k++) {
+    keys_[k] = keys[k];
+    text_[k] = 0;
+    number_[k] = 0;
+    if (keys[k].flags & Browser::SORT_NUMERIC)
+      number_[k] = (double*)malloc(n*sizeof(double));
+    else
+      text_[k] = (int*)malloc(n*sizeof(int));
+  }
+  order_ = (int*)malloc(n*sizeof(int));
+  temp_ = (int*)malloc(n*sizeof(int));
+  /* ties are left in the order of the children: */
+  for (int i = 0; i < n; i++) order_[i] = i;
+}
+
+BrowserSorter::~BrowserSorter() {
+  for (int k = 0; k < nkeys_; k++) {
+    free(text_[k]);
+    free(number_[k]);
+  }
+  free(pool_);
+  free(order_);
+  free(temp_);
+  delete[] jobs_;
+}
+
+/* Called by the browser instead of deleting this, the threads still
+   sorting delete it when they are done */
+void BrowserSorter::release() {
+  lock();
+  quit_ = true;
+  bool last = !--refs_;
+  unlock();
+  if (last) delete this;
+}
+
+/* Return the text of a column of an item, which is the part of its
+   label between tabs, unless the browser has a sort_key(). */
+static const char* column_text(Widget* item, int column,
+                               Browser_Key_Cb cb, void* arg, int& length) {
+  const char* s;
+  if (cb) {
+    s = item ? cb(item, column, arg) : 0;
+    if (!s) s = "";
+    length = strlen(s);
+    return s;
+  }
+  s = item ? item->label() : 0;
+  if (!s) {length = 0; return "";}
+  for (; column > 0; column--) {
+    s = strchr(s, '\t');
+    if (!s) {length = 0; return "";}
+    s++;
+  }
+  GroupLabels::skip_embedded(s);
+  const char* e = strchr(s, '\t');
+  length = e ? e-s : strlen(s);
+  return s;
+}
+
+/* Copy the keys of the next \a rows items, return true if they are all
+   copied. This is called by the main thread. */
+bool BrowserSorter::copy(Browser* browser, List* list, Browser_Key_Cb cb,
+                         void* arg, int rows) {
+  int end = n_ - copied_ > rows ? copied_ + rows : n_;
+  for (int i = copied_; i < end; i++) {
+    Widget* item = list->child(browser, &i, 0);
+    for (int k = 0; k < nkeys_; k++) {
+      int length;
+      const char* s = column_text(item, keys_[k].column, cb, arg, length);
+      if (number_[k]) {
+        char buffer[64];
+        if (length > 63) length = 63;
+        memcpy(buffer, s, length);
+        buffer[length] = 0;
+        number_[k][i] = strtod(buffer, 0);
+        continue;
+      }
+      if (poolused_ + length + 1 > poolsize_) {
+        poolsize_ = poolsize_ ? 2*poolsize_ : 64*1024;
+        while (poolused_ + length + 1 > poolsize_) poolsize_ *= 2;
+        pool_ = (char*)realloc(pool_, poolsize_);
+      }
+      text_[k][i] = poolused_;
+      memcpy(pool_ + poolused_, s, length);
+      pool_[poolused_ + length] = 0;
+      poolused_ += length + 1;
+    }
+  }
+  copied_ = end;
+  return copied_ >= n_;
+}
+
+static int nocase_compare(const char* a, const char* b) {
+  for (;; a++, b++) {
+    int x = tolower((unsigned char)*a);
+    int y = tolower((unsigned char)*b);
+    if (x != y || !x) return x - y;
+  }
+}
+
+/* Compare the keys of two items, negative if a goes before b */
+int BrowserSorter::compare(int a, int b) const {
+  for (int k = 0; k < nkeys_; k++) {
+    int c;
+    if (number_[k]) {
+      double x = number_[k][a];
+      double y = number_[k][b];
+      c = x < y ? -1 : x > y;
+    } else if (keys_[k].flags & Browser::SORT_NOCASE) {
+      c = nocase_compare(pool_ + text_[k][a], pool_ + text_[k][b]);
+    } else {
+      c = strcmp(pool_ + text_[k][a], pool_ + text_[k][b]);
+    }
+    if (c) return keys_[k].flags & Browser::SORT_DESCENDING ? -c : c;
+  }
+  return 0;
+}
+
+/* Merge the sorted runs src[from..mid) and src[mid..to) into dst. An
+   item of the second run only goes first if it is less, so equal ones
+   stay in the order they were. */
+void BrowserSorter::merge(const int* src, int from, int mid, int to,
+                          int* dst) const {
+  int i = from, j = mid, k = from;
+  while (i < mid && j < to)
+    dst[k++] = compare(src[j], src[i]) < 0 ? src[j++] : src[i++];
+  memcpy(dst + k, src + i, (mid - i) * sizeof(int));
+  k += mid - i;
+  memcpy(dst + k, src + j, (to - j) * sizeof(int));
+}
+
+/* Sort order_[from..to), using the same part of temp_ */
+void BrowserSorter::sort_run(int from, int to) {
+  /* insertion sort short pieces: */
+  const int piece = 16;
+  for (int a = from; a < to; a += piece) {
+    int e = to - a > piece ? a + piece : to;
+    for (int i = a + 1; i < e; i++) {
+      int x = order_[i];
+      int j = i;
+      for (; j > a && compare(x, order_[j-1]) < 0; j--) order_[j] = order_[j-1];
+      order_[j] = x;
+    }
+  }
+  /* then merge them back and forth between order_ and temp_: */
+  int* src = order_;
+  int* dst = temp_;
+  for (int w = piece; w < to - from; w *= 2) {
+    for (int a = from; a < to; a += 2*w) {
+      int m = to - a > w ? a + w : to;
+      int e = to - m > w ? m + w : to;
+      merge(src, a, m, e, dst);
+    }
+    int* t = src; src = dst; dst = t;
+  }
+  if (src != order_) memcpy(order_ + from, src + from, (to - from) * sizeof(int));
+}
+
+void BrowserSorter::run(const Job& job) {
+  if (job.mid < 0) {
+    sort_run(job.from, job.to);
+  } else {
+    merge(order_, job.from, job.mid, job.to, temp_);
+    memcpy(order_ + job.from, temp_ + job.from,
+           (job.to - job.from) * sizeof(int));
+  }
+}
+
+/* Sort everything in the main thread */
+void BrowserSorter::sort_all() {
+  sort_run(0, n_);
+}
+
+void* BrowserSorter::thread(void* v) {
+  BrowserSorter* s = (BrowserSorter*)v;
+  s->lock();
+  while (!s->quit_ && s->waiting_ < s->njobs_) {
+    Job job = s->jobs_[s->waiting_++];
+    s->unlock();
+    s->run(job);
+    s->lock();
+    s->done_++;
+  }
+  s->running_--;
+  bool last = !--s->refs_;
+  s->unlock();
+  if (last) delete s;
+  return 0;
+}
+
+/* Start threads for the waiting jobs. The threads end when there are
+   none left, so none are left running between rounds. */
+void BrowserSorter::start_threads() {
+  lock();
+#if USE_SORT_THREADS
+  while (waiting_ + running_ < njobs_ && running_ < threads_) {
+    Thread t;
+# if defined(_WIN32) && !defined(__CYGWIN__)
+    bool ok = create_thread(t, thread, this) != -1;
+# else
+    bool ok = !create_thread(t, thread, this);
+    if (ok) pthread_detach(t);
+# endif
+    if (!ok) {
+      threads_ = running_;
+      break;
+    }
+    /* the thread waits for the lock, so this is counted before it runs */
+    running_++;
+    refs_++;
+  }
+#endif
+  /* without threads the main thread does a job each time */
+  Job job;
+  bool mine = !running_ && waiting_ < njobs_;
+  if (mine) job = jobs_[waiting_++];
+  unlock();
+  if (mine) {
+    run(job);
+    lock();
+    done_++;
+    unlock();
+  }
+}
+
+/* Start the next round of jobs when one is done. Returns true when
+   order_ is sorted. This is called by the main thread once the keys
+   are copied. */
+bool BrowserSorter::poll() {
+  lock();
+  if (!jobs_) {
+    /* split the items into a run for each job, a power of 2 of them
+       so they can be merged in pairs: */
+    int runs = 1;
+    while (runs < 2*threads_ && n_ / (2*runs) >= SORT_RUN) runs *= 2;
+    jobs_ = new Job[runs];
+    for (int i = 0; i < runs; i++) {
+      jobs_[i].from = int((double)n_ * i / runs);
+      jobs_[i].to = int((double)n_ * (i+1) / runs);
+      jobs_[i].mid = -1;
+    }
+    njobs_ = runs;
+  } else if (done_ == njobs_) {
+    if (njobs_ == 1 && jobs_[0].from == 0 && jobs_[0].to == n_) {
+      unlock();
+      return true;
+    }
+    for (int i = 0; i < njobs_/2; i++) {
+      jobs_[i].from = jobs_[2*i].from;
+      jobs_[i].mid = jobs_[2*i].to;
+      jobs_[i].to = jobs_[2*i+1].to;
+    }
+    njobs_ /= 2;
+    waiting_ = done_ = 0;
+  }
+  unlock();
+  start_threads();
+  return false;
+}
+
+////////////////////////////////////////////////////////////////
+// BrowserSort
+
+BrowserSort::BrowserSort(Browser* b)
+  : browser(b), list(b->list()), order(0), count(0), rows(0), nrows(0),
+    nkeys(0), sorter(0), text(0), shown_text(strdup("")), state(0),
+    candidates(0), ncandidates(0), checked(0), where_(0) {
+}
+
+BrowserSort::~BrowserSort() {
+  stop();
+  filter_stop();
+  free(order);
+  free(rows);
+  free(state);
+  free(where_);
+  free(text);
+  free(shown_text);
+}
+
+/* Return the list() of the browser, making it if needed. If the
+   browser was given another list since, that one is sorted and
+   filtered instead. */
+BrowserSort* BrowserSort::get(Browser* b) {
+  if (!b->sort_) b->sort_ = new BrowserSort(b);
+  BrowserSort* s = b->sort_;
+  if (b->list() != s) {
+    s->stop();
+    s->filter_stop();
+    s->list = b->list();
+    s->fit(0);
+    /* start out showing what the browser showed: */
+    s->fit(s->list->children(b, 0, 0));
+    b->list(s);
+  }
+  return s;
+}
+
+/* Make the order fit n items, after they were added or removed. The
+   ones removed are dropped from it and the new ones go at the end, so
+   mostly the right order is shown until they are sorted again. New
+   items are not shown by a filter until it looks at them. */
+void BrowserSort::fit(int n) {
+  if (n < 0) n = 0;
+  if (n == count) return;
+  if (n < count) {
+    int j = 0;
+    for (int i = 0; i < count; i++) if (order[i] < n) order[j++] = order[i];
+    j = 0;
+    for (int i = 0; i < nrows; i++) if (rows[i] < n) rows[j++] = rows[i];
+    nrows = j;
+  } else {
+    order = (int*)realloc(order, n*sizeof(int));
+    rows = (int*)realloc(rows, n*sizeof(int));
+    state = (unsigned char*)realloc(state, n);
+    bool f = filtered();
+    for (int i = count; i < n; i++) {
+      order[i] = i;
+      state[i] = f ? 0 : SHOWN;
+      if (!f) rows[nrows++] = i;
+    }
+    if (f) {free(shown_text); shown_text = 0;}
+  }
+  count = n;
+  free(where_);
+  where_ = 0;
+}
+
+/* Copy an index array, changing the first one from a position to the
+   index of the item shown there */
+class SortedIndexes {
+  int buffer[16];
+  int* p;
+public:
+  SortedIndexes(const BrowserSort* s, const int* indexes, int level) {
+    p = level < 16 ? buffer : new int[level+1];
+    memcpy(p, indexes, (level+1)*sizeof(int));
+    if (p[0] >= 0) p[0] = p[0] < s->nrows ? s->rows[p[0]] : -1;
+  }
+  ~SortedIndexes() {if (p != buffer) delete[] p;}
+  operator const int*() const {return p;}
+};
+
+int BrowserSort::children(const Menu* menu, const int* indexes, int level) {
+  if (level) return list->children(menu, SortedIndexes(this, indexes, level), level);
+  int n = list->children(menu, indexes, 0);
+  if (n < 0) return n;
+  if (n != count) {
+    fit(n);
+    /* sort and filter the changed items again after the browser is
+       done with them */
+    if (nkeys && !sorter) add_timeout(0, timeout_cb, this);
+    if (filtered()) {
+      filter_stop();
+      add_timeout(0, filter_cb, this);
+    }
+  }
+  return nrows;
+}
+
+Widget* BrowserSort::child(const Menu* menu, const int* indexes, int level) {
+  return list->child(menu, SortedIndexes(this, indexes, level), level);
+}
+
+void BrowserSort::flags_changed(const Menu* menu, Widget* widget) {
+  list->flags_changed(menu, widget);
+}
+
+/* Stop the sort being done */
+void BrowserSort::stop() {
+  remove_timeout(timeout_cb, this);
+  if (sorter) {
+    sorter->release();
+    sorter = 0;
+  }
+}
+
+/* Sort by the keys, in the background if there are lots of items */
+void BrowserSort::start() {
+  stop();
+  fit(list->children(browser, 0, 0));
+  sorter = new BrowserSorter(count, keys, nkeys);
+  if (count < SORT_NOW) {
+    sorter->copy(browser, list, browser->sort_key_, browser->sort_key_arg_,
+                 count);
+    sorter->sort_all();
+    poll();
+  } else {
+    add_timeout(0, timeout_cb, this);
+  }
+}
+
+/* Show the items in a new order */
+void BrowserSort::install(int* neworder) {
+  free(order);
+  order = neworder;
+  show();
+}
+
+/* Show the items of order that the filter lets through. While it is
+   still checking them, the ones it has not got to yet are shown if
+   they were before. */
+void BrowserSort::show() {
+  int* newrows = (int*)malloc(count*sizeof(int));
+  int n = 0;
+  bool f = filtered();
+  for (int i = 0; i < count; i++) {
+    int c = order[i];
+    int s = state[c];
+    if (!f || (candidates && (s & CHECKED) ? s & MATCHED : s & SHOWN))
+      newrows[n++] = c;
+  }
+  display(newrows, n);
+}
+
+/* Show newrows instead of rows, moving the focus and the flags kept
+   by the browser along with the items */
+void BrowserSort::display(int* newrows, int n) {
+  if (n == nrows && (!n || !memcmp(newrows, rows, n*sizeof(int)))) {
+    free(newrows);
+    return;
+  }
+  int* from = (int*)malloc(n*sizeof(int));
+  for (int i = 0; i < n; i++) from[i] = position(newrows[i]);
+  free(rows);
+  rows = newrows;
+  nrows = n;
+  free(where_);
+  where_ = 0;
+  browser->reorder(from, n);
+  free(from);
+}
+
+/* Return the position an item is shown at, or -1 if it is not shown */
+int BrowserSort::position(int index) {
+  if (index < 0 || index >= count) return -1;
+  if (!where_) {
+    where_ = (int*)malloc(count*sizeof(int));
+    for (int i = 0; i < count; i++) where_[i] = -1;
+    for (int i = 0; i < nrows; i++) where_[rows[i]] = i;
+  }
+  return where_[index];
+}
+
+void BrowserSort::poll() {
+  if (!sorter) {start(); return;}
+  /* start over if the items were added or removed: */
+  int n = list->children(browser, 0, 0);
+  if (n < 0) n = 0;
+  if (n != sorter->count()) {start(); return;}
+  if (!sorter->copy(browser, list, browser->sort_key_,
+                    browser->sort_key_arg_, SORT_SLICE)) {
+    repeat_timeout(0, timeout_cb, this);
+    return;
+  }
+  if (sorter->count() >= SORT_NOW && !sorter->poll()) {
+    repeat_timeout(SORT_POLL_TIME, timeout_cb, this);
+    return;
+  }
+  remove_timeout(timeout_cb, this);
+  fit(n);
+  int* neworder = sorter->take_order();
+  sorter->release();
+  sorter = 0;
+  install(neworder);
+}
+
+void BrowserSort::timeout_cb(void* v) {
+  ((BrowserSort*)v)->poll();
+}
+
+////////////////////////////////////////////////////////////////
+// Browser
+
+/*! Show the top-level items sorted by \a column, which the browser
+  remembers along with the columns sorted by before, up to 4 of
+  them. Items that are the same in \a column are left in the order of
+  the earlier ones, and items that are the same in all of them are left
+  in the order of the children. So clicking one column title and then
+  another sorts by the second and then the first.
+
+  \a flags is any of SORT_DESCENDING, SORT_NOCASE and SORT_NUMERIC.
+  The text compared is the part of each item's label between the tab
+  characters before and after the column, or what the sort_key()
+  callback returns.
+
+  The items are not moved. Instead the browser shows and counts them in
+  sorted order, so the indexes passed to and returned by the browser,
+  such as value() and child(), are positions in the sorted order. Use
+  sort_index() to find the child() of the Group shown at a position.
+
+  A large browser is sorted in the background by several threads, and
+  keeps showing the old order until they are done, see sorting().
+  Adding or removing items sorts them again. A negative \a column is
+  the same as unsort().
+*/
+void Browser::sort(int column, int flags) {
+  if (column < 0) {unsort(); return;}
+  BrowserSort* s = BrowserSort::get(this);
+  SortKey* keys = s->keys;
+  int i;
+  for (i = 0; i < s->nkeys && keys[i].column != column; i++);
+  if (i == s->nkeys) {
+    if (i < SORT_KEYS) s->nkeys++;
+    else i--;
+  }
+  memmove(keys+1, keys, i*sizeof(SortKey));
+  keys[0].column = column;
+  keys[0].flags = flags;
+  s->start();
+}
+
+/*! Show the items in the order of the children again, and forget the
+  columns sorted by. The filter_text() and filter_match() still hide
+  items. */
+void Browser::unsort() {
+  if (!sort_) return;
+  BrowserSort* s = sort_;
+  s->stop();
+  s->nkeys = 0;
+  if (list() == s) {
+    s->fit(s->list->children(this, 0, 0));
+    int* order = (int*)malloc(s->count*sizeof(int));
+    for (int i = 0; i < s->count; i++) order[i] = i;
+    s->install(order);
+    if (s->filtered()) return;
+    list(s->list);
+  }
+  sort_ = 0;
+  delete s;
+}
+
+/*! Returns true while a sort() is being done in the background */
+bool Browser::sorting() const {
+  return sort_ && sort_->sorter;
+}
+
+/*! Returns the column last passed to sort(), or NO_COLUMN_SELECTED */
+int Browser::sort_column() const {
+  return sort_ && sort_->nkeys ? sort_->keys[0].column : NO_COLUMN_SELECTED;
+}
+
+/*! Returns the flags last passed to sort() */
+int Browser::sort_flags() const {
+  return sort_ && sort_->nkeys ? sort_->keys[0].flags : 0;
+}
+
+/*! Returns the index of the child of the list() shown at \a position,
+  which is the same number unless the browser is sorted or filtered,
+  or -1 if nothing is shown there. */
+int Browser::sort_index(int position) const {
+  if (!sort_ || list() != sort_) return position;
+  if (position < 0 || position >= sort_->nrows) return -1;
+  return sort_->rows[position];
+}
+
+//
+// End of "$Id$".
+//
@@ -98,6 +98,8 @@ FileBrowser::FileBrowser(int X, int Y, int W, int H, const char *l) : Browser(X,
   icon_size_  = -1.0f;
   filetype_  = FILES;
   show_hidden_ = false;
+  ndirs_     = 0;
+  type_to_find(true);
 }
 
 /** Load a directory into the browser.
@@ -121,6 +123,7 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
   clear();
   yposition(0);
   directory_ = directory;
+  ndirs_ = 0;
 
   if (directory_[0] == '\0')
   {
@@ -252,6 +255,7 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
       fclose(mtab);
     }
 #endif // WIN32 || __EMX__
+    ndirs_ = children();
   }
   else
   {
@@ -296,8 +300,8 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
 	     fltk::filename_isdir(filename)) {
           num_dirs ++;
           this->insert(num_dirs-1, files[i]->d_name, icon);
-	} else if (filetype_ == FILES &&
-	           fltk::filename_match(files[i]->d_name, pattern_)) {
+	} else if (filetype_ == FILES) {
+          // files that do not match the pattern are hidden by filter():
           add(files[i]->d_name, icon);
 	}
       }
@@ -306,13 +310,17 @@ int FileBrowser::load(const char *directory, FileSortF *sort) {
     }
 
     free(files);
+    ndirs_ = num_dirs;
   }
 
+  filter(pattern_);
   return (num_files);
 }
 
 
-/** Set the filename filter.
+/** Set the filename filter. The files loaded that do not match are
+  hidden with Browser::filter_match(), without loading the directory
+  again. Directories are always shown.
   \param pattern Pattern to filter with. Eventually should deal with proper regex!
 */
 
@@ -320,6 +328,16 @@ void FileBrowser::filter(const char *pattern)	{
   // If pattern is NULL set the pattern to "*"...
   if (pattern) pattern_ = pattern;
   else pattern_ = "*";
+  if (!strcmp(pattern_, "*")) filter_match(0);
+  else filter_match(match_pattern, this);
+}
+
+/* Show the directories and the files matching the pattern */
+bool FileBrowser::match_pattern(Widget* item, int index, void* arg) {
+  FileBrowser* b = (FileBrowser*)arg;
+  if (index < b->ndirs_) return true;
+  const char* name = item->label();
+  return name && fltk::filename_match(name, b->pattern_);
 }
 
 ////////////////////////////////////////////////////////////////
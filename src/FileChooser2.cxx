@@ -1013,12 +1013,14 @@ void FileChooser::showChoiceCB() {
     if ((patend = strrchr(pattern_, ')')) != NULL) *patend = '\0';
   }
 
+  // this hides the files that do not match without reading the
+  // directory again:
   fileList->filter(pattern_);
 
   if (shown()) {
-    // Rescan the directory...
-    rescan();
     fileList->deselect();
+    activate_okButton_if_file();
+    update_preview();
   }
 }
 
@@ -65,6 +65,7 @@ and the items in them are widgets.
 #include <fltk/damage.h>
 #include <stdlib.h>
 #include <string.h>
+#include "GroupLabels.h"
 
 using namespace fltk;
 
@@ -89,8 +90,18 @@ Group::Group(int X,int Y,int W,int H,const char *l,bool begin)
   children_(0),
   focus_index_(-1),
   array_(0),
+  array_size_(0),
+  array_gap_(0),
+  index_bias_(0),
+  stale_from_(0),
+  stale_to_(0),
   resize_align_(ALIGN_TOPLEFT|ALIGN_BOTTOMRIGHT),
-  sizes_(0)
+  sizes_(0),
+  labels_(0),
+  changes_(0),
+  deferred_(0),
+  deferred_count_(0),
+  deferred_size_(0)
 {
   resizable_ = this;
   type(GROUP_TYPE);
@@ -105,6 +116,9 @@ Group::Group(int X,int Y,int W,int H,const char *l,bool begin)
   This calls the destructor on all the children!!! */
 void Group::clear() {
   init_sizes();
+  delete labels_;
+  labels_ = 0;
+  changes_++;
   if (children_) {
     Widget*const* a = array_;
     Widget*const* e = a+children_;
@@ -119,12 +133,15 @@ void Group::clear() {
       delete o;
     }
   }
-  delete[] const_cast<Widget**>( array_ );
+  delete[] (array_-array_gap_);
   array_ = 0;
+  array_size_ = array_gap_ = 0;
+  stale_from_ = stale_to_ = 0;
+  deferred_count_ = 0;
 }
 
 /*! Calls clear(), and thus <i>deletes all child widgets</i> */
-Group::~Group() {current_ = 0; clear();}
+Group::~Group() {current_ = 0; clear(); free(deferred_);}
 
 /*! \fn Widget * Group::child(int n) const
   Returns a child, n >= 0 && n < children(). <i>No range checking is done!</i>
@@ -145,21 +162,35 @@ void Group::insert(Widget &o, int index) {
     o.parent()->remove(n);
   }
   o.parent(this);
-  if (children_ == 0) {
-    // allocate for 1 child
-    if (!array_) array_ = new Widget*[1];
-    array_[0] = &o;
+  if (array_gap_ && (index < children_/2 || children_ >= array_size_)) {
+    // move the ones before it down into the space left by remove():
+    memmove(array_-1, array_, index*sizeof(Widget*));
+    array_--; array_gap_--; array_size_++;
   } else {
-    if (!(children_ & (children_-1))) {// double number of children
-      Widget** newarray = new Widget*[2*children_];
-      memcpy(newarray, array_, children_*sizeof(Widget*));
-      delete[] array_;
-      array_ = newarray;
-    }
-    for (int j = children_; j > index; --j) array_[j] = array_[j-1];
-    array_[index] = &o;
+    if (children_ >= array_size_) reserve(children_ ? 2*children_ : 1);
+    memmove(array_+index+1, array_+index, (children_-index)*sizeof(Widget*));
   }
+  array_[index] = &o;
   ++children_;
+  shifted(index, index+1);
+  o.index_ = index+index_bias_;
+  if (labels_) labels_->add(&o);
+  changes_++;
+  added(o);
+  sizes_changed();
+}
+
+/* Tell a new child about the state of this group, or remember to do
+   so later if defer_updates() is on. */
+void Group::added(Widget& o) {
+  if (deferred_) {
+    if (deferred_count_ >= deferred_size_) {
+      deferred_size_ *= 2;
+      deferred_ = (Widget**)realloc(deferred_, deferred_size_*sizeof(Widget*));
+    }
+    deferred_[deferred_count_++] = &o;
+    return;
+  }
   // fix the INACTIVE_R flag:
   if ( active_r() && o.active() ) {
     if ( o.flag(INACTIVE_R) ) {
@@ -174,9 +205,109 @@ void Group::insert(Widget &o, int index) {
   if ( o.visible_r() ) {
     o.handle( SHOW );
   }
+}
+
+/*! Make room for \a n children, so that adding up to that many does
+  not reallocate the array. This never makes the array smaller. */
+void Group::reserve(int n) {
+  if (n <= array_size_) return;
+  Widget** newarray = new Widget*[n];
+  if (children_) memcpy(newarray, array_, children_*sizeof(Widget*));
+  delete[] (array_-array_gap_);
+  array_ = newarray;
+  array_size_ = n;
+  array_gap_ = 0;
+}
+
+/* The children that were at oldindex and after it are now at newindex.
+   Either mark them as maybe having the wrong Widget::index_, or change
+   index_bias_ so they are right and mark the ones before them instead,
+   whichever is fewer. This way adding or removing at either end does
+   not make find() renumber anything. */
+void Group::shifted(int oldindex, int newindex) {
+  int delta = newindex-oldindex;
+  int same = delta > 0 ? oldindex : newindex; // children before this did not move
+  if (stale_from_ < stale_to_) {
+    if (stale_from_ < oldindex) {
+      if (stale_from_ > newindex) stale_from_ = newindex;
+    } else stale_from_ += delta;
+    if (stale_to_ <= oldindex) {
+      if (stale_to_ > newindex) stale_to_ = newindex;
+    } else stale_to_ += delta;
+  }
+  int from, to;
+  if (same < children_-newindex) {
+    index_bias_ -= delta;
+    from = 0; to = same;
+  } else {
+    from = newindex; to = children_;
+  }
+  if (from >= to) return;
+  if (stale_from_ >= stale_to_) {stale_from_ = from; stale_to_ = to; return;}
+  if (from < stale_from_) stale_from_ = from;
+  if (to > stale_to_) stale_to_ = to;
+}
+
+/*! Add \a n widgets to the end of the group, in order. This is the
+  same as calling add() on each of them, except the array is grown
+  only once and the layout of the group is reset only once. */
+void Group::add_many(Widget* const* widgets, int n) {
+  reserve(children_+n);
+  for (int i = 0; i < n; i++) {
+    Widget& o = *widgets[i];
+    if (o.parent()) o.parent()->remove(o);
+    o.parent(this);
+    o.index_ = children_+index_bias_;
+    array_[children_++] = &o;
+    if (labels_) labels_->add(&o);
+    added(o);
+  }
+  changes_++;
+  sizes_changed();
+}
+
+static int compare_widgets(const void* a, const void* b) {
+  Widget* x = *(Widget**)a;
+  Widget* y = *(Widget**)b;
+  return x < y ? -1 : x > y;
+}
+
+/*! When this is turned on, adding children does not send them SHOW,
+  ACTIVATE or DEACTIVATE, and adding or removing them does not reset
+  the layout or redraw the group. Turning it off again does all of
+  that once, for the children that were added in the meantime and are
+  still in the group. Use this around a large number of changes.
+
+  Menu::find() and find() continue to work while this is on.
+*/
+void Group::defer_updates(bool on) {
+  if (on) {
+    if (!deferred_) {
+      deferred_size_ = 16;
+      deferred_ = (Widget**)malloc(deferred_size_*sizeof(Widget*));
+      deferred_count_ = 0;
+    }
+    return;
+  }
+  if (!deferred_) return;
+  Widget** list = deferred_;
+  int n = deferred_count_;
+  deferred_ = 0;
+  // go through the children in order, not the order they were added,
+  // so a widget that was added more than once is only told once:
+  qsort(list, n, sizeof(Widget*), compare_widgets);
+  for (int i = 0; n && i < children_; i++) {
+    Widget* o = array_[i];
+    if (bsearch(&o, list, n, sizeof(Widget*), compare_widgets)) added(*o);
+  }
+  free(list);
   init_sizes();
+  redraw();
 }
 
+/*! \fn bool Group::defer_updates() const
+  Returns true if defer_updates(true) has been called. */
+
 /*! \fn Group * Group::current()
   Returns the group being currently built. The fltk::Widget
   constructor automatically does current()->add(widget) if this is not
@@ -204,19 +335,59 @@ void Group::add(Widget &o) {
   insert(o, children_);
 }
 
+// we must redraw the enclosing group that has an opaque box:
+static void redraw_behind(Widget* p) {
+  for (; p; p = p->parent())
+    if (p->box() != NO_BOX || !p->parent()) {p->redraw(); break;}
+}
+
 /*! Remove the indexed widget from the group. */
 void Group::remove(int index) {
   if (index >= children_) return;
   Widget* o = array_[index];
-  // we must redraw the enclosing group that has an opaque box:
-  if (o->visible_r())
-    for (Widget *p = this; p; p = p->parent())
-      if (p->box() != NO_BOX || !p->parent()) {p->redraw(); break;}
+  if (o->visible_r()) redraw_behind(this);
+  if (labels_) labels_->remove(o);
+  changes_++;
   o->parent(0);
   children_--;
-  for (int i=index; i < children_; ++i) array_[i] = array_[i+1];
-  init_sizes();
-  redraw();
+  if (index < children_/2) {
+    // leave the space at the start, insert() can use it
+    memmove(array_+1, array_, index*sizeof(Widget*));
+    array_++; array_gap_++; array_size_--;
+  } else {
+    memmove(array_+index, array_+index+1, (children_-index)*sizeof(Widget*));
+  }
+  shifted(index+1, index);
+  sizes_changed();
+  if (!deferred_) redraw();
+}
+
+/*! Remove \a n widgets starting at \a index. This does not call the
+  destructor on them. The range is clipped to the children that exist. */
+void Group::remove_range(int index, int n) {
+  if (index < 0) {n += index; index = 0;}
+  if (n > children_-index) n = children_-index;
+  if (n <= 0) return;
+  if (n == children_) {delete labels_; labels_ = 0;}
+  bool visible = false;
+  for (int i = index; i < index+n; i++) {
+    Widget* o = array_[i];
+    if (!visible && o->visible_r()) visible = true;
+    if (labels_) labels_->remove(o);
+    o->parent(0);
+  }
+  if (visible) redraw_behind(this);
+  changes_++;
+  children_ -= n;
+  if (index < children_/2) {
+    memmove(array_+n, array_, index*sizeof(Widget*));
+    array_ += n; array_gap_ += n; array_size_ -= n;
+  } else {
+    memmove(array_+index, array_+index+n, (children_-index)*sizeof(Widget*));
+  }
+  shifted(index+n, index);
+  sizes_changed();
+  if (!deferred_) redraw();
 }
 
 /*! \fn void Group::remove(Widget& widget)
@@ -228,18 +399,18 @@ void Group::remove(int index) {
   on the child widget (see clear()). */
 void Group::remove_all()
 {
-  int count = children();
-  while ( count-- ) {
-    remove( count );
-  }
+  remove_range(0, children());
 }
 
 /*! Remove the indexed widget and insert the passed widget in it's place. */
 void Group::replace(int index, Widget& o) {
   if (index >= children_) {add(o); return;}
+  if (labels_) {labels_->remove(array_[index]); labels_->add(&o);}
+  changes_++;
   o.parent(this);
   array_[index]->parent(0);
   array_[index] = &o;
+  o.index_ = index+index_bias_;
   init_sizes();
 }
 
@@ -253,22 +424,35 @@ void Group::swap(int indexA, int indexB) {
   Widget* o = array_[indexA];
   array_[indexA] = array_[indexB];
   array_[indexB] = o;
+  array_[indexA]->index_ = indexA+index_bias_;
+  o->index_ = indexB+index_bias_;
+  changes_++;
   init_sizes();
 }
 
 /*! Searches the children for \a widget, returns the index of \a
   widget or of a parent of \a widget that is a child() of
-  this. Returns children() if the widget is NULL or not found. */
+  this. Returns children() if the widget is NULL or not found.
+
+  Each child remembers its index, so this does not search the children
+  unless some of them have moved since it was last called. */
 int Group::find(const Widget* widget) const {
   for (;;) {
     if (!widget) return children_;
     if (widget->parent() == this) break;
     widget = widget->parent();
   }
-  // Search backwards so if children are deleted in backwards order
-  // they are found quickly:
-  for (int index = children_; index--;)
-    if (array_[index] == widget) return index;
+  int index = widget->index_-index_bias_;
+  if (index >= 0 && index < children_ && array_[index] == widget)
+    return index;
+  // Some children have moved since their index was stored. Renumber
+  // them until the widget is found:
+  Group* g = const_cast<Group*>(this);
+  for (index = stale_from_; index < stale_to_ && index < children_; index++) {
+    array_[index]->index_ = index+index_bias_;
+    if (array_[index] == widget) {g->stale_from_ = index+1; return index;}
+  }
+  g->stale_from_ = g->stale_to_ = 0;
   return children_;
 }
 
@@ -473,6 +657,16 @@ void Group::init_sizes() {
   relayout();
 }
 
+/* Called when children are added or removed. The sizes() array no
+   longer matches them, so it is always thrown away, but the relayout()
+   is left to defer_updates(false) while updates are deferred. */
+void Group::sizes_changed() {
+  if (!deferred_) {init_sizes(); return;}
+  initial_w = w();
+  initial_h = h();
+  delete[] sizes_; sizes_ = 0;
+}
+
 /** Returns array of initial sizes of the widget and it's children.
 
     The sizes() array stores the initial positions of widgets as
@@ -0,0 +1,70 @@
+/* Hash table of the labels of the children of a Group, so that
+   Menu::add(), replace() and find() do not have to compare a name with
+   every child. Labels are hashed the way Menu compares them, ignoring
+   @-commands and '&' characters. Group keeps it up to date as children
+   are added, removed or relabelled. This is not a public header. */
+
+#ifndef fltk_GroupLabels_h
+#define fltk_GroupLabels_h
+
+#include <fltk/Group.h>
+#include <ctype.h>
+
+namespace fltk {
+
+class GroupLabels {
+public:
+  struct Entry {
+    Widget* widget;	/* null if the entry is free */
+    unsigned hash;
+    int next;		/* next entry in the bucket, or next free one */
+  };
+  Entry* entries;
+
+  GroupLabels(const Group*);
+  ~GroupLabels();
+  /* first entry that may have this hash, follow next to get the rest */
+  int first(unsigned hash) const { return buckets_[hash&(nbuckets_-1)]; }
+  void add(Widget*);
+  void remove(Widget*);
+  void change(Widget*, const char* newlabel);
+
+  static unsigned hash(const char* label);
+  static GroupLabels* get(Group*);
+  /* call before the label of a widget is changed */
+  static void relabel(Widget* w, const char* newlabel) {
+    Group* g = w->parent();
+    if (!g) return;
+    g->changes_++;
+    if (g->labels_) g->labels_->change(w, newlabel);
+  }
+
+  /* Skip @ commands, return pointer to null or first actual letter:
+     Except we don't skip a trailing command with no semicolon. */
+  static void skip_embedded(const char*& aa) {
+    const char* a = aa;
+    while (*a == '@') {
+      if (*++a == '@') {aa = a; return;} // return pointer to second @ of @@
+      for (;; a++) {
+	if (!*a) return; // leave pointer unchanged for trailing command
+	if (isspace((unsigned char)*a) || *a==';') {aa = ++a; break;}
+	if (*a == '@') {aa = a; break;}
+      }
+    }
+  }
+
+private:
+  int* buckets_;
+  int nbuckets_;	/* power of 2 */
+  int count_;		/* entries in use */
+  int size_;		/* allocated entries */
+  int free_;		/* first free entry */
+  int alloc();
+  void link(int e, unsigned hash);
+  int unlink(Widget*);
+  void rehash(int nbuckets);
+};
+
+} /* namespace fltk */
+
+#endif
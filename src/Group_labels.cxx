@@ -0,0 +1,162 @@
+//
+// "$Id$"
+//
+// Hash table of the labels of the children of a Group.
+//
+// Copyright 1998-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//    http://www.fltk.org/str.php
+//
+
+// Menu::add() and friends used to compare the name with every child
+// of each submenu, which made building a large tree quadratic. Groups
+// with enough children get one of these to find the candidates.
+
+#include "GroupLabels.h"
+#include <stdlib.h>
+
+using namespace fltk;
+
+// Groups with fewer children than this are searched directly:
+#define MIN_CHILDREN 16
+
+/* Hash of the letters Menu compares, the same loop as the one in
+   match_and_replace() in Menu_add.cxx */
+unsigned GroupLabels::hash(const char* a) {
+  unsigned h = 2166136261u;
+  for (;;) {
+    if (*a == '@') skip_embedded(a);
+    if (*a == '&') a++;
+    if (!*a) return h;
+    h = (h ^ (unsigned char)*a) * 16777619u;
+    ++a;
+  }
+}
+
+/* Return the table for the group, making it if the group is big
+   enough to need one, or return null. */
+GroupLabels* GroupLabels::get(Group* g) {
+  if (!g->labels_ && g->children() >= MIN_CHILDREN)
+    g->labels_ = new GroupLabels(g);
+  return g->labels_;
+}
+
+GroupLabels::GroupLabels(const Group* g) {
+  entries = 0;
+  buckets_ = 0;
+  nbuckets_ = count_ = size_ = 0;
+  free_ = -1;
+  int n = 64;
+  while (n < g->children()) n *= 2;
+  rehash(n);
+  for (int i = 0; i < g->children(); i++) add(g->child(i));
+}
+
+GroupLabels::~GroupLabels() {
+  free(entries);
+  delete[] buckets_;
+}
+
+int GroupLabels::alloc() {
+  if (free_ < 0) {
+    int n = size_ ? 2*size_ : 64;
+    entries = (Entry*)realloc(entries, n*sizeof(Entry));
+    for (int i = n; i-- > size_;) {
+      entries[i].widget = 0;
+      entries[i].next = free_;
+      free_ = i;
+    }
+    size_ = n;
+  }
+  int e = free_;
+  free_ = entries[e].next;
+  count_++;
+  return e;
+}
+
+void GroupLabels::link(int e, unsigned h) {
+  entries[e].hash = h;
+  int* b = buckets_+(h&(nbuckets_-1));
+  entries[e].next = *b;
+  *b = e;
+}
+
+/* Take the widget out of its bucket and return its entry, or -1 */
+int GroupLabels::unlink(Widget* w) {
+  const char* label = w->label();
+  if (!label) return -1;
+  int* p = buckets_+(hash(label)&(nbuckets_-1));
+  for (; *p >= 0; p = &entries[*p].next)
+    if (entries[*p].widget == w) {
+      int e = *p;
+      *p = entries[e].next;
+      return e;
+    }
+  // the label was changed without telling us, look everywhere:
+  for (int b = 0; b < nbuckets_; b++)
+    for (p = buckets_+b; *p >= 0; p = &entries[*p].next)
+      if (entries[*p].widget == w) {
+	int e = *p;
+	*p = entries[e].next;
+	return e;
+      }
+  return -1;
+}
+
+void GroupLabels::rehash(int n) {
+  delete[] buckets_;
+  buckets_ = new int[n];
+  nbuckets_ = n;
+  for (int b = 0; b < n; b++) buckets_[b] = -1;
+  for (int e = 0; e < size_; e++)
+    if (entries[e].widget) link(e, entries[e].hash);
+}
+
+/* Add a new child of the group */
+void GroupLabels::add(Widget* w) {
+  if (!w->label()) return;
+  int e = alloc();
+  entries[e].widget = w;
+  link(e, hash(w->label()));
+  if (count_ > nbuckets_) rehash(2*nbuckets_);
+}
+
+/* Forget a child that is being removed from the group */
+void GroupLabels::remove(Widget* w) {
+  int e = unlink(w);
+  if (e < 0) return;
+  entries[e].widget = 0;
+  entries[e].next = free_;
+  free_ = e;
+  count_--;
+}
+
+/* Move a child to the bucket for the label it is about to get */
+void GroupLabels::change(Widget* w, const char* newlabel) {
+  if (!newlabel) {remove(w); return;}
+  int e = unlink(w);
+  if (e < 0) {e = alloc(); entries[e].widget = w;}
+  link(e, hash(newlabel));
+  if (count_ > nbuckets_) rehash(2*nbuckets_);
+}
+
+//
+// End of "$Id$".
+//
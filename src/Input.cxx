@@ -111,7 +111,7 @@ const char* Input::expand(const char* p, char* buf,int wordwrap) const {
   if (type() == SECRET) {
     while (o<e && p < text_+size_) {*o++ = '*'; p++;}
   } else while (o<e) {
-    if (wordwrap && (p >= text_+size_ || isspace(*p))) {
+    if (wordwrap && (p >= text_+size_ || isspace((unsigned char)*p))) {
       width_to_lastspace += (int)getwidth(lastspace_out, o-lastspace_out);
       if (p > lastspace+1) {
 	if (word_count && width_to_lastspace > wordwrap) {
@@ -162,6 +162,173 @@ float Input::expandpos(
   return getwidth(buf, n);
 }
 
+////////////////////////////////////////////////////////////////
+// Lines:
+
+/* Where each line drawn by draw() starts and ends. A line ends at a
+   newline, at the space where word wrap broke it, or where expand()
+   ran out of room. These are kept as the text is edited, so drawing
+   only looks at the visible lines, and only the lines near an edit
+   are measured again. */
+class fltk::InputLines {
+public:
+  int* start;
+  int* end;
+  float* width;		// width of each line, or -1 if not measured
+  int count, size;
+  int dirty;		// first line that must be measured, or -1
+  int dirtyend;		// and measuring continues until past here
+  bool valid;
+  // what the lines were measured for:
+  int wordwrap;
+  uchar type;
+  Font* font;
+  float fontsize;
+
+  InputLines() : start(0), end(0), width(0), count(0), size(0),
+    dirty(-1), dirtyend(0), valid(false) {}
+  ~InputLines() {free(start); free(end); free(width);}
+  void reserve(int n);
+  int find(int pos) const;
+  int line_at(int pos) const;
+  void modified(int b, int e, int ilen, bool wrap);
+};
+
+void InputLines::reserve(int n) {
+  if (n <= size) return;
+  size = n > 2*size ? n : 2*size;
+  start = (int*)realloc(start, size*sizeof(int));
+  end = (int*)realloc(end, size*sizeof(int));
+  width = (float*)realloc(width, size*sizeof(float));
+}
+
+/* Return the first line that ends at or after pos */
+int InputLines::find(int pos) const {
+  int a = 0, b = count-1;
+  while (a < b) {
+    int i = (a+b)/2;
+    if (end[i] < pos) a = i+1; else b = i;
+  }
+  return a;
+}
+
+/* Return the last line that starts at or before pos */
+int InputLines::line_at(int pos) const {
+  int a = 0, b = count-1;
+  while (a < b) {
+    int i = (a+b+1)/2;
+    if (start[i] > pos) b = i-1; else a = i;
+  }
+  return a;
+}
+
+static inline int moved(int x, int b, int e, int ilen) {
+  if (x < b) return x;
+  if (x >= e) return x+ilen-(e-b);
+  return b;
+}
+
+/* The text between b and e was replaced by ilen bytes. The lines after
+   it are moved, and the line it is in is marked as needing to be
+   measured again, along with the one before it if word wrapping, as
+   a word may now fit on that one. */
+void InputLines::modified(int b, int e, int ilen, bool wrap) {
+  if (!valid) return;
+  if (!count) {valid = false; return;}
+  // the ends of dirty lines may be out of date, but the starts are not:
+  int k = line_at(b);
+  if (k > 0 && (wrap || start[k] == b)) k--;
+  end[k] = moved(end[k], b, e, ilen);
+  // drop the lines that started inside the deleted text:
+  int j = k+1;
+  while (j < count && start[j] < e) j++;
+  if (j > k+1) {
+    memmove(start+k+1, start+j, (count-j)*sizeof(int));
+    memmove(end+k+1, end+j, (count-j)*sizeof(int));
+    memmove(width+k+1, width+j, (count-j)*sizeof(float));
+    count -= j-(k+1);
+  }
+  int delta = ilen-(e-b);
+  for (int i = k+1; i < count; i++) {start[i] += delta; end[i] += delta;}
+  if (dirty < 0) {
+    dirty = k;
+    dirtyend = b+ilen;
+  } else {
+    if (k < dirty) dirty = k;
+    dirtyend = moved(dirtyend, b, e, ilen);
+    if (dirtyend < b+ilen) dirtyend = b+ilen;
+  }
+}
+
+/*! Make the lines match the text, split by expand() with this \a wordwrap.
+  Only the lines marked by InputLines::modified() are measured, unless
+  the font, type() or \a wordwrap changed. */
+void Input::layout_lines(int wordwrap) const {
+  InputLines* l = lines_;
+  if (!l) l = const_cast<Input*>(this)->lines_ = new InputLines;
+  if (!l->valid || l->wordwrap != wordwrap || l->type != type() ||
+      l->font != textfont() || l->fontsize != textsize()) {
+    l->valid = true;
+    l->wordwrap = wordwrap;
+    l->type = type();
+    l->font = textfont();
+    l->fontsize = textsize();
+    l->count = 0;
+    l->dirty = 0;
+    l->dirtyend = 0;
+  }
+  if (l->dirty < 0) return;
+  setfont();
+
+  // measure lines starting at the dirty one, until one starts where
+  // a line already started after all the edits:
+  int i = l->dirty;
+  int j = i+1 < l->count ? i+1 : l->count;
+  int p = i < l->count ? l->start[i] : 0;
+  int n = 0, nsize = 0;
+  int* ns = 0;
+  for (;;) {
+    char buf[MAXBUF];
+    const char* e = expand(text_+p, buf, wordwrap);
+    if (n+2 > nsize) {
+      nsize = nsize ? 2*nsize : 16;
+      ns = (int*)realloc(ns, nsize*sizeof(int));
+    }
+    ns[n++] = p;
+    ns[n++] = e-text_;
+    if (e >= text_+size_) {j = l->count; break;}
+    if (*e == '\n' || *e == ' ') e++;
+    p = e-text_;
+    while (j < l->count && l->start[j] < p) j++;
+    if (p > l->dirtyend && j < l->count && l->start[j] == p) break;
+  }
+  n /= 2;
+
+  // replace lines i through j-1 with the new ones:
+  int count = l->count-(j-i)+n;
+  l->reserve(count);
+  memmove(l->start+i+n, l->start+j, (l->count-j)*sizeof(int));
+  memmove(l->end+i+n, l->end+j, (l->count-j)*sizeof(int));
+  memmove(l->width+i+n, l->width+j, (l->count-j)*sizeof(float));
+  for (int k = 0; k < n; k++) {
+    l->start[i+k] = ns[2*k];
+    l->end[i+k] = ns[2*k+1];
+    l->width[i+k] = -1;
+  }
+  l->count = count;
+  l->dirty = -1;
+  free(ns);
+}
+
+/*! The wordwrap width draw() last used, for the functions that are not
+  given the rectangle. */
+int Input::wrap_width() const {
+  if (type() <= MULTILINE) return 0;
+  if (lines_ && lines_->valid && lines_->wordwrap) return lines_->wordwrap;
+  Rectangle r(w(),h()); box()->inset(r);
+  return r.w()-label_width-8;
+}
+
 ////////////////////////////////////////////////////////////////
 // minimal update:
 
@@ -301,43 +468,38 @@ void Input::draw(const Rectangle& r)
   }
 
   int wordwrap = (type() > MULTILINE) ? r.w()-8 : 0;
+  layout_lines(wordwrap);
+  InputLines* l = lines_;
 
   const char *p, *e;
   char buf[MAXBUF];
 
-  // count how many lines and put the last one into the buffer:
-  // And figure out where the cursor is:
-  int lines;
-  int curx, cury;
+  // figure out where the cursor is:
   int cursor_position = (this==dnd_target) ? dnd_target_position : position();
-  for (p=text_, curx=cury=lines=0; ;) {
-    e = expand(p, buf, wordwrap);
-    if (cursor_position >= p-text_ && cursor_position <= e-text_) {
-      curx = int(expandpos(p, text_+cursor_position, buf, 0)+.5);
-      if (focused() && !was_up_down) up_down_pos = float(curx);
-      cury = lines*height;
-      int newscroll = xscroll_;
-      if (curx > newscroll+r.w()-20) {
-	// figure out scrolling so there is space after the cursor:
-	newscroll = curx+20-r.w();
-	// figure out the furthest left we ever want to scroll:
-	int ex = int(expandpos(p, e, buf, 0))-r.w()+8;
-	// use minimum of both amounts:
-	if (ex < newscroll) newscroll = ex;
-      } else if (curx < newscroll+20) {
-	newscroll = curx-20;
-      }
-      if (newscroll < 0) newscroll = 0;
-      if (newscroll != xscroll_) {
-	xscroll_ = newscroll;
-	mu_p = 0;
-	erase_cursor_only = false;
-      }
-    }
-    lines++;
-    if (e >= text_+size_) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
+  int cursor_line = l->line_at(cursor_position);
+  p = text_+l->start[cursor_line];
+  e = expand(p, buf, wordwrap);
+  int curx = int(expandpos(p, text_+cursor_position, buf, 0)+.5);
+  if (focused() && !was_up_down) up_down_pos = float(curx);
+  int cury = cursor_line*height;
+  int newscroll = xscroll_;
+  if (curx > newscroll+r.w()-20) {
+    // figure out scrolling so there is space after the cursor:
+    newscroll = curx+20-r.w();
+    // figure out the furthest left we ever want to scroll:
+    if (l->width[cursor_line] < 0)
+      l->width[cursor_line] = expandpos(p, e, buf, 0);
+    int ex = int(l->width[cursor_line])-r.w()+8;
+    // use minimum of both amounts:
+    if (ex < newscroll) newscroll = ex;
+  } else if (curx < newscroll+20) {
+    newscroll = curx-20;
+  }
+  if (newscroll < 0) newscroll = 0;
+  if (newscroll != xscroll_) {
+    xscroll_ = newscroll;
+    mu_p = 0;
+    erase_cursor_only = false;
   }
 
   // adjust the scrolling:
@@ -371,16 +533,21 @@ void Input::draw(const Rectangle& r)
 
   int ypos = -yscroll_;
 
-  // visit each line and draw it:
-  p = text_;
+  // skip the lines clipped off the top:
+  int line = 0;
+  if (ypos <= -height) {
+    line = -ypos/height;
+    if (line > l->count) line = l->count;
+    ypos += line*height;
+  }
+
+  // visit each visible line and draw it:
   int spot_x = r.x();
   int spot_y = r.y();
-  for (; ypos < r.h();) {
-
-    // re-expand line unless it is the last one calculated above:
-    if (lines>1) e = expand(p, buf, wordwrap);
+  for (; line < l->count && ypos < r.h(); line++, ypos += height) {
 
-    if (ypos <= -height) goto CONTINUE; // clipped off top
+    p = text_+l->start[line];
+    e = expand(p, buf, wordwrap);
 
     if (!(damage()&DAMAGE_ALL)) {	// for minimal update:
       const char* pp = text_+mu_p; // pointer to where minimal update starts
@@ -444,18 +611,12 @@ void Input::draw(const Rectangle& r)
   CONTINUE2:
     // draw the cursor:
     if ((this==dnd_target || (focused() && selstart == selend)) &&
-	cursor_position >= p-text_ && cursor_position <= e-text_) {
+	line == cursor_line) {
       setcolor(textcolor);
       fillrect(xpos+curx-1, r.y()+ypos, 2, height);
       spot_x = xpos+curx;
       spot_y = r.y()+ypos;
     }
-
-  CONTINUE:
-    ypos += height;
-    if (e >= text_+size_) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
   }
 
   // for minimal update, erase all lines below last one if necessary:
@@ -498,18 +659,9 @@ int Input::word_start(int i) const {
   after position. */
 int Input::line_end(int i) const {
   if (type() >= WORDWRAP) {
-    // go to the start of the paragraph:
-    int j = i;
-    while (j > 0 && at(j-1) != '\n') j--;
-    // now measure lines until we get past i, end of that line is real eol:
-    Rectangle r(w(),h()); box()->inset(r); int wordwrap = r.w()-6;
-    setfont();
-    for (const char* p=text_+j; ;) {
-      char buf[MAXBUF];
-      p = expand(p, buf, wordwrap);
-      if (p-text_ >= i) return p-text_;
-      p++;
-    }
+    // the end of the first line that ends after i:
+    layout_lines(wrap_width());
+    return lines_->end[lines_->find(i)];
   } else if (type() >= MULTILINE) {
     while (i < size() && at(i) != '\n') i++;
     return i;
@@ -521,19 +673,12 @@ int Input::line_end(int i) const {
 /*! Returns the location of the start of the line containing the position. */
 int Input::line_start(int i) const {
   if (type() < MULTILINE) return 0;
-  int j = i;
-  while (j > 0 && at(j-1) != '\n') j--;
   if (type() >= WORDWRAP) {
-    // now measure lines until we get past i, start of that line is real eol:
-    Rectangle r(w(),h()); box()->inset(r); int wordwrap = r.w()-6;
-    setfont();
-    for (const char* p=text_+j; ;) {
-      char buf[MAXBUF];
-      const char* e = expand(p, buf, wordwrap);
-      if (e-text_ >= i) return p-text_;
-      p = e+1;
-    }
+    layout_lines(wrap_width());
+    return lines_->start[lines_->find(i)];
   }
+  int j = i;
+  while (j > 0 && at(j-1) != '\n') j--;
   return j;
 }
 
@@ -563,18 +708,14 @@ int Input::mouse_position(const Rectangle& r) const
   }
 
   int wordwrap = (type() > MULTILINE) ? r.w()-8 : 0;
+  layout_lines(wordwrap);
+  if (theline >= lines_->count) theline = lines_->count-1;
 
-  // Step through all the lines until we reach the pointed-to line.
-  // Expand the lines to printed representation into the buffer:
+  // Expand the pointed-to line to printed representation into the buffer:
   const char *p, *e;
   char buf[MAXBUF];
-  for (p=text_;; ) {
-    e = expand(p, buf, wordwrap);
-    theline--; if (theline < 0) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
-    if (e >= text_+size_) break;
-  }
+  p = text_+lines_->start[theline];
+  e = expand(p, buf, wordwrap);
 
   // Do a binary search for the character that starts before this position:
   int xpos = r.x()-xscroll_; if (r.w() > 12) xpos += 3;
@@ -643,13 +784,8 @@ void Input::position(int new_position, int new_mark) {
   cause the point to move up and down. */
 void Input::up_down_position(int i, bool keepmark) {
   // cursor must already be at start of line!
+  int wordwrap = wrap_width();
   setfont();
-  int wordwrap;
-  if (type() > MULTILINE) {
-    Rectangle r(w(),h()); box()->inset(r); wordwrap = r.w()-6;
-  } else {
-    wordwrap = 0;
-  }
   char buf[MAXBUF];
   const char* p = text_+i;
   const char* e = expand(p, buf, wordwrap);
@@ -694,30 +830,131 @@ bool Input::copy(bool clipboard) {
 
 #define MAXFLOATSIZE 40
 
-static char* undobuffer;
-static int undobufferlength;
-static Input* undowidget;
-static bool undo_is_redo;
-static int undoat;	// points after insertion
-static int undocut;	// number of characters deleted there
-static int undoinsert;	// number of characters inserted
-static int yankcut;	// length of valid contents of buffer, even if undocut=0
-
-static void undobuffersize(int n) {
-  if (n > undobufferlength) {
-    if (undobuffer) {
-      int m = 2*undobufferlength;
-      while (m < n) m *= 2;
-      char* newbuffer = new char[m];
-      memcpy(newbuffer, undobuffer, undobufferlength);
-      delete[] undobuffer;
-      undobuffer = newbuffer;
-      undobufferlength = m;
+// Undo:
+
+/* Most steps and bytes of text kept for undo by each widget. When there
+   are more the oldest steps are thrown away. */
+#define UNDO_STEPS 100
+#define UNDO_BYTES (64*1024)
+
+/* Each step replaced the \a cut bytes at \a at with \a ins bytes. Both
+   strings are kept, one after the other, starting at \a text in the
+   arena. The steps are in the order they were done and so is the text
+   in the arena, so the last step can grow at the end of it as the user
+   types. */
+class fltk::InputUndo {
+public:
+  struct Step {int at, cut, ins, text;};
+  Step* steps;
+  int count, size;
+  int current;		// steps before this one are done, the rest undone
+  char* arena;
+  int used, arenasize;
+  bool open;		// the last step can be added to
+
+  InputUndo() : steps(0), count(0), size(0), current(0),
+    arena(0), used(0), arenasize(0), open(false) {}
+  ~InputUndo() {free(steps); free(arena);}
+  void arena_reserve(int n);
+  void trim();
+  void record(const char* text, int b, int e, const char* itext, int ilen);
+};
+
+void InputUndo::arena_reserve(int n) {
+  if (n <= arenasize) return;
+  arenasize = n > 2*arenasize ? n : 2*arenasize;
+  if (arenasize < 64) arenasize = 64;
+  arena = (char*)realloc(arena, arenasize);
+}
+
+/* Throw away the oldest steps if there are too many, a quarter at a
+   time so the arena is not moved for every new step. The newest step is
+   always kept, no matter how big it is. */
+void InputUndo::trim() {
+  if (count <= UNDO_STEPS && used <= UNDO_BYTES) return;
+  int n = 0;
+  while (n < count-1 &&
+	 (count-n > UNDO_STEPS*3/4 || used-steps[n].text > UNDO_BYTES*3/4))
+    n++;
+  int drop = steps[n].text;
+  memmove(arena, arena+drop, used-drop);
+  used -= drop;
+  count -= n;
+  memmove(steps, steps+n, count*sizeof(Step));
+  for (int i = 0; i < count; i++) steps[i].text -= drop;
+  current = count;
+}
+
+/* Record that the text between \a b and \a e of \a text is about to be
+   replaced with \a ilen bytes of \a itext. Typing, and deleting with
+   backspace or delete, are added to the last step, so they are undone
+   all at once, but a new step is started at the start of each word. */
+void InputUndo::record(const char* text, int b, int e,
+		       const char* itext, int ilen) {
+  if (current < count) {	// forget what was undone
+    count = current;
+    used = count ? steps[count-1].text+steps[count-1].cut+steps[count-1].ins : 0;
+    open = false;
+  }
+  Step* s = open ? &steps[count-1] : 0;
+  int n = e-b;
+  if (n) {
+    if (s && b == s->at+s->ins) {
+      // delete key, add to the end of the cut text:
+      arena_reserve(used+n);
+      char* p = arena+s->text+s->cut;
+      memmove(p+n, p, s->ins);
+      memcpy(p, text+b, n);
+      s->cut += n;
+      used += n;
+    } else if (s && e == s->at && !s->ins) {
+      // backspace, add to the start of the cut text:
+      arena_reserve(used+n);
+      char* p = arena+s->text;
+      memmove(p+n, p, s->cut);
+      memcpy(p, text+b, n);
+      s->cut += n;
+      s->at = b;
+      used += n;
+    } else if (s && e == s->at+s->ins && n <= s->ins) {
+      // backspace over what was typed:
+      s->ins -= n;
+      used -= n;
     } else {
-      undobufferlength = n+9;
-      undobuffer = new char[undobufferlength];
+      s = 0;
     }
   }
+  if (ilen && s && (b != s->at+s->ins || (!n && s->ins &&
+		     isspace((unsigned char)arena[used-1]) &&
+		     !isspace((unsigned char)itext[0]))))
+    s = 0;
+  if (!s) {
+    if (count >= size) {
+      size = size ? 2*size : 8;
+      steps = (Step*)realloc(steps, size*sizeof(Step));
+    }
+    s = &steps[count++];
+    s->at = b;
+    s->cut = n;
+    s->ins = 0;
+    s->text = used;
+    arena_reserve(used+n);
+    memcpy(arena+used, text+b, n);
+    used += n;
+  }
+  if (ilen) {
+    arena_reserve(used+ilen);
+    memcpy(arena+used, itext, ilen);
+    s->ins += ilen;
+    used += ilen;
+  }
+  current = count;
+  open = true;
+  if (!s->cut && !s->ins) {	// everything typed was deleted
+    current = --count;
+    open = false;
+  }
+  trim();
 }
 
 /*!
@@ -744,8 +981,6 @@ static void undobuffersize(int n) {
 */
 bool Input::replace(int b, int e, const char* text, int ilen) {
 
-  was_up_down = false;
-
   if (b<0) b = 0;
   if (e<0) e = 0;
   if (b>size_) b = size_;
@@ -764,48 +999,32 @@ bool Input::replace(int b, int e, const char* text, int ilen) {
   }
 #endif
 
-  reserve(size_+ilen);
+  if (e > b || ilen) {
+    if (!undo_) undo_ = new InputUndo;
+    undo_->record(text_, b, e, text, ilen);
+  }
+  change_text(b, e, text, ilen);
+  return true;
+}
 
-  if (undo_is_redo) {undowidget = 0; undo_is_redo = false;}
+/* Replace the text between b and e with ilen bytes of text, without
+   recording it for undo */
+void Input::change_text(int b, int e, const char* text, int ilen) {
+  was_up_down = false;
+  int p = b+ilen;
+  reserve(size_+ilen);
 
   if (e>b) {
-    if (undowidget == this && b == undoat) {
-      undobuffersize(undocut+(e-b));
-      memcpy(undobuffer+undocut, text_+b, e-b);
-      undocut += e-b;
-    } else if (undowidget == this && e == undoat && !undoinsert) {
-      undobuffersize(undocut+(e-b));
-      memmove(undobuffer+(e-b), undobuffer, undocut);
-      memcpy(undobuffer, text_+b, e-b);
-      undocut += e-b;
-    } else if (undowidget == this && e == undoat && (e-b)<undoinsert) {
-      undoinsert -= e-b;
-    } else {
-      undobuffersize(e-b);
-      memcpy(undobuffer, text_+b, e-b);
-      undocut = e-b;
-      undoinsert = 0;
-    }
     memmove(buffer+b, buffer+e, size_-e+1);
     size_ -= e-b;
-    undowidget = this;
-    undoat = b;
-    if (type() == SECRET) yankcut = 0; else yankcut = undocut;
   }
 
   if (ilen) {
-    if (undowidget == this && b == undoat)
-      undoinsert += ilen;
-    else {
-      undocut = 0;
-      undoinsert = ilen;
-    }
     memmove(buffer+b+ilen, buffer+b, size_-b+1);
     memcpy(buffer+b, text, ilen);
     size_ += ilen;
   }
-  undowidget = this;
-  undoat = b+ilen;
+  if (lines_) lines_->modified(b, e, ilen, type() > MULTILINE);
 
   // When editing with word wrap, it is possible to effectively turn
   // the space before the current word into a newline or back, so the
@@ -814,7 +1033,7 @@ bool Input::replace(int b, int e, const char* text, int ilen) {
   // but it is too hard to figure out for now...
   if (type() > MULTILINE) {
     int c = b - 1;
-    while (c > 0 && !isspace(at(c))) c--;
+    while (c > 0 && !isspace((unsigned char)at(c))) c--;
     if (c > 0) b = c;
   }
 
@@ -824,10 +1043,9 @@ bool Input::replace(int b, int e, const char* text, int ilen) {
 
   minimal_update(b);
 
-  mark_ = position_ = undoat;
+  mark_ = position_ = p;
 
   changed_stuff(this);
-  return true;
 }
 
 /*! \fn bool Input::cut()
@@ -865,56 +1083,27 @@ bool Input::insert(const char* text) {
   Wrapper around replace(). Deletes the characters between \a a and \a b
   and then inserts the single byte \a c. */
 
-/*! If this is the most recent widget on which replace() was done on,
-  this will undo that replace() and probably several others (ie if the
-  user has typed a lot of text it will undo all of it even though that
-  was probably many calls to replace()). Returns true if any change
-  was made. */
+/*! Undo the last replace(), and probably several others before it (if
+  the user typed a word it was probably many calls to replace()). Each
+  widget remembers its own edits, and calling this again undoes the ones
+  before that, up to the last 100 or so. Returns true if any change was
+  made. */
 bool Input::undo() {
-  if (undowidget != this || !(undocut || undoinsert)) return false;
-  was_up_down = false;
-
-  int ilen = undocut;
-  int xlen = undoinsert;
-  int b = undoat-xlen;
-  int b1 = b;
-
-  reserve(size_+ilen);
-
-  if (ilen) {
-    memmove(buffer+b+ilen, buffer+b, size_-b+1);
-    memcpy(buffer+b, undobuffer, ilen);
-    size_ += ilen;
-    b += ilen;
-  }
-
-  if (xlen) {
-    undobuffersize(xlen);
-    memcpy(undobuffer, buffer+b, xlen);
-    memmove(buffer+b, buffer+b+xlen, size_-xlen-b+1);
-    size_ -= xlen;
-  }
-
-  undocut = xlen;
-  if (xlen) yankcut = xlen;
-  undoinsert = ilen;
-  undoat = b;
-  mark_ = b /* -ilen */;
-  position_ = b;
-  undo_is_redo = !undo_is_redo;
-
-  minimal_update(b1);
-  changed_stuff(this);
+  if (!undo_ || !undo_->current) return false;
+  InputUndo::Step& s = undo_->steps[--undo_->current];
+  undo_->open = false;
+  change_text(s.at, s.at+s.ins, undo_->arena+s.text, s.cut);
   return true;
 }
 
-#if 0
-/*! Does Emacs-style yank of appended cuts by retrieving them from
-  the saved undo() information. */
-bool Input::yank() {
-  return yankcut && change(position(), position(), undobuffer, yankcut);
+/*! Do again what the last undo() undid. Returns false if undo() was
+  not called, or the text was edited since. */
+bool Input::redo() {
+  if (!undo_ || undo_->current >= undo_->count) return false;
+  InputUndo::Step& s = undo_->steps[undo_->current++];
+  change_text(s.at, s.at+s.cut, undo_->arena+s.text+s.cut, s.ins);
+  return true;
 }
-#endif
 
 ////////////////////////////////////////////////////////////////
 
@@ -941,6 +1130,8 @@ Input::Input(int x, int y, int w, int h, const char* l)
   xscroll_ = yscroll_ = 0;
   style(default_style);
   label_width = 0;
+  lines_ = 0;
+  undo_ = 0;
 }
 
 /*! \fn const char* Input::text() const
@@ -1009,7 +1200,8 @@ void Input::reserve(int len) {
 bool Input::static_text(const char* str, int len) {
   if (fl_pending_callback == this) fl_pending_callback = 0;
   clear_changed();
-  if (undowidget == this) undowidget = 0;
+  delete undo_; undo_ = 0;
+  if (lines_) lines_->valid = false;
   bool ret = true;
   if (str == text_ && len == size_) {
     ret = false;
@@ -1071,8 +1263,9 @@ bool Input::text(const char* str) {
 /*! The destructor destroys the memory used by text() */
 Input::~Input() {
   if (fl_pending_callback == this) fl_pending_callback = 0;
-  if (undowidget == this) undowidget = 0;
   delete[] buffer;
+  delete lines_;
+  delete undo_;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -1116,7 +1309,7 @@ void Input::shift_up_down_position(int p) {
   - Ctrl+U: delete all the text
   - Ctrl+V: paste
   - Ctrl+X, Ctrl+W: cut
-  - Ctrl+Y: redo
+  - Ctrl+Y, Ctrl+Shift+Z: redo
   - Ctrl+Z, Ctrl+/: undo
   - All printing characters are run through fltk::compose() and the result
     used to insert text.
@@ -1289,9 +1482,11 @@ bool Input::handle_key() {
     // alt should clear to end of paragraph, nyi
     i = line_end(position());
     if (i == position() && i < size()) i++;
-    if (cut(position(), i))
+    if (cut(position(), i) && undo_ && undo_->open && type() != SECRET) {
       // Make all the adjacent ^K's go into the clipboard, like Emacs:
-      fltk::copy(undobuffer, yankcut, true);
+      InputUndo::Step& s = undo_->steps[undo_->count-1];
+      fltk::copy(undo_->arena+s.text, s.cut, true);
+    }
     return true;
 
   case 'c':
@@ -1342,7 +1537,7 @@ bool Input::handle_key() {
   case 'y':
     // Check for more global redo action first:
     if (try_shortcut()) return true;
-    return undo_is_redo && undo();
+    return redo();
 #if 0
     // This is actually Emacs paste so do that if nothing else:
     paste(*this,true);
@@ -1355,7 +1550,8 @@ bool Input::handle_key() {
   case EscapeKey:
     // For undo we undo local typing first. Only if this fails do
     // we run some appliation menu item for undo:
-    return !undo_is_redo && undo();
+    if (shift && event_key() == 'z') return redo();
+    return undo();
 
     // Other interesting Emacs characters:
     // 'q' quotes next character
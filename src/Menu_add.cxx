@@ -43,6 +43,7 @@
 #include <fltk/string.h>
 #include <ctype.h>
 #include "ARRAY.h"
+#include "GroupLabels.h"
 
 using namespace fltk;
 
@@ -91,18 +92,9 @@ static Widget* append(
 // flags to determine what innards() does:
 enum AddType {ADD=0, FIND=1, REPLACE=2};
 
-// Skip @ commands, return pointer to null or first actual letter:
-// Except we don't skip a trailing command with no semicolon.
-static inline void skip_embedded(const char*& aa) {
-  const char* a = aa;
-  while (*a == '@') {
-    if (*++a == '@') {aa = a; return;} // return pointer to second @ of @@
-    for (;; a++) {
-      if (!*a) return; // leave pointer unchanged for trailing command
-      if (isspace((uchar)*a) || *a==';') {aa = ++a; break;}
-      if (*a == '@') {aa = a; break;}
-    }
-  }
+// Skip @ commands, shared with the hash of the labels:
+static inline void skip_embedded(const char*& a) {
+  GroupLabels::skip_embedded(a);
 }
 
 // See if widget has the same label, except ignore @-sequences or &-sequences
@@ -130,9 +122,45 @@ static bool match_and_replace(Widget* i, const char* B, int flags, AddType what)
   }
 }
 
+// Return the last child of the group that matches the label and is a
+// parent if want_group is true, or is not one if it is false. If the
+// group is large the hash of the labels is used to find candidates.
+static Widget* find_child(Group* group, const char* label, int flags,
+			  AddType what, bool want_group) {
+  GroupLabels* labels = GroupLabels::get(group);
+  if (!labels) {
+    for (int n = group->children(); n--;) {
+      Widget* w = group->child(n);
+      if (w->is_group() == want_group && match_and_replace(w, label, flags, what))
+	return w;
+    }
+    return 0;
+  }
+  Widget* found = 0;
+  int found_index = -1;
+  unsigned hash = GroupLabels::hash(label);
+  for (int e = labels->first(hash); e >= 0; e = labels->entries[e].next) {
+    if (labels->entries[e].hash != hash) continue;
+    Widget* w = labels->entries[e].widget;
+    if (w->is_group() != want_group) continue;
+    if (!match_and_replace(w, label, flags, FIND)) continue;
+    if (found) {
+      // several match, use the last one like the search above does:
+      if (found_index < 0) found_index = group->find(found);
+      int n = group->find(w);
+      if (n < found_index) continue;
+      found_index = n;
+    }
+    found = w;
+  }
+  if (found && what == REPLACE) match_and_replace(found, label, flags, what);
+  return found;
+}
+
 FL_API bool fl_menu_replaced; // hack so fluid can tell what replace() did
 
 // Innards of Menu::add() and Menu::replace() methods:
+// If start is not null the label is of an item inside it.
 static Widget* innards(
   Group* top,
   const char *label,
@@ -141,9 +169,10 @@ static Widget* innards(
   void *data,
   int flags,
   AddType what,
-  int insert_here
+  int insert_here,
+  Group* start = 0
 ) {
-  Group* group = top;
+  Group* group = start ? start : top;
   int bufsize = strlen(label)+1;
   ARRAY(char, buf, bufsize);
 
@@ -171,22 +200,17 @@ static Widget* innards(
     label = p+1;
 
     // find a matching menu title:
-    for (int n = group->children();;) {
-      if (!n) { // create a new menu
-	if (what == FIND) {
-	  // give up on hierarchy search and find flat item:
-	  item_label = label;
-	  group = top;
-	  goto BREAK1;
-	}
-	group = (Group*)append(group, item_label, SUBMENU|flags1, 0);
-	break;
-      }
-      Widget* w = group->child(--n);
-      if (w->is_group() && match_and_replace(w, item_label, flags, what)) {
-	group = (Group*)w;
-	break;
+    Widget* w = find_child(group, item_label, flags, what, true);
+    if (w) {
+      group = (Group*)w;
+    } else { // create a new menu
+      if (what == FIND) {
+	// give up on hierarchy search and find flat item:
+	item_label = label;
+	group = top;
+	goto BREAK1;
       }
+      group = (Group*)append(group, item_label, SUBMENU|flags1, 0);
     }
     flags1 = 0;
   }
@@ -209,13 +233,7 @@ static Widget* innards(
   } else {
 
     // find a matching menu item:
-    if (what != ADD) for (int n = group->children(); n--;) {
-      Widget* w = group->child(n);
-      if (!w->is_group() && match_and_replace(w, item_label, flags, what)) {
-	item = w;
-	break;
-      }
-    }
+    if (what != ADD) item = find_child(group, item_label, flags, what, false);
   }
 
   if (item) {
@@ -354,13 +372,7 @@ static Widget* flat_innards(
   Widget* item = 0;
 
   // find a matching menu item:
-  if (what != ADD) for (int n = group->children(); n--;) {
-    Widget* w = group->child(n);
-    if (!w->is_group() && match_and_replace(w, label, flags, what)) {
-      item = w;
-      break;
-    }
-  }
+  if (what != ADD) item = find_child(group, label, flags, what, false);
 
   if (item) {
     if (what == FIND) return item;
@@ -460,6 +472,48 @@ Widget* Menu::add_many(const char *str) {
   return r;
 }
 
+// Return how many characters at the start of the label are the names
+// of submenus, up to and including the last '/' that innards() splits
+// the label at:
+static int submenu_length(const char* label) {
+  int length = 0;
+  const char* p = label;
+  for (;;) {
+    if (*p == '/') return length; // the rest is a filename
+    while (*p && *p != '/') {if (*p == '\\' && p[1]) p++; p++;}
+    if (!*p) return length;
+    length = ++p - label;
+  }
+}
+
+/*! Add \a n items, the same as calling add(label) for each of the
+  \a labels, and return the last one.
+
+  If the labels are sorted, or at least the items in each submenu are
+  next to each other, the submenu the previous item went into is used
+  without searching for it again, so a tree of any size is built in
+  one pass.
+*/
+Widget* Menu::add_many(const char* const* labels, int n) {
+  Widget* r = 0;
+  Group* group = 0; // submenu the previous item went into
+  const char* previous = 0;
+  int length = 0; // of the submenu names in previous
+  for (int i = 0; i < n; i++) {
+    const char* label = labels[i];
+    int l = submenu_length(label);
+    if (group && l == length && !strncmp(label, previous, l))
+      r = ::innards(this,label+l,0,0,0,0,ADD,0,group);
+    else
+      r = ::innards(this,label,0,0,0,0,ADD,0);
+    // a trailing slash returns the submenu rather than an item in it:
+    group = (l && !r->is_group()) ? r->parent() : 0;
+    previous = label;
+    length = l;
+  }
+  return r;
+}
+
 //
 // End of "$Id$".
 //
@@ -1,5 +1,9 @@
 #include <fltk/StringList.h>
 #include <fltk/Item.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 using namespace fltk;
 
 /*! \class fltk::StringHierarchy
@@ -13,6 +17,11 @@ using namespace fltk;
   of this class. It can be used by several menus, but the Menu*
   argument to children() and label() is used to differentiate them.
 
+  The generated item does not keep the fltk::SELECTED or fltk::OPENED
+  flags. To use this in a MultiBrowser or to open more than one
+  parent, turn on Browser::row_flags(). For millions of items also
+  set Browser::row_height() so they are not measured.
+
 */
 
 Widget* StringHierarchy::child(const Menu* group, const int* indexes,int level)
@@ -150,3 +159,95 @@ void StringArray::set(const char* s) {
   array = t;
   for (; n--;) t[n] = temp[n];
 }
+
+/* Size of each read from the file if its size is not known */
+#define LOAD_BLOCK (64*1024)
+
+/* Read the whole file into a malloc'd buffer with a nul after the end.
+   Returns NULL if the file cannot be opened, or if it does not fit in
+   the int length. */
+static char* read_file(const char* filename, int& length) {
+  FILE *fl = fopen(filename,"r");
+  if (!fl) return 0;
+  int size = LOAD_BLOCK;
+  if (!fseek(fl, 0, SEEK_END)) {
+    long n = ftell(fl);
+    if (n >= INT_MAX-1) {fclose(fl); return 0;}
+    if (n > 0) size = int(n)+1; // one more so EOF is seen without growing
+    rewind(fl);
+  }
+  char* buffer = (char*)malloc(size+1);
+  if (!buffer) {fclose(fl); return 0;}
+  int n = 0;
+  for (;;) {
+    if (n == size) {
+      char* grown = 0;
+      if (size < INT_MAX/2) grown = (char*)realloc(buffer, 2*size+1);
+      if (!grown) {free(buffer); fclose(fl); return 0;}
+      buffer = grown;
+      size = 2*size;
+    }
+    int r = fread(buffer+n, 1, size-n, fl);
+    if (r <= 0) break;
+    n += r;
+  }
+  fclose(fl);
+  buffer[n] = 0;
+  length = n;
+  return buffer;
+}
+
+/*! \class fltk::StringLines
+  This subclass of List makes a Menu or Browser show the lines of a
+  file. The whole file is read into memory and only the start of each
+  line is remembered, so this is much faster and uses much less memory
+  than Browser::load(), which creates a widget for each line.
+
+  \code
+  StringLines* lines = new StringLines;
+  lines->load("big.txt");
+  browser->list(lines);
+  \endcode
+*/
+
+int StringLines::children(const Menu*) {return children_;}
+
+const char* StringLines::label(const Menu*, int index) {
+  return text_+lines_[index];
+}
+
+/*! Throw away the lines, children() is zero after this. */
+void StringLines::clear() {
+  free(text_); text_ = 0;
+  delete[] lines_; lines_ = 0;
+  children_ = 0;
+}
+
+StringLines::~StringLines() {clear();}
+
+/*! Replace the lines with the lines of a file. Returns 0 if the file
+  could not be opened or is too big to read into memory, -1 if
+  \a filename is NULL, and 1 otherwise. */
+int StringLines::load(const char* filename) {
+  clear();
+  if (!filename || !(filename[0])) return -1;
+  int n;
+  text_ = read_file(filename, n);
+  if (!text_) return 0;
+  int count = 0;
+  char* end = text_+n;
+  for (char* p = text_; p < end; p++) {
+    p = (char*)memchr(p, '\n', end-p);
+    if (!p) {count++; break;}
+    count++;
+  }
+  lines_ = new int[count];
+  for (char* p = text_; p < end;) {
+    char* e = (char*)memchr(p, '\n', end-p);
+    if (!e) e = end;
+    *e = 0;
+    lines_[children_++] = p-text_;
+    p = e+1;
+  }
+  return 1;
+}
@@ -33,6 +33,15 @@
 #include <fltk/ask.h>
 #include <fltk/error.h>
 #include <fltk/TextBuffer.h>
+#include <fltk/run.h>
+#include <limits.h>
+#include "TextSearch.h"
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
 
 // Return number of bytes that a legal UTF-8 encoding starting with cc
 // will use. Returns 1 if cc cannot start an encoding.
@@ -84,26 +93,825 @@ static const char *ControlCodeTable[32] = {
   "can", "em", "sub", "esc", "fs", "gs", "rs", "us"};
 #endif
 
-static char* undobuffer;
-static int undobufferlength;
-static TextBuffer* undowidget;
-static int undoat;	            /// points after insertion
-static int undocut;	            /// number of characters deleted there
-static int undoinsert;	        /// number of characters inserted
-static int undoyankcut;	        /// length of valid contents of buffer, even if undocut=0
-
-static void undobuffersize(int n) {
-  if (n > undobufferlength) {
-    if (undobuffer) {
-      do {undobufferlength *= 2;} while (undobufferlength < n);
-      undobuffer = (char*)realloc(undobuffer, undobufferlength);
+////////////////////////////////////////////////////////////////
+// Undo journal
+
+/* Each buffer keeps a journal of the edits that undo() can reverse, and
+   another of the ones redo() can make again. A journal is one block of
+   memory holding a stack of records, each followed by the text that the
+   edit deleted, so an insertion costs only a record no matter how long
+   it is. Single characters typed or erased next to each other are added
+   to the same record so they are undone together. When the journal
+   grows past undo_limit() the oldest records are thrown away. */
+
+/* Edits this long or shorter are considered typing (one UTF-8 character) */
+#define UNDO_TYPED_LENGTH 4
+
+namespace fltk {
+
+struct UndoRecord {
+  int pos;	/* where the edit was */
+  int inserted;	/* how many characters were inserted at pos */
+  int deleted;	/* how many characters were deleted, they follow this */
+  int back;	/* distance to the previous record, 0 for the first */
+  bool typed;	/* only typing went into this, so more typing can join it */
+  bool joined;	/* undo this together with the previous record */
+};
+
+class TextUndo {
+public:
+  TextUndo() : closed(false), data_(0), length_(0), size_(0), last_(-1) {}
+  ~TextUndo() { free(data_); }
+  UndoRecord *top() { return last_ < 0 ? 0 : (UndoRecord *)(data_ + last_); }
+  static char *text(UndoRecord *r) { return (char *)(r + 1); }
+  UndoRecord *push(int pos, int inserted, int deleted, bool joined);
+  UndoRecord *grow(int deleted);
+  void pop();
+  void limit(int bytes);
+  void clear();
+  bool closed;	/* the top record must not be added to */
+
+private:
+  char *data_;
+  int length_, size_, last_;
+  static int record_size(int deleted);
+  void reserve(int n);
+};
+
+} /* namespace fltk */
+
+/* Room for a record and its deleted text with a nul after it, rounded up
+   so the next record is aligned */
+int TextUndo::record_size(int deleted) {
+  int n = sizeof(UndoRecord) + deleted + 1;
+  return (n + sizeof(int) - 1) & ~(int)(sizeof(int) - 1);
+}
+
+void TextUndo::reserve(int n) {
+  if (n <= size_) return;
+  size_ = size_ ? 2 * size_ : 4096;
+  if (size_ < n) size_ = n;
+  data_ = (char *)realloc(data_, size_);
+}
+
+/* Add a new record to the top, with room for "deleted" characters. If
+   "joined" it is undone together with the record below it. */
+UndoRecord *TextUndo::push(int pos, int inserted, int deleted, bool joined) {
+  int n = record_size(deleted);
+  reserve(length_ + n);
+  UndoRecord *r = (UndoRecord *)(data_ + length_);
+  r->pos = pos;
+  r->inserted = inserted;
+  r->deleted = deleted;
+  r->back = last_ < 0 ? 0 : length_ - last_;
+  r->typed = false;
+  r->joined = joined;
+  text(r)[deleted] = 0;
+  last_ = length_;
+  length_ += n;
+  closed = false;
+  return r;
+}
+
+/* Make room for "deleted" more characters in the top record, which may
+   move it. The caller must fill them in. */
+UndoRecord *TextUndo::grow(int deleted) {
+  UndoRecord *r = top();
+  int n = record_size(r->deleted + deleted);
+  reserve(last_ + n);
+  r = top();
+  r->deleted += deleted;
+  text(r)[r->deleted] = 0;
+  length_ = last_ + n;
+  return r;
+}
+
+void TextUndo::pop() {
+  UndoRecord *r = top();
+  if (!r) return;
+  length_ = last_;
+  last_ = r->back ? last_ - r->back : -1;
+  /* don't hang onto the memory used by something huge */
+  if (size_ > 65536 && length_ < size_ / 4) {
+    size_ = length_ > 32768 ? 2 * length_ : 65536;
+    data_ = (char *)realloc(data_, size_);
+  }
+}
+
+/* Throw away the oldest records if the journal uses more than "bytes",
+   but always keep the top one. A record joined to an older one is thrown
+   away with it. A quarter of the limit more than needed is thrown away,
+   so the rest is only moved down once every few edits. */
+void TextUndo::limit(int bytes) {
+  if (length_ <= bytes || last_ <= 0) return;
+  int keep = bytes - bytes / 4;
+  int first = 0;
+  while (first < last_) {
+    UndoRecord *r = (UndoRecord *)(data_ + first);
+    if (first && !r->joined && length_ - first <= keep) break;
+    first += record_size(r->deleted);
+  }
+  memmove(data_, data_ + first, length_ - first);
+  length_ -= first;
+  last_ -= first;
+  UndoRecord *r = (UndoRecord *)data_;
+  r->back = 0;
+  r->joined = false;
+}
+
+void TextUndo::clear() {
+  length_ = 0;
+  last_ = -1;
+  closed = false;
+}
+
+////////////////////////////////////////////////////////////////
+// Piece table storage
+
+/* The piece table keeps the text as an ordered sequence of "pieces",
+   each of which points at a run of bytes in a block of memory that is
+   never modified once written.  Inserted text is appended to the
+   current add block, and removing text only drops pieces, so edits
+   anywhere in the buffer are O(log n) in the number of pieces and the
+   original contents are never moved or copied.  Each block counts how
+   many bytes of it the pieces use, and is freed when that drops to zero,
+   so removing text from the start of a buffer that is only appended to
+   frees whole blocks without looking at the text in them.
+
+   The pieces are kept in a treap ordered by buffer position, where
+   every node also stores the total length of its subtree so a buffer
+   position can be found by walking down from the root. */
+
+/* Size of the blocks inserted text is appended to */
+#define PIECE_BLOCK_SIZE (64*1024)
+
+/* No piece is made longer than this, so the newlines in part of a
+   piece can be counted quickly when it is split */
+#define PIECE_MAX_LENGTH (8*1024)
+
+/* memchr() is much faster than looking at every byte unless the lines
+   are very short, which matters when a huge file is inserted or mapped */
+static int count_newlines(const char *p, int n) {
+  int count = 0;
+  const char *e = p + n;
+  while (p < e && (p = (const char *)memchr(p, '\n', e - p))) {
+    count++;
+    p++;
+  }
+  return count;
+}
+
+/* Return the index of the n'th newline (n starts at 1) in p */
+static int find_newline(const char *p, int n) {
+  for (int i = 0; ; i++)
+    if (p[i] == '\n' && !--n) return i;
+}
+
+namespace fltk {
+
+class TextPieceTable {
+public:
+  struct Block;
+  struct Piece {
+    Piece *left, *right;
+    unsigned priority;
+    Block *block;	/* memory text points into */
+    const char *text;
+    int length;		/* number of bytes in this piece */
+    int total;		/* number of bytes in this subtree */
+    int newlines;	/* number of newlines in this piece */
+    int totalnewlines;	/* number of newlines in this subtree */
+  };
+
+  struct Block {
+    Block *next;
+    int size, used;
+    int live;		/* bytes that pieces point at */
+    char *data;
+    bool mapped;	/* data is a file mapping to munmap() */
+#ifndef _WIN32
+    dev_t dev;		/* the mapped file */
+    ino_t ino;
+#endif
+  };
+
+  TextPieceTable();
+  ~TextPieceTable();
+
+  void clear();
+  Block *new_block(int size);
+  void adopt(char *data, int length);
+#ifndef _WIN32
+  void map(char *data, int size, int length, dev_t dev, ino_t ino);
+  void unmap(dev_t dev, ino_t ino);
+#endif
+  void insert(int pos, const char *s, int n);
+  void insert_shared(int pos, Block *b, const char *s, int n);
+  void remove(int start, int end);
+  const char *find(int pos, int *start, int *length);
+  void copy(char *to, int start, int end);
+  const char *flatten(int length);
+  int newlines_before(int pos);
+  int line_position(int line);
+  char at(int pos) {
+    if (pos < cachestart_ || pos >= cachestart_ + cachelength_) {
+      int s, l; find(pos, &s, &l);
+    }
+    return cachetext_[pos - cachestart_];
+  }
+  int length() const { return root_ ? root_->total : 0; }
+
+private:
+  Piece *root_;
+  Block *blocks_;	/* most recent first, blocks_ is the add block */
+  unsigned seed_;
+  const char *cachetext_; /* piece found by the last find() */
+  int cachestart_, cachelength_;
+  char *flat_;		/* contiguous copy returned by flatten() */
+
+  Piece *new_piece(Block *b, const char *text, int length);
+  void changed();
+  static int total(Piece *p) { return p ? p->total : 0; }
+  static int totalnewlines(Piece *p) { return p ? p->totalnewlines : 0; }
+  static void update(Piece *p) {
+    p->total = total(p->left) + p->length + total(p->right);
+    p->totalnewlines =
+      totalnewlines(p->left) + p->newlines + totalnewlines(p->right);
+  }
+  static bool free_pieces(Piece *p);
+  void free_unused_blocks();
+  static void rebase(Piece *p, const char *from, int size, const char *to);
+  static void split(Piece *t, int pos, Piece **l, Piece **r);
+  static Piece *merge(Piece *l, Piece *r);
+  static bool extend_last(Piece *t, Block *b, const char *s, int n);
+};
+
+} /* namespace fltk */
+
+TextPieceTable::TextPieceTable() {
+  root_ = 0;
+  blocks_ = 0;
+  seed_ = 2463534242U;
+  cachetext_ = 0;
+  cachestart_ = cachelength_ = 0;
+  flat_ = 0;
+}
+
+TextPieceTable::~TextPieceTable() {
+  clear();
+}
+
+/* Forget all the text and free all the memory */
+void TextPieceTable::clear() {
+  free_pieces(root_);
+  root_ = 0;
+  while (blocks_) {
+    Block *b = blocks_;
+    blocks_ = b->next;
+#ifndef _WIN32
+    if (b->mapped) munmap(b->data, b->size); else
+#endif
+    free(b->data);
+    delete b;
+  }
+  changed();
+}
+
+/* Called whenever the sequence of pieces changes */
+void TextPieceTable::changed() {
+  cachetext_ = 0;
+  cachestart_ = cachelength_ = 0;
+  if (flat_) {free(flat_); flat_ = 0;}
+}
+
+/* Allocate a block of memory for the caller to fill and then pass to
+   insert_shared().  The block is marked as full so inserted text is
+   never appended to it. */
+TextPieceTable::Block *TextPieceTable::new_block(int size) {
+  Block *b = new Block;
+  b->data = (char *)malloc(size ? size : 1);
+  b->size = b->used = size;
+  b->live = 0;
+  b->mapped = false;
+  if (blocks_) {		// keep the current add block first
+    b->next = blocks_->next;
+    blocks_->next = b;
+  } else {
+    b->next = 0;
+    blocks_ = b;
+    b->used = b->size;
+  }
+  return b;
+}
+
+/* Take ownership of malloc'd memory (such as the old gap buffer) and
+   make it the entire contents of the table, without copying it. */
+void TextPieceTable::adopt(char *data, int length) {
+  clear();
+  Block *b = new Block;
+  b->data = data;
+  b->size = b->used = length;
+  b->live = 0;
+  b->mapped = false;
+  b->next = 0;
+  blocks_ = b;
+  insert_shared(0, b, data, length);
+}
+
+#ifndef _WIN32
+/* Make a read-only mapping of size bytes of a file the entire contents
+   of the table, of which the first length bytes are text.  The mapping
+   is never written, edits go into other blocks like they do for any
+   other text, and it is unmapped once none of the text is left. */
+void TextPieceTable::map(char *data, int size, int length,
+			 dev_t dev, ino_t ino) {
+  clear();
+  Block *b = new Block;
+  b->data = data;
+  b->size = b->used = size;
+  b->live = 0;
+  b->mapped = true;
+  b->dev = dev;
+  b->ino = ino;
+  b->next = 0;
+  blocks_ = b;
+  insert_shared(0, b, data, length);
+}
+
+/* If the file is mapped, copy it into memory and unmap it, so the file
+   can be rewritten without the text changing or disappearing. */
+void TextPieceTable::unmap(dev_t dev, ino_t ino) {
+  for (Block *b = blocks_; b; b = b->next) {
+    if (!b->mapped || b->dev != dev || b->ino != ino) continue;
+    char *data = (char *)malloc(b->size);
+    memcpy(data, b->data, b->size);
+    rebase(root_, b->data, b->size, data);
+    munmap(b->data, b->size);
+    b->data = data;
+    b->mapped = false;
+    changed();
+  }
+}
+#endif
+
+TextPieceTable::Piece *
+TextPieceTable::new_piece(Block *b, const char *text, int length) {
+  Piece *p = new Piece;
+  p->left = p->right = 0;
+  seed_ ^= seed_ << 13; seed_ ^= seed_ >> 17; seed_ ^= seed_ << 5;
+  p->priority = seed_;
+  p->block = b;
+  p->text = text;
+  p->length = p->total = length;
+  p->newlines = p->totalnewlines = count_newlines(text, length);
+  return p;
+}
+
+/* Delete the pieces, returning true if this leaves any block unused */
+bool TextPieceTable::free_pieces(Piece *p) {
+  bool unused = false;
+  while (p) {
+    if (free_pieces(p->left)) unused = true;
+    if (!(p->block->live -= p->length)) unused = true;
+    Piece *r = p->right;
+    delete p;
+    p = r;
+  }
+  return unused;
+}
+
+/* Free the blocks no piece points at, except the add block */
+void TextPieceTable::free_unused_blocks() {
+  if (!blocks_) return;
+  for (Block **pp = &blocks_->next; *pp;) {
+    Block *b = *pp;
+    if (b->live) {pp = &b->next; continue;}
+    *pp = b->next;
+#ifndef _WIN32
+    if (b->mapped) munmap(b->data, b->size); else
+#endif
+    free(b->data);
+    delete b;
+  }
+}
+
+/* Point the pieces that reference size bytes at from to the same
+   bytes at to instead */
+void TextPieceTable::rebase(Piece *p, const char *from, int size,
+			    const char *to) {
+  for (; p; p = p->right) {
+    rebase(p->left, from, size, to);
+    if (p->text >= from && p->text < from + size)
+      p->text = to + (p->text - from);
+  }
+}
+
+/* Split the tree t into the pieces before and after position pos,
+   cutting the piece that contains pos in two if necessary. */
+void TextPieceTable::split(Piece *t, int pos, Piece **l, Piece **r) {
+  if (!t) {*l = *r = 0; return;}
+  int leftlength = total(t->left);
+  if (pos <= leftlength) {
+    split(t->left, pos, l, &t->left);
+    update(t);
+    *r = t;
+  } else if (pos >= leftlength + t->length) {
+    split(t->right, pos - leftlength - t->length, &t->right, r);
+    update(t);
+    *l = t;
+  } else {
+    int n = pos - leftlength;
+    Piece *tail = new Piece;
+    tail->priority = t->priority;
+    tail->block = t->block;
+    tail->text = t->text + n;
+    tail->length = t->length - n;
+    /* count the newlines in whichever part is shorter */
+    if (n < tail->length) {
+      tail->newlines = t->newlines - count_newlines(t->text, n);
+    } else {
+      tail->newlines = count_newlines(tail->text, tail->length);
+    }
+    tail->left = 0;
+    tail->right = t->right;
+    update(tail);
+    t->length = n;
+    t->newlines -= tail->newlines;
+    t->right = 0;
+    update(t);
+    *l = t;
+    *r = tail;
+  }
+}
+
+TextPieceTable::Piece *TextPieceTable::merge(Piece *l, Piece *r) {
+  if (!l) return r;
+  if (!r) return l;
+  if (l->priority > r->priority) {
+    l->right = merge(l->right, r);
+    update(l);
+    return l;
+  }
+  r->left = merge(l, r->left);
+  update(r);
+  return r;
+}
+
+/* If the last piece of t ends right where s starts, make it longer
+   instead of adding a new piece.  This makes typing add no pieces. */
+bool TextPieceTable::extend_last(Piece *t, Block *b, const char *s, int n) {
+  if (!t) return false;
+  if (t->right) {
+    if (!extend_last(t->right, b, s, n)) return false;
+  } else {
+    if (t->block != b || t->text + t->length != s ||
+	t->length + n > PIECE_MAX_LENGTH)
+      return false;
+    t->length += n;
+    t->newlines += count_newlines(s, n);
+  }
+  update(t);
+  return true;
+}
+
+/* Copy the text into the add block and insert a piece for it */
+void TextPieceTable::insert(int pos, const char *s, int n) {
+  if (n <= 0) return;
+  Block *b = blocks_;
+  if (!b || b->size - b->used < n) {
+    b = new Block;
+    b->size = n > PIECE_BLOCK_SIZE ? n : PIECE_BLOCK_SIZE;
+    b->used = b->live = 0;
+    b->data = (char *)malloc(b->size);
+    b->mapped = false;
+    b->next = blocks_;
+    blocks_ = b;
+  }
+  char *to = b->data + b->used;
+  memcpy(to, s, n);
+  b->used += n;
+  insert_shared(pos, b, to, n);
+}
+
+/* Insert a piece referencing n bytes at s in block b */
+void TextPieceTable::insert_shared(int pos, Block *b, const char *s, int n) {
+  if (n <= 0) return;
+  b->live += n;
+  Piece *l, *r;
+  split(root_, pos, &l, &r);
+  if (n <= PIECE_MAX_LENGTH && extend_last(l, b, s, n)) {
+    n = 0;
+  }
+  for (int i = 0; i < n; i += PIECE_MAX_LENGTH) {
+    int length = n - i < PIECE_MAX_LENGTH ? n - i : PIECE_MAX_LENGTH;
+    l = merge(l, new_piece(b, s + i, length));
+  }
+  root_ = merge(l, r);
+  changed();
+}
+
+void TextPieceTable::remove(int start, int end) {
+  if (end <= start) return;
+  Piece *l, *m, *r;
+  split(root_, start, &l, &r);
+  split(r, end - start, &m, &r);
+  if (free_pieces(m)) free_unused_blocks();
+  root_ = merge(l, r);
+  changed();
+}
+
+/* Return the piece containing pos, and its starting position and length */
+const char *TextPieceTable::find(int pos, int *start, int *length) {
+  if (cachetext_ && pos >= cachestart_ && pos < cachestart_ + cachelength_) {
+    *start = cachestart_;
+    *length = cachelength_;
+    return cachetext_;
+  }
+  int offset = 0;
+  Piece *t = root_;
+  while (t) {
+    int leftlength = total(t->left);
+    if (pos < offset + leftlength) {
+      t = t->left;
+    } else if (pos < offset + leftlength + t->length) {
+      cachetext_ = t->text;
+      cachestart_ = *start = offset + leftlength;
+      cachelength_ = *length = t->length;
+      return cachetext_;
     } else {
-      undobufferlength = n+9;
-      undobuffer = (char*)malloc(undobufferlength);
+      offset += leftlength + t->length;
+      t = t->right;
+    }
+  }
+  *start = total(root_);
+  *length = 0;
+  return 0;
+}
+
+/* Return how many newlines there are before pos */
+int TextPieceTable::newlines_before(int pos) {
+  int count = 0;
+  Piece *t = root_;
+  while (t) {
+    int leftlength = total(t->left);
+    if (pos < leftlength) {
+      t = t->left;
+    } else if (pos < leftlength + t->length) {
+      pos -= leftlength;
+      count += totalnewlines(t->left);
+      if (pos < t->length / 2)
+        return count + count_newlines(t->text, pos);
+      return count + t->newlines -
+        count_newlines(t->text + pos, t->length - pos);
+    } else {
+      pos -= leftlength + t->length;
+      count += totalnewlines(t->left) + t->newlines;
+      t = t->right;
+    }
+  }
+  return count;
+}
+
+/* Return the position after the line'th newline, or -1 if there are
+   not that many.  line must be greater than zero. */
+int TextPieceTable::line_position(int line) {
+  int offset = 0;
+  Piece *t = root_;
+  while (t) {
+    int leftnewlines = totalnewlines(t->left);
+    if (line <= leftnewlines) {
+      t = t->left;
+    } else if (line <= leftnewlines + t->newlines) {
+      return offset + total(t->left) +
+        find_newline(t->text, line - leftnewlines) + 1;
+    } else {
+      line -= leftnewlines + t->newlines;
+      offset += total(t->left) + t->length;
+      t = t->right;
+    }
+  }
+  return -1;
+}
+
+/* Copy the bytes between start and end into to */
+void TextPieceTable::copy(char *to, int start, int end) {
+  while (start < end) {
+    int s, l;
+    const char *p = find(start, &s, &l);
+    int n = (s + l < end ? s + l : end) - start;
+    memcpy(to, p + (start - s), n);
+    to += n;
+    start += n;
+  }
+}
+
+/* Return all the text as a nul-terminated string, valid until the next
+   change.  This is the only operation that duplicates the contents. */
+const char *TextPieceTable::flatten(int length) {
+  if (!flat_) {
+    flat_ = (char *)malloc(length + 1);
+    copy(flat_, 0, length);
+    flat_[length] = 0;
+  }
+  return flat_;
+}
+
+////////////////////////////////////////////////////////////////
+// Line index for the gap buffer
+
+/* The gap buffer's memory is divided into chunks of LINE_INDEX_CHUNK
+   bytes, and a Fenwick tree of the number of newlines in each chunk
+   (not counting bytes in the gap) is kept.  This finds the line number
+   of a position, or the position of a line, in O(log n) plus a scan of
+   one chunk.  Moving the gap or inserting or removing text only needs
+   the bytes that were put in place or taken away to be counted. */
+
+#define LINE_INDEX_SHIFT 12
+#define LINE_INDEX_CHUNK (1<<LINE_INDEX_SHIFT)
+
+/* Ranges shorter than this are just scanned rather than looked up */
+#define LINE_INDEX_SCAN (4*LINE_INDEX_CHUNK)
+
+namespace fltk {
+
+class TextLineIndex {
+public:
+  TextLineIndex(const char *buf, int size, int gapstart, int gapend);
+  ~TextLineIndex() { delete[] count_; delete[] tree_; }
+  void update(const char *buf, int from, int to, int sign);
+  int newlines_before(const char *buf, int size, int gapstart, int gapend,
+                      int at);
+  int find(const char *buf, int size, int gapstart, int gapend, int line);
+  int chunks() const { return chunks_; }
+
+private:
+  int chunks_;
+  int *count_;	/* newlines in each chunk */
+  int *tree_;	/* Fenwick tree of count_, indexed from 1 */
+  static int count(const char *buf, int size, int gapstart, int gapend,
+                   int from, int to);
+};
+
+} /* namespace fltk */
+
+/* Count the newlines between from and to that are not in the gap */
+int TextLineIndex::count(const char *buf, int size, int gapstart, int gapend,
+                         int from, int to) {
+  int n = 0;
+  if (to > size) to = size;
+  if (from < gapstart)
+    n += count_newlines(buf + from, (to < gapstart ? to : gapstart) - from);
+  if (from < gapend) from = gapend;
+  if (from < to)
+    n += count_newlines(buf + from, to - from);
+  return n;
+}
+
+TextLineIndex::TextLineIndex(const char *buf, int size, int gapstart, int gapend) {
+  chunks_ = (size + LINE_INDEX_CHUNK - 1) >> LINE_INDEX_SHIFT;
+  count_ = new int[chunks_ + 1];
+  tree_ = new int[chunks_ + 1];
+  for (int i = 0; i < chunks_; i++) {
+    int from = i << LINE_INDEX_SHIFT;
+    count_[i] = count(buf, size, gapstart, gapend, from, from + LINE_INDEX_CHUNK);
+    tree_[i + 1] = count_[i];
+  }
+  for (int i = 1; i <= chunks_; i++) {
+    int j = i + (i & -i);
+    if (j <= chunks_) tree_[j] += tree_[i];
+  }
+}
+
+/* Text was put in the memory between from and to (sign is 1), or is
+   about to be moved out of it or covered by the gap (sign is -1), so add
+   or subtract its newlines from the chunks it is in. */
+void TextLineIndex::update(const char *buf, int from, int to, int sign) {
+  for (int k = from >> LINE_INDEX_SHIFT; from < to; k++) {
+    int end = (k + 1) << LINE_INDEX_SHIFT;
+    if (end > to) end = to;
+    int delta = sign * count_newlines(buf + from, end - from);
+    from = end;
+    if (!delta) continue;
+    count_[k] += delta;
+    for (int i = k + 1; i <= chunks_; i += i & -i) tree_[i] += delta;
+  }
+}
+
+/* Return how many newlines there are in the text before memory
+   location "at" */
+int TextLineIndex::newlines_before(const char *buf, int size, int gapstart,
+                                   int gapend, int at) {
+  int k = at >> LINE_INDEX_SHIFT;
+  if (k > chunks_) k = chunks_;
+  int n = count(buf, size, gapstart, gapend, k << LINE_INDEX_SHIFT, at);
+  for (int i = k; i > 0; i -= i & -i) n += tree_[i];
+  return n;
+}
+
+/* Return the memory location after the line'th newline, or -1 if there
+   are not that many.  line must be greater than zero. */
+int TextLineIndex::find(const char *buf, int size, int gapstart, int gapend,
+                        int line) {
+  int k = 0;
+  int step = 1;
+  while (step * 2 <= chunks_) step *= 2;
+  for (; step; step /= 2) {
+    if (k + step <= chunks_ && tree_[k + step] < line) {
+      k += step;
+      line -= tree_[k];
     }
   }
+  if (k >= chunks_) return -1;
+  /* the newline is in chunk k, skipping the gap */
+  int from = k << LINE_INDEX_SHIFT;
+  int to = from + LINE_INDEX_CHUNK;
+  if (to > size) to = size;
+  if (from < gapstart) {
+    int end = to < gapstart ? to : gapstart;
+    int n = count_newlines(buf + from, end - from);
+    if (line <= n) return from + find_newline(buf + from, line) + 1;
+    line -= n;
+  }
+  if (from < gapend) from = gapend;
+  return from + find_newline(buf + from, line) + 1;
+}
+
+////////////////////////////////////////////////////////////////
+// Column marks
+
+/* Finding the displayed column of a position, or the position of a
+   column, must look at every character from the start of the line
+   because of tabs and multi-byte characters.  To make moving around a
+   very long line fast, the column reached every COLUMN_MARK_SPACING
+   bytes is remembered for the last line that was scanned, so the next
+   scan of that line can start at the closest mark.  An edit only
+   forgets the marks after the edit. */
+
+#define COLUMN_MARK_SPACING 1024
+
+/* Lines shorter than this are just scanned without making marks */
+#define COLUMN_MARK_MIN (4*COLUMN_MARK_SPACING)
+
+namespace fltk {
+
+class TextColumnIndex {
+public:
+  struct Mark {
+    int pos;
+    int column;
+  };
+
+  int linestart;	/* line the marks are for, or -1 */
+  unsigned used;	/* when the marks were last used */
+  int count, size;
+  Mark *marks;		/* in increasing order of pos, not including the
+			   line start */
+
+  TextColumnIndex() : linestart(-1), used(0), count(0), size(0), marks(0) {}
+  ~TextColumnIndex() { free(marks); }
+  void add(int pos, int column);
+  void changed(int pos, int ndeleted, int ninserted);
+};
+
+} /* namespace fltk */
+
+/* Marks are kept for this many lines, so moving up and down between
+   two long lines does not throw them away */
+#define COLUMN_MARK_LINES 2
+
+void TextColumnIndex::add(int pos, int column) {
+  if (count >= size) {
+    size = size ? 2 * size : 64;
+    marks = (Mark *)realloc(marks, size * sizeof(Mark));
+  }
+  marks[count].pos = pos;
+  marks[count].column = column;
+  count++;
 }
 
+/* Text was replaced, forget the marks it changes */
+void TextColumnIndex::changed(int pos, int ndeleted, int ninserted) {
+  if (linestart < 0) return;
+  if (pos < linestart) {
+    if (pos + ndeleted > linestart) {linestart = -1; return;}
+    int delta = ninserted - ndeleted;
+    linestart += delta;
+    for (int i = 0; i < count; i++) marks[i].pos += delta;
+    return;
+  }
+  /* a column only depends on the text before it */
+  while (count && marks[count - 1].pos > pos) count--;
+}
+
+/* True if any of the 4 bytes in w is not printable ASCII */
+static inline bool not_plain(unsigned w) {
+  return ((w & 0x80808080U) |
+          ((w - 0x20202020U) & ~w & 0x80808080U) |
+          (((w ^ 0x7f7f7f7fU) - 0x01010101U) & ~(w ^ 0x7f7f7f7fU) & 0x80808080U)) != 0;
+}
+
+////////////////////////////////////////////////////////////////
+
 /**
  * Create an empty text buffer of a pre-determined size (use this to
  * avoid unnecessary re-allocation if you know exactly how much the buffer
@@ -114,6 +922,8 @@ TextBuffer::TextBuffer(int requestedsize) {
   buf_ = (char *)malloc(requestedsize + PREFERRED_GAP_SIZE);
   gapstart_ = 0;
   gapend_   = PREFERRED_GAP_SIZE;
+  pieces_   = 0;
+  lineindex_ = 0;
   tabdist_  = 8;
   usetabs_  = true;
 
@@ -125,10 +935,30 @@ TextBuffer::TextBuffer(int requestedsize) {
   predeleteprocs_ = NULL;
   prepeletecbargs_ = NULL;
 
+  batchdepth_ = 0;
+  batchstart_ = -1;
+  batchend_ = 0;
+  batchdeleted_ = 0;
+  batchdeletedlength_ = batchdeletedsize_ = 0;
+  batchchanged_ = batchnotify_ = false;
+
   cursorposhint_ = 0;
   nullsubschar_ = '\0';
 
   mCanUndo = 1;
+  undojournal_ = 0;
+  redojournal_ = 0;
+  undolimit_ = 32*1024*1024;
+  undoing_ = 0;
+  undogroup_ = 0;
+  undogrouped_ = false;
+
+  appended_ = 0;
+  appendedlength_ = appendedsize_ = 0;
+  columns_ = 0;
+  columnsused_ = 0;
+  maxbytes_ = maxlines_ = 0;
+  io_ = 0;
 
 #ifdef PURIFY
     { int i; for (i = gapstart_; i < gapend_; i++) buf_[i] = '.'; }
@@ -139,7 +969,18 @@ TextBuffer::TextBuffer(int requestedsize) {
  * Free a text buffer
  */
 TextBuffer::~TextBuffer() {
+  if (io_) delete_io_();
   free(buf_);
+  delete pieces_;
+  delete lineindex_;
+  delete undojournal_;
+  delete redojournal_;
+  delete[] columns_;
+  free(batchdeleted_);
+  if (appended_) {
+    remove_check(flush_appends_cb, this);
+    free(appended_);
+  }
   if (nmodifyprocs_ != 0) {
     delete[] modifyprocs_;
     delete[] modifycbargs_;
@@ -150,6 +991,45 @@ TextBuffer::~TextBuffer() {
   }
 }
 
+/**
+ * Change how the text is stored.  The default GAP_BUFFER keeps all the
+ * text in one block of memory with a gap where the last edit was, which
+ * is fast for typing but must move all the text between the gap and the
+ * next edit, and must reallocate and copy everything when it grows.
+ *
+ * PIECE_TABLE keeps the text as a balanced tree of pieces of memory that
+ * are never modified, so edits anywhere in the buffer take O(log n) and
+ * files read with insertfile() are never copied after being read. This
+ * is better for very large buffers that are edited at random positions.
+ * It makes character() slightly slower, and text() must assemble a copy
+ * of the entire buffer, so avoid calling that.
+ *
+ * Switching to PIECE_TABLE reuses the gap buffer's memory without
+ * copying it. Switching back assembles the text into a new gap buffer.
+ * Neither calls the modify callbacks as the text does not change.
+ */
+void TextBuffer::storage(Storage s) {
+  if (s == storage()) return;
+  delete lineindex_;
+  lineindex_ = 0;
+  if (s == PIECE_TABLE) {
+    if (gapstart_ != length_) move_gap(length_);
+    pieces_ = new TextPieceTable;
+    pieces_->adopt(buf_, length_);
+    buf_ = (char *)malloc(PREFERRED_GAP_SIZE);
+    gapstart_ = 0;
+    gapend_ = PREFERRED_GAP_SIZE;
+  } else {
+    free(buf_);
+    buf_ = (char *)malloc(length_ + PREFERRED_GAP_SIZE);
+    pieces_->copy(buf_, 0, length_);
+    gapstart_ = length_;
+    gapend_ = length_ + PREFERRED_GAP_SIZE;
+    delete pieces_;
+    pieces_ = 0;
+  }
+}
+
 /**
  * Return the entire contents of the text buffer. Returned memory is
  * temporary and will only be usable until the next time the text is
@@ -158,15 +1038,13 @@ TextBuffer::~TextBuffer() {
  * Unlike previous versions of fltk, DO NOT FREE THE RETURNED RESULT!
  */
 const char *TextBuffer::text() {
-  if (!gapstart_ && length_) {
-    buf_[length_+gapend_] = 0;
-    return buf_+gapend_;
-  }
-  if (gapstart_ < gapend_) {
-    memmove(&buf_[gapstart_], &buf_[gapend_], length_-gapstart_);
-    gapstart_ = gapend_ = length_;
-  }
-  buf_[length_] = 0; // add null terminator, assume length < buffer size!
+  if (pieces_) return pieces_->flatten(length_);
+  /* move the gap to the end, and keep it so there is room for the nul */
+  if (gapstart_ == gapend_)
+    reallocate_with_gap(length_, PREFERRED_GAP_SIZE);
+  else if (gapstart_ != length_)
+    move_gap(length_);
+  buf_[length_] = 0;
   return buf_;
 }
 
@@ -184,14 +1062,32 @@ void TextBuffer::text(const char *t) {
   char* oldbuf = buf_; // keep this until we are done w deleted_text
   int insert_length = strlen(t);
 
+  if (pieces_) {
+    /* Keep the old pieces until we are done w deleted_text */
+    TextPieceTable *oldpieces = pieces_;
+    pieces_ = new TextPieceTable;
+    pieces_->insert(0, t, insert_length);
+    length_ = insert_length;
+    update_selections(0, deleted_length, 0);
+    clear_undo();
+    call_modify_callbacks(0, deleted_length, insert_length, 0, deleted_text);
+    delete oldpieces;
+    return;
+  }
+
   /* Start a new buffer with a gap of PREFERRED_GAP_SIZE at end */
   buf_ = (char*)malloc(insert_length + PREFERRED_GAP_SIZE);
   length_ = gapstart_ = gapend_ = insert_length;
   strcpy(buf_, t);
+  delete lineindex_;
+  lineindex_ = 0;
 
   /* Zero all of the existing selections */
   update_selections(0, deleted_length, 0);
 
+  /* The old edits make no sense for the new text */
+  clear_undo();
+
   /* Call the saved display routine(s) to update the screen */
   call_modify_callbacks(0, deleted_length, insert_length, 0, deleted_text);
 
@@ -205,7 +1101,7 @@ void TextBuffer::text(const char *t) {
  */
 char *TextBuffer::text_range(int start, int end) {
   char *text;
-  int length, part1length;
+  int length;
   
   /* Make sure start and end are ok, and allocate memory for returned string.
      If start is bad, return "", if end is bad, adjust it. */
@@ -226,17 +1122,58 @@ char *TextBuffer::text_range(int start, int end) {
   text = (char*)malloc(length+1);
   
   /* Copy the text from the buffer to the returned string */
-  if (end <= gapstart_) {
-      memcpy(text, &buf_[start], length);
+  copy_range_(text, start, end);
+  text[length] = '\0';
+  return text;
+}
+
+/**
+ * Copy the characters between "start" and "end" to "to", which must
+ * have room for them.  No null terminator is added.  The positions
+ * must be in range.
+ */
+void TextBuffer::copy_range_(char *to, int start, int end) {
+  int part1length;
+
+  if (pieces_) {
+      pieces_->copy(to, start, end);
+  } else if (end <= gapstart_) {
+      memcpy(to, &buf_[start], end - start);
   } else if (start >= gapstart_) {
-      memcpy(text, &buf_[start+(gapend_-gapstart_)], length);
+      memcpy(to, &buf_[start+(gapend_-gapstart_)], end - start);
   } else {
       part1length = gapstart_ - start;
-      memcpy(text, &buf_[start], part1length);
-      memcpy(&text[part1length], &buf_[gapend_], length-part1length);
+      memcpy(to, &buf_[start], part1length);
+      memcpy(&to[part1length], &buf_[gapend_], end-start-part1length);
   }
-  text[length] = '\0';
-  return text;
+}
+
+/**
+ * Return a pointer to the longest run of contiguous characters in
+ * memory that includes position "pos", and set "chunkstart" to the
+ * position of the first of them and "chunklength" to how many there
+ * are.  For the gap buffer this is the text before or after the gap,
+ * for the piece table it is a single piece. The pointer is only good
+ * until the next time the text is altered.  If "pos" is not less than
+ * length() this returns NULL and chunklength is set to zero.
+ */
+const char *TextBuffer::chunk(int pos, int *chunkstart, int *chunklength) {
+  if (pos < 0) pos = 0;
+  if (pos >= length_) {
+    *chunkstart = length_;
+    *chunklength = 0;
+    return 0;
+  }
+  if (pieces_)
+    return pieces_->find(pos, chunkstart, chunklength);
+  if (pos < gapstart_) {
+    *chunkstart = 0;
+    *chunklength = gapstart_;
+    return buf_;
+  }
+  *chunkstart = gapstart_;
+  *chunklength = length_ - gapstart_;
+  return buf_ + gapend_;
 }
 
 /**
@@ -245,6 +1182,8 @@ char *TextBuffer::text_range(int start, int end) {
 char TextBuffer::character(int pos) {
   if (pos < 0 || pos >= length_)
     return '\0';
+  if (pieces_)
+    return pieces_->at(pos);
   if (pos < gapstart_)
     return buf_[pos];
   
@@ -286,7 +1225,6 @@ void TextBuffer::replace(int start, int end, const char *s) {
   call_predelete_callbacks(start, end-start);
   deleted_text = text_range(start, end);
   remove_(start, end);
-  //undoyankcut = undocut;
   ninserted = insert_(start, s);
   cursorposhint_ = start + ninserted;
   call_modify_callbacks(start, end - start, ninserted, 0, deleted_text);
@@ -320,7 +1258,16 @@ void TextBuffer::remove(int start, int end) {
 
 void TextBuffer::copy(TextBuffer *from_buf, int from_start, int from_end, int to_pos) {
   int copy_length = from_end - from_start;
-  int part1length;
+
+  if (pieces_) {
+    char *s = from_buf->text_range(from_start, from_end);
+    pieces_->insert(to_pos, s, copy_length);
+    free(s);
+    length_ += copy_length;
+    record_insert_(to_pos, copy_length);
+    update_selections(to_pos, 0, copy_length);
+    return;
+  }
 
   /* Prepare the buffer to receive the new text.  If the new text fits in
      the current buffer, just move the gap (if necessary) to where
@@ -333,66 +1280,167 @@ void TextBuffer::copy(TextBuffer *from_buf, int from_start, int from_end, int to
     move_gap(to_pos);
   
   /* Insert the new text (to_pos now corresponds to the start of the gap) */
-  if (from_end <= from_buf->gapstart_) {
-      memcpy(&buf_[to_pos], &from_buf->buf_[from_start], copy_length);
-  } else if (from_start >= from_buf->gapstart_) {
-      memcpy(&buf_[to_pos],
-            &from_buf->buf_[from_start+(from_buf->gapend_-from_buf->gapstart_)],
-            copy_length);
-  } else {
-      part1length = from_buf->gapstart_ - from_start;
-      memcpy(&buf_[to_pos], &from_buf->buf_[from_start], part1length);
-      memcpy(&buf_[to_pos+part1length], &from_buf->buf_[from_buf->gapend_],
-            copy_length-part1length);
-  }
+  from_buf->copy_range_(&buf_[to_pos], from_start, from_end);
   gapstart_ += copy_length;
   length_ += copy_length;
+  update_line_index_(to_pos, gapstart_, 1);
+  record_insert_(to_pos, copy_length);
   update_selections(to_pos, 0, copy_length);
 }
 
 /**
- * Remove text according to the undo variables or insert text 
- * from the undo buffer.
+ * Reverse the last edit, or the last run of characters typed or erased
+ * next to each other. Returns 0 if there is nothing to undo. If
+ * "cursorPos" is not NULL it is set to where the cursor should go. Each
+ * buffer keeps its own history, as many steps back as undo_limit()
+ * allows, and anything undone can be done again with redo() until the
+ * text is edited.
  */
 int TextBuffer::undo(int *cursorPos) {
-  if (undowidget != this || (!undocut && !undoinsert &&!mCanUndo)) return 0;
-
-  int ilen = undocut;
-  int xlen = undoinsert;
-  int b = undoat-xlen;
+  return undo_step_(undojournal_, 1, cursorPos);
+}
 
-  if (xlen && undoyankcut && !ilen) {
-    ilen = undoyankcut;
-  }
+/**
+ * Make the edit reversed by the last undo() again. Returns 0 if there is
+ * nothing to redo.
+ */
+int TextBuffer::redo(int *cursorPos) {
+  return undo_step_(redojournal_, 2, cursorPos);
+}
 
-  if (xlen && ilen) {
-    undobuffersize(ilen+1);
-    undobuffer[ilen] = 0;
-    char *tmp = newstring(undobuffer);
-    replace(b, undoat, tmp);
-    if (cursorPos) *cursorPos = cursorposhint_;
-    delete[] tmp;
-  }
-  else if (xlen) {
-    remove(b, undoat);
-    if (cursorPos) *cursorPos = cursorposhint_;
-  }
-  else if (ilen) {
-    undobuffersize(ilen+1);
-    undobuffer[ilen] = 0;
-    insert(undoat, undobuffer);
-    if (cursorPos) *cursorPos = cursorposhint_;
-    undoyankcut = 0;
+/* Reverse the top record of "from" and any joined to it. The edits this
+   makes are recorded in the other journal, as one group. Several records
+   are replayed as a batch, so the callbacks are called once, as they
+   were for the edits being undone. */
+int TextBuffer::undo_step_(TextUndo *from, char mode, int *cursorPos) {
+  if (!mCanUndo || !from || !from->top()) return 0;
+  undoing_ = mode;
+  bool batch = from->top()->joined;
+  if (batch) begin_batch();
+  else begin_undo_group_();
+  for (;;) {
+    UndoRecord *r = from->top();
+    bool joined = r->joined;
+    /* the deleted text can be used where it is as it has a nul after it
+       and nothing is added to this journal while undoing it */
+    char *deleted = TextUndo::text(r);
+    if (r->inserted && r->deleted)
+      replace(r->pos, r->pos + r->inserted, deleted);
+    else if (r->inserted)
+      remove(r->pos, r->pos + r->inserted);
+    else
+      insert(r->pos, deleted);
+    from->pop();
+    if (!joined || !from->top()) break;
   }
-
+  if (batch) end_batch();
+  else end_undo_group_();
+  undoing_ = 0;
+  /* typing after this is a new step */
+  if (undojournal_) undojournal_->closed = true;
+  if (cursorPos) *cursorPos = cursorposhint_;
   return 1;
 }
 
 /**
- * Let the undo system know if we can undo changes.
+ * Let the undo system know if we can undo changes. Turning it off also
+ * throws away the history.
  */
 void TextBuffer::canUndo(char flag) {
   mCanUndo = flag;
+  if (!flag) clear_undo();
+}
+
+/**
+ * Forget all the edits that undo() and redo() could make.
+ */
+void TextBuffer::clear_undo() {
+  delete undojournal_;
+  undojournal_ = 0;
+  delete redojournal_;
+  redojournal_ = 0;
+}
+
+/**
+ * Set the most memory in bytes the undo history may use, the oldest
+ * steps are forgotten to stay under it. Inserting text only uses a few
+ * bytes no matter how much is inserted, but deleting text must keep a
+ * copy of it. The most recent step is always kept even if it is larger
+ * than this. The default is 32 megabytes.
+ */
+void TextBuffer::undo_limit(int bytes) {
+  undolimit_ = bytes;
+  if (undojournal_) undojournal_->limit(bytes);
+  if (redojournal_) redojournal_->limit(bytes);
+}
+
+/* All the edits until the matching end_undo_group_() are undone at
+   once. Groups can nest, only the outermost one counts. */
+void TextBuffer::begin_undo_group_() {
+  if (undogroup_++) return;
+  undogrouped_ = false;
+  TextUndo *journal = undoing_ == 1 ? redojournal_ : undojournal_;
+  if (journal) journal->closed = true;
+}
+
+void TextBuffer::end_undo_group_() {
+  if (--undogroup_) return;
+  TextUndo *journal = undoing_ == 1 ? redojournal_ : undojournal_;
+  if (journal) journal->closed = true;
+}
+
+/* Record that "length" characters were inserted at "pos". Typing joins
+   the record of the typing before it, and anything inserted where text
+   was just deleted joins that, so replacing text is one step. */
+void TextBuffer::record_insert_(int pos, int length) {
+  if (!mCanUndo || !length) return;
+  TextUndo *&journal = undoing_ == 1 ? redojournal_ : undojournal_;
+  if (!journal) journal = new TextUndo;
+  UndoRecord *r = journal->top();
+  bool typed = length <= UNDO_TYPED_LENGTH;
+  if (r && !journal->closed && r->pos + r->inserted == pos &&
+      (!r->inserted || (r->typed && typed))) {
+    r->inserted += length;
+    r->typed = r->typed && typed;
+  } else {
+    r = journal->push(pos, length, 0, undogroup_ && undogrouped_);
+    r->typed = typed;
+    undogrouped_ = true;
+  }
+  if (!undoing_ && redojournal_) redojournal_->clear();
+  journal->limit(undolimit_);
+}
+
+/* Record that the text between "start" and "end" is about to be
+   deleted. Erasing typing shortens its record, and characters erased
+   next to the ones erased before are added to that record. */
+void TextBuffer::record_remove_(int start, int end) {
+  int n = end - start;
+  if (!mCanUndo || !n) return;
+  TextUndo *&journal = undoing_ == 1 ? redojournal_ : undojournal_;
+  if (!journal) journal = new TextUndo;
+  UndoRecord *r = journal->top();
+  bool join = r && !journal->closed && r->typed && n <= UNDO_TYPED_LENGTH;
+  if (join && r->inserted && start >= r->pos && end == r->pos + r->inserted) {
+    r->inserted -= n;
+    if (!r->inserted && !r->deleted) journal->pop();
+  } else if (join && !r->inserted && end == r->pos) {
+    /* backspacing, put the characters before the others */
+    r = journal->grow(n);
+    memmove(TextUndo::text(r) + n, TextUndo::text(r), r->deleted - n);
+    copy_range_(TextUndo::text(r), start, end);
+    r->pos = start;
+  } else if (join && !r->inserted && start == r->pos) {
+    r = journal->grow(n);
+    copy_range_(TextUndo::text(r) + r->deleted - n, start, end);
+  } else {
+    r = journal->push(start, 0, n, undogroup_ && undogrouped_);
+    r->typed = n <= UNDO_TYPED_LENGTH;
+    undogrouped_ = true;
+    copy_range_(TextUndo::text(r), start, end);
+  }
+  if (!undoing_ && redojournal_) redojournal_->clear();
+  journal->limit(undolimit_);
 }
 
 /**
@@ -475,6 +1523,7 @@ void TextBuffer::replace_rectangular(int start, int end, int rectstart,
   end   = line_end(end);
   
   call_predelete_callbacks(start, end-start);
+  begin_undo_group_();
   
   /* If more lines will be deleted than inserted, pad the inserted text
      with newlines to make it as long as the number of deleted lines.  This
@@ -511,6 +1560,7 @@ void TextBuffer::replace_rectangular(int start, int end, int rectstart,
     free(ins_text);
   } else
     insert_column_(rectstart, start, s, &insertdeleted, &insertinserted, &cursorposhint_);
+  end_undo_group_();
   
   /* Figure out how many chars were inserted and call modify callbacks */
   if (insertdeleted != deleteinserted + lines_padded)
@@ -597,6 +1647,8 @@ void TextBuffer::tab_distance(int tabDist) {
     
   /* Change the tab setting */
   tabdist_ = tabDist;
+  delete[] columns_;
+  columns_ = 0;
 
   /* Force any display routines to redisplay everything */
   call_modify_callbacks( 0, length_, length_, 0, text() );
@@ -996,16 +2048,18 @@ int TextBuffer::count_displayed_characters(int linestartpos, int targetpos) {
   return char_count;
 }
 
+/**
+ * Same as count_displayed_characters() but a multi-byte UTF-8 character
+ * counts as one character. On a long line this starts from the closest
+ * position it has already found the column of, so moving around the line
+ * does not count from the start every time.
+ */
 int TextBuffer::count_displayed_characters_utf(int linestartpos, int targetpos) {
-  int pos, char_count = 0;
-  char expandedChar[TEXT_MAX_EXP_CHAR_LEN];
-
-  pos = linestartpos;
-  while (pos < targetpos) {
-    char_count += expand_character(pos, char_count, expandedChar);
-    pos += utf8len(character(pos));
-  }
-  return char_count;
+  int pos = linestartpos, column = 0;
+  scan_columns_(linestartpos, &pos, &column, targetpos, INT_MAX, false);
+  /* character() returns nul beyond the end */
+  if (pos < targetpos) column += 2 * (targetpos - pos);
+  return column;
 }
 
 /**
@@ -1014,33 +2068,103 @@ int TextBuffer::count_displayed_characters_utf(int linestartpos, int targetpos)
  * characters in the buffer, where tabs and control characters are expanded)
  */
 int TextBuffer::skip_displayed_characters(int linestartpos, int nchars) {
-  int pos, char_count = 0;
-  char c;
+  return skip_displayed_characters_utf(linestartpos, nchars);
+}
 
-  pos = linestartpos;
-  while (char_count < nchars && pos < length_) {
-    c = character(pos);
-    if (c == '\n')
-      return pos;
-    char_count += character_width(c, char_count, tabdist_, nullsubschar_);
-    pos += utf8len(c);
-  }
+/**
+ * Same as skip_displayed_characters(). Multi-byte UTF-8 characters are
+ * always skipped as one character.
+ */
+int TextBuffer::skip_displayed_characters_utf(int linestartpos, int nchars) {
+  int pos = linestartpos, column = 0;
+  scan_columns_(linestartpos, &pos, &column, length_, nchars, true);
   return pos;
 }
 
-int TextBuffer::skip_displayed_characters_utf(int linestartpos, int nchars) {
-  int pos, char_count = 0;
-  char c;
+/* Move *pos, which is at displayed column *column of the line starting
+   at linestart, forward a character at a time until it reaches target
+   or the column ncolumns, or a newline if stopatnewline is true. It
+   starts at the closest column mark, and adds marks if the line is
+   long. */
+void TextBuffer::scan_columns_(int linestart, int *pos, int *column,
+                               int target, int ncolumns, bool stopatnewline) {
+  if (target > length_) target = length_;
+  int p = *pos, col = *column;
+
+  /* find the marks for the line, and the closest one */
+  TextColumnIndex *marks = 0;
+  if (columns_) {
+    for (int i = 0; i < COLUMN_MARK_LINES; i++)
+      if (columns_[i].linestart == linestart) marks = &columns_[i];
+  }
+  int nextmark = linestart + COLUMN_MARK_MIN;
+  if (marks) {
+    marks->used = ++columnsused_;
+    int a = 0, b = marks->count;
+    while (a < b) {
+      int m = (a + b) / 2;
+      if (marks->marks[m].pos <= target && marks->marks[m].column < ncolumns)
+        a = m + 1;
+      else
+        b = m;
+    }
+    if (a) {
+      p = marks->marks[a - 1].pos;
+      col = marks->marks[a - 1].column;
+    }
+    if (a < marks->count) nextmark = INT_MAX; /* no new marks needed */
+    else if (a) nextmark = p + COLUMN_MARK_SPACING;
+  }
 
-  pos = linestartpos;
-  while (char_count < nchars && pos < length_) {
-    c = character(pos);
-    if (c == '\n')
-      return pos;
-    char_count += character_width(c, char_count, tabdist_, nullsubschar_);
-    pos += utf8len(c);
+  const char *c = 0;
+  int chunkstart = 0, chunklength = 0;
+  while (p < target && col < ncolumns) {
+    if (p >= nextmark) {
+      if (!marks) {
+        /* the line is long, start marking it instead of the least
+           recently used line */
+        if (!columns_) {
+          columns_ = new TextColumnIndex[COLUMN_MARK_LINES];
+          columnsused_ = 0;
+        }
+        marks = &columns_[0];
+        for (int i = 1; i < COLUMN_MARK_LINES; i++)
+          if (columns_[i].used < marks->used) marks = &columns_[i];
+        marks->linestart = linestart;
+        marks->count = 0;
+        marks->used = ++columnsused_;
+      }
+      marks->add(p, col);
+      nextmark = p + COLUMN_MARK_SPACING;
+    }
+    if (!c || p >= chunkstart + chunklength)
+      c = chunk(p, &chunkstart, &chunklength);
+    const char *q = c + (p - chunkstart);
+    int end = chunkstart + chunklength;
+    if (end > target) end = target;
+    if (end > nextmark) end = nextmark;
+
+    /* printable ASCII is one column per byte, so do 4 bytes at once */
+    while (end - p >= 4 && ncolumns - col >= 4) {
+      unsigned w;
+      memcpy(&w, q, 4);
+      if (not_plain(w)) break;
+      p += 4;
+      q += 4;
+      col += 4;
+    }
+    if (p >= end || col >= ncolumns) continue;
+
+    char ch = *q;
+    if (ch == '\n') {
+      if (stopatnewline) break;
+      nextmark = INT_MAX; /* marks are only for the one line */
+    }
+    col += character_width(ch, col, tabdist_, nullsubschar_);
+    p += utf8len(ch);
   }
-  return pos;
+  *pos = p;
+  *column = col;
 }
 
 /**
@@ -1048,21 +2172,23 @@ int TextBuffer::skip_displayed_characters_utf(int linestartpos, int nchars) {
  * The character at position "endpos" is not counted.
  */
 int TextBuffer::count_lines(int startpos, int endpos) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int i, n, pos, chunkstart, chunklength;
   int line_count = 0;
+  const char *c;
+
+  if (endpos > length_) endpos = length_;
+  if (startpos < 0) startpos = 0;
+  if (endpos - startpos > LINE_INDEX_SCAN)
+    return position_to_line(endpos) - position_to_line(startpos);
 
   pos = startpos;
-  while (pos < gapstart_) {
-    if (pos == endpos)
-      return line_count;
-    if (buf_[pos++] == '\n')
-      line_count++;
-  }
-  while (pos < length_) {
-    if (pos == endpos)
-      return line_count;
-    if (buf_[pos++ + gaplen] == '\n')
-      line_count++;
+  while (pos < endpos) {
+    c = chunk(pos, &chunkstart, &chunklength);
+    n = min(endpos, chunkstart + chunklength) - chunkstart;
+    for (i = pos - chunkstart; i < n; i++)
+      if (c[i] == '\n')
+        line_count++;
+    pos = chunkstart + chunklength;
   }
   return line_count;
 }
@@ -1072,28 +2198,29 @@ int TextBuffer::count_lines(int startpos, int endpos) {
  * in "buf" and return its position
  */
 int TextBuffer::skip_lines(int startpos, int nlines) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int i, n, pos, chunkstart, chunklength;
   int line_count = 0;
+  const char *c;
 
   if (nlines == 0)
     return startpos;
 
+  /* Scan nearby text, then use the line index if the lines are long */
   pos = startpos;
-  while (pos < gapstart_) {
-    if (buf_[pos++] == '\n') {
-      line_count++;
-      if (line_count == nlines)
-        return pos;
-    }
-  }
   while (pos < length_) {
-    if (buf_[pos++ + gaplen] == '\n') {
-      line_count++;
-      if (line_count >= nlines)
-        return pos;
+    if (pos - startpos >= LINE_INDEX_SCAN)
+      return line_to_position(position_to_line(pos) + nlines - line_count);
+    c = chunk(pos, &chunkstart, &chunklength);
+    n = min(chunklength, pos - chunkstart + LINE_INDEX_SCAN);
+    for (i = pos - chunkstart; i < n; i++) {
+      if (c[i] == '\n') {
+        if (++line_count >= nlines)
+          return chunkstart + i + 1;
+      }
     }
+    pos = chunkstart + n;
   }
-  return pos;
+  return length_;
 }
 
 /**
@@ -1103,89 +2230,288 @@ int TextBuffer::skip_lines(int startpos, int nlines) {
  * the line
  */
 int TextBuffer::rewind_lines( int startpos, int nlines ) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int i, n, pos, chunkstart, chunklength;
   int line_count = -1;
+  const char *c;
 
   pos = startpos - 1;
   if ( pos <= 0 )
     return 0;
+  if (pos >= length_)
+    pos = length_ - 1;
 
-  while (pos >= gapstart_) {
-    if (buf_[pos + gaplen] == '\n') {
-      if (++line_count >= nlines)
-        return pos + 1;
+  /* Scan nearby text, then use the line index if the lines are long */
+  while (pos >= 0) {
+    if (startpos - pos > LINE_INDEX_SCAN)
+      return line_to_position(position_to_line(pos + 1) + line_count + 1 - nlines);
+    c = chunk(pos, &chunkstart, &chunklength);
+    n = max(0, pos - chunkstart - LINE_INDEX_SCAN);
+    for (i = pos - chunkstart; i >= n; i--) {
+      if (c[i] == '\n') {
+        if (++line_count >= nlines)
+          return chunkstart + i + 1;
+      }
     }
-    pos--;
+    pos = chunkstart + n - 1;
+  }
+  return 0;
+}
+
+/**
+ * Return the number of newlines before position "pos", which is the
+ * line number of "pos" if the first line is line 0.  This uses an
+ * index of where the newlines are, so it is fast even for very large
+ * buffers. The index is built the first time it is needed and then
+ * updated as the buffer is edited.
+ */
+int TextBuffer::position_to_line(int pos) {
+  if (pos <= 0) return 0;
+  if (pos > length_) pos = length_;
+  if (pieces_) return pieces_->newlines_before(pos);
+  int size = length_ + gapend_ - gapstart_;
+  if (!lineindex_)
+    lineindex_ = new TextLineIndex(buf_, size, gapstart_, gapend_);
+  return lineindex_->newlines_before(buf_, size, gapstart_, gapend_,
+                                     pos < gapstart_ ? pos : pos + gapend_ - gapstart_);
+}
+
+/**
+ * Return the position of the first character of line number "line",
+ * where the first line is line 0.  If there are not that many lines
+ * this returns length().  This is the reverse of position_to_line()
+ * and uses the same index.
+ */
+int TextBuffer::line_to_position(int line) {
+  if (line <= 0) return 0;
+  int pos;
+  if (pieces_) {
+    pos = pieces_->line_position(line);
+  } else {
+    int size = length_ + gapend_ - gapstart_;
+    if (!lineindex_)
+      lineindex_ = new TextLineIndex(buf_, size, gapstart_, gapend_);
+    pos = lineindex_->find(buf_, size, gapstart_, gapend_, line);
+    if (pos > gapstart_) pos -= gapend_ - gapstart_;
+  }
+  return pos < 0 ? length_ : pos;
+}
+
+////////////////////////////////////////////////////////////////
+// Searching
+
+/* Searches work directly on the contiguous chunks of the buffer
+   returned by chunk().  Strings are found with the Boyer-Moore-Horspool
+   algorithm, which usually skips over most of the text without looking
+   at it.  Short case-sensitive strings are found by using memchr() to
+   find the first character, as the C library has a vectorized one.
+   Matches that cross from one chunk to the next are found by copying
+   the few characters around the join to a small window. */
+
+/* Table to fold a character to upper case, made the first time it is
+   needed */
+static const unsigned char *upper_table() {
+  static unsigned char table[256];
+  static bool made;
+  if (!made) {
+    for (int i = 0; i < 256; i++) table[i] = (unsigned char)toupper(i);
+    made = true;
+  }
+  return table;
+}
+
+TextSearch::TextSearch(const char *s, bool matchcase, bool backward) {
+  int i;
+  length_ = strlen(s);
+  fold_ = matchcase ? 0 : upper_table();
+  pattern_ = (unsigned char *)malloc(3 * length_ + 1);
+  window = (char *)pattern_ + length_ + 1;
+  for (i = 0; i <= length_; i++)
+    pattern_[i] = fold_ ? fold_[(unsigned char)s[i]] : s[i];
+
+  /* For each character, how far the window can move if that is the
+     character under the last position in the window (or the first when
+     searching backward) */
+  for (i = 0; i < 256; i++) skip_[i] = length_;
+  if (backward) {
+    for (i = length_ - 1; i > 0; i--) skip_[pattern_[i]] = i;
+  } else {
+    for (i = 0; i < length_ - 1; i++) skip_[pattern_[i]] = length_ - 1 - i;
   }
+  if (fold_) {
+    for (i = 0; i < 256; i++) skip_[i] = skip_[fold_[i]];
+  }
+}
+
+/* Return the first match that starts between text+first and text+last,
+   or -1.  The text must extend length()-1 characters past last. */
+int TextSearch::find(const char *text, int first, int last) const {
+  const unsigned char *t = (const unsigned char *)text;
+  int w, i, m = length_;
+
+  if (!fold_ && m < 4) {
+    for (w = first; w <= last; w++) {
+      const unsigned char *p =
+        (const unsigned char *)memchr(t + w, pattern_[0], last - w + 1);
+      if (!p) return -1;
+      w = p - t;
+      if (!memcmp(p + 1, pattern_ + 1, m - 1)) return w;
+    }
+    return -1;
+  }
+
+  for (w = first; w <= last; w += skip_[t[w + m - 1]]) {
+    if (fold_) {
+      for (i = m - 1; fold_[t[w + i]] == pattern_[i]; i--)
+        if (!i) return w;
+    } else {
+      for (i = m - 1; t[w + i] == pattern_[i]; i--)
+        if (!i) return w;
+    }
+  }
+  return -1;
+}
+
+/* Return the last match that starts between text+first and text+last,
+   or -1.  The text must extend length()-1 characters past last. */
+int TextSearch::rfind(const char *text, int first, int last) const {
+  const unsigned char *t = (const unsigned char *)text;
+  int w, i, m = length_;
+
+  for (w = last; w >= first; w -= skip_[t[w]]) {
+    if (fold_) {
+      for (i = 0; fold_[t[w + i]] == pattern_[i]; i++)
+        if (i == m - 1) return w;
+    } else {
+      for (i = 0; t[w + i] == pattern_[i]; i++)
+        if (i == m - 1) return w;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Return the position of the first match of "search" that starts at or
+ * after "startpos" and ends at or before "endpos", or -1.
+ */
+int TextBuffer::search_forward_(int startpos, int endpos, TextSearch *search) {
+  int w, pos, chunkstart, chunklength, chunkend, first, last;
+  const char *c;
+  int m = search->length();
+
+  if (endpos > length_) endpos = length_;
+  pos = startpos < 0 ? 0 : startpos;
+  while (pos + m <= endpos) {
+    c = chunk(pos, &chunkstart, &chunklength);
+    chunkend = min(chunkstart + chunklength, endpos);
+    /* matches entirely inside this chunk */
+    last = chunkend - m;
+    if (last >= pos) {
+      w = search->find(c, pos - chunkstart, last - chunkstart);
+      if (w >= 0) return chunkstart + w;
+    }
+    /* matches that continue into the next chunk */
+    if (m > 1 && chunkend < endpos) {
+      first = max(pos, chunkend - m + 1);
+      last = min(chunkend, endpos - m + 1) - 1;
+      if (last >= first) {
+        copy_range_(search->window, first, last + m);
+        w = search->find(search->window, 0, last - first);
+        if (w >= 0) return first + w;
+      }
+    }
+    pos = chunkend;
+  }
+  return -1;
+}
+
+/**
+ * Return the position of the last match of "search" that ends at or
+ * before "endpos", or -1.
+ */
+int TextBuffer::search_backward_(int endpos, TextSearch *search) {
+  int w, pos, chunkstart, chunklength, first, last;
+  const char *c;
+  int m = search->length();
+
+  if (endpos > length_) endpos = length_;
+  pos = endpos - 1;
   while (pos >= 0) {
-    if (buf_[pos] == '\n') {
-      if (++line_count >= nlines)
-        return pos + 1;
+    c = chunk(pos, &chunkstart, &chunklength);
+    /* matches entirely inside this chunk */
+    last = min(chunkstart + chunklength, endpos) - m;
+    if (last >= chunkstart) {
+      w = search->rfind(c, 0, last - chunkstart);
+      if (w >= 0) return chunkstart + w;
     }
-    pos--;
+    /* matches that start in the previous chunk */
+    if (m > 1 && chunkstart > 0) {
+      first = max(0, chunkstart - m + 1);
+      last = min(chunkstart - 1, endpos - m);
+      if (last >= first) {
+        copy_range_(search->window, first, last + m);
+        w = search->rfind(search->window, 0, last - first);
+        if (w >= 0) return first + w;
+      }
+    }
+    pos = chunkstart - 1;
   }
-  return 0;
+  return -1;
 }
 
 /**
- * Search forwards in buffer for string "searchString", starting with the
- * character "startpos", and returning the result in "foundPos"
- * returns 1 if found, 0 if not.
+ * Search forwards in buffer for any of the characters in "searchChars",
+ * starting with the character "startpos", and returning the result in
+ * "foundPos". Returns true if found, false if not.
  */
 bool TextBuffer::findchars_forward(int startpos, const char *searchChars, int *foundPos)
 {
-  int pos, gaplen = gapend_ - gapstart_;
+  int i, pos, chunkstart, chunklength;
   const char *c;
+  bool table[256];
   
   if (!searchChars) {
     *foundPos = 0;
     return false;
   }
-  
-  pos = startpos;
-  while (pos < gapstart_) {
-    for (c=searchChars; *c!='\0'; c++) {
-	    if (buf_[pos]==*c) {
-        *foundPos = pos;
-        return true;
-      }
-    }
-    pos++;
-  }
+  if (searchChars[0] && !searchChars[1])
+    return findchar_forward(startpos, searchChars[0], foundPos);
+
+  memset(table, 0, sizeof(table));
+  for (c = searchChars; *c; c++) table[(unsigned char)*c] = true;
+
+  pos = startpos < 0 ? 0 : startpos;
   while (pos < length_) {
-    for (c=searchChars; *c!='\0'; c++) {
-    	if (buf_[pos + gaplen]==*c) {
-        *foundPos = pos;
+    c = chunk(pos, &chunkstart, &chunklength);
+    for (i = pos - chunkstart; i < chunklength; i++) {
+      if (table[(unsigned char)c[i]]) {
+        *foundPos = chunkstart + i;
         return true;
       }
     }
-    pos++;
+    pos = chunkstart + chunklength;
   }
   *foundPos = length_;
   return false;
 }
 
+/**
+ * Search forwards in buffer for string "searchString", starting with the
+ * character "startpos", and returning the result in "foundPos".
+ * Returns true if found, false if not.
+ */
 bool TextBuffer::search_forward(int startpos, const char *searchString,
                                int *foundPos, bool matchCase)
 { 
-  if (!searchString) return 0;
-  int bp;
-  const char *sp;
-  while (startpos < length_)
-  {
-    bp = startpos;
-    sp = searchString;
-    do {
-       if (!*sp) { 
-        *foundPos = startpos; 
-        return true; 
-       }
-    } while ((matchCase ? character(bp++) == *sp++ :
-             toupper(character(bp++)) == toupper(*sp++))
-             && bp <= length_);
-    startpos++;
+  if (!searchString || startpos >= length_) return false;
+  if (!*searchString) {
+    *foundPos = startpos;
+    return true;
   }
-  return 0;
+  TextSearch search(searchString, matchCase, false);
+  int pos = search_forward_(startpos, length_, &search);
+  if (pos < 0) return false;
+  *foundPos = pos;
+  return true;
 }
 
 /**
@@ -1195,59 +2521,110 @@ bool TextBuffer::search_forward(int startpos, const char *searchString,
  */
 bool TextBuffer::findchars_backward(int startpos, const char *searchChars, int *foundPos)
 {
-  int pos, gapLen = gapend_ - gapstart_;
+  int i, pos, chunkstart, chunklength;
   const char *c;
+  bool table[256];
   
-  if (startpos == 0) {
+  if (startpos <= 0 || !searchChars) {
     *foundPos = 0;
     return false;
   }
 
-  pos = startpos == 0 ? 0 : startpos - 1;
-  while (pos >= gapstart_) {
-    for (c=searchChars; *c!='\0'; c++) {
-      if (buf_[pos + gapLen] == *c) {
-        *foundPos = pos;
-        return true;
-      }
-    }
-    pos--;
-  }
+  memset(table, 0, sizeof(table));
+  for (c = searchChars; *c; c++) table[(unsigned char)*c] = true;
+
+  pos = startpos > length_ ? length_ - 1 : startpos - 1;
   while (pos >= 0) {
-    for (c=searchChars; *c!='\0'; c++) {
-      if (buf_[pos] == *c) {
-        *foundPos = pos;
+    c = chunk(pos, &chunkstart, &chunklength);
+    for (i = pos - chunkstart; i >= 0; i--) {
+      if (table[(unsigned char)c[i]]) {
+        *foundPos = chunkstart + i;
         return true;
       }
     }
-    pos--;
+    pos = chunkstart - 1;
   }
   *foundPos = 0;
   return false;
 }
 
+/**
+ * Search backwards in buffer for string "searchString", for a match
+ * that ends at or before "startpos", and return the position it starts
+ * at in "foundPos". Returns true if found, false if not.
+ */
 bool TextBuffer::search_backward(int startpos, const char *searchString,
                                  int *foundPos, bool matchCase)
 {
-  if (!searchString) return 0;
-  int bp;
-  int searchStringLen = strlen(searchString);
-  const char *sp;
-  while (startpos > 0)
-  {
-    bp = startpos-1;
-    sp = searchString+searchStringLen-1;
-    do {
-      if (sp < searchString) { 
-        *foundPos = bp+1; 
-        return true; 
-      }
-    } while ((matchCase ? character(bp--) == *sp-- :
-             toupper(character(bp--)) == toupper(*sp--))
-             && bp >= 0);
-    startpos--;
+  if (!searchString || startpos <= 0) return false;
+  if (!*searchString) {
+    *foundPos = min(startpos, length_);
+    return true;
   }
-  return false;
+  TextSearch search(searchString, matchCase, true);
+  int pos = search_backward_(startpos, &search);
+  if (pos < 0) return false;
+  *foundPos = pos;
+  return true;
+}
+
+/**
+ * Find every match of "searchString" that is entirely between "startpos"
+ * and "endpos" (pass -1 for the end of the buffer). Matches do not
+ * overlap. Returns how many were found, and sets "foundPositions" to a
+ * malloc'd array of the position of each, which the caller must free(),
+ * or to NULL if none were found.
+ */
+int TextBuffer::search_all(int startpos, int endpos, const char *searchString,
+                           int **foundPositions, bool matchCase)
+{
+  int n = 0, size = 0;
+  int *positions = 0;
+  *foundPositions = 0;
+  if (!searchString || !*searchString) return 0;
+  if (endpos < 0 || endpos > length_) endpos = length_;
+  TextSearch search(searchString, matchCase, false);
+  for (int pos = startpos;
+       (pos = search_forward_(pos, endpos, &search)) >= 0;
+       pos += search.length()) {
+    if (n >= size) {
+      size = size ? 2 * size : 64;
+      positions = (int *)realloc(positions, size * sizeof(int));
+    }
+    positions[n++] = pos;
+  }
+  *foundPositions = positions;
+  return n;
+}
+
+/**
+ * Replace every occurrence of "searchString" between "startPos" and
+ * "endPos" (pass -1 for the end of the buffer) with "replaceString",
+ * and return how many were replaced.
+ * This is done as one batch (see begin_batch()), so a display is only
+ * updated once and one undo() puts them all back.
+ */
+int TextBuffer::replace_all(int startPos, int endPos, const char *searchString,
+                            const char *replaceString, bool matchCase) {
+  if (!searchString || !*searchString) return 0;
+  if (!replaceString) replaceString = "";
+  if (startPos < 0) startPos = 0;
+  if (endPos < 0 || endPos > length_) endPos = length_;
+  TextSearch search(searchString, matchCase, false);
+  int searchlength = search.length();
+  int replacelength = strlen(replaceString);
+  int n = 0;
+  begin_batch();
+  for (int pos = startPos;;) {
+    pos = search_forward_(pos, endPos, &search);
+    if (pos < 0) break;
+    replace(pos, pos + searchlength, replaceString);
+    pos += replacelength;
+    endPos += replacelength - searchlength;
+    n++;
+  }
+  end_batch();
+  return n;
 }
 
 /**
@@ -1260,33 +2637,28 @@ bool TextBuffer::search_backward(int startpos, const char *searchString,
 int TextBuffer::insert_(int pos, const char *s) {
   int insertedLength = strlen(s);
 
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-     the current buffer, just move the gap (if necessary) to where
-     the text should be inserted.  If the new text is too large, reallocate
-     the buffer with a gap large enough to accomodate the new text and a
-     gap of PREFERRED_GAP_SIZE */
-  if (insertedLength > gapend_ - gapstart_)
-    reallocate_with_gap(pos, insertedLength + PREFERRED_GAP_SIZE);
-  else if (pos != gapstart_)
-    move_gap(pos);
-
-  /* Insert the new text (pos now corresponds to the start of the gap) */
-  memcpy(&buf_[pos], s, insertedLength);
-  gapstart_ += insertedLength;
+  if (pieces_) {
+    pieces_->insert(pos, s, insertedLength);
+  } else {
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+       the current buffer, just move the gap (if necessary) to where
+       the text should be inserted.  If the new text is too large, reallocate
+       the buffer with a gap large enough to accomodate the new text and a
+       gap of PREFERRED_GAP_SIZE */
+    if (insertedLength > gapend_ - gapstart_)
+      reallocate_with_gap(pos, insertedLength + PREFERRED_GAP_SIZE);
+    else if (pos != gapstart_)
+      move_gap(pos);
+
+    /* Insert the new text (pos now corresponds to the start of the gap) */
+    memcpy(&buf_[pos], s, insertedLength);
+    gapstart_ += insertedLength;
+    update_line_index_(pos, gapstart_, 1);
+  }
   length_ += insertedLength;
   update_selections(pos, 0, insertedLength);
 
-  if (mCanUndo) {
-    if (undowidget==this && undoat==pos && undoinsert) {
-      undoinsert += insertedLength;
-    } else {
-      undoinsert = insertedLength;
-      undoyankcut = (undoat==pos) ? undocut : 0 ;
-    }
-    undoat = pos+insertedLength;
-    undocut = 0;
-    undowidget = this;
-  }
+  record_insert_(pos, insertedLength);
 
   return insertedLength;
 }
@@ -1297,43 +2669,24 @@ int TextBuffer::insert_(int pos, const char *s) {
  * the delete).
  */
 void TextBuffer::remove_(int start, int end) {
-  
-  if (mCanUndo) {
-    if (undowidget==this && undoat==end && undocut) {
-      undobuffersize(undocut+end-start+1);
-      memmove(undobuffer+end-start, undobuffer, undocut);
-      undocut += end-start;
-    } else {
-      undocut = end-start;
-      undobuffersize(undocut);
-    }
-    undoat = start;
-    undoinsert = 0;
-    undoyankcut = 0;
-    undowidget = this;
-  }
+  record_remove_(start, end);
 
-  /* if the gap is not contiguous to the area to remove, move it there */
-  if (start > gapstart_) {
-    if (mCanUndo)
-      memcpy(undobuffer, buf_+(gapend_-gapstart_)+start, end-start);
-    move_gap(start);
-  }
-  else if (end < gapstart_) {
-    if (mCanUndo)
-      memcpy(undobuffer, buf_+start, end-start);
-    move_gap(end);
-  }
-  else if (mCanUndo) {
-    int prelen = gapstart_ - start;
-    memcpy(undobuffer, buf_+start, prelen);
-    memcpy(undobuffer+prelen, buf_+gapend_, end-start-prelen);
+  if (pieces_) {
+    pieces_->remove(start, end);
+  } else {
+    /* if the gap is not contiguous to the area to remove, move it there */
+    if (start > gapstart_)
+      move_gap(start);
+    else if (end < gapstart_)
+      move_gap(end);
+
+    /* expand the gap to encompass the deleted characters */
+    update_line_index_(start, gapstart_, -1);
+    update_line_index_(gapend_, gapend_ + end - gapstart_, -1);
+    gapend_ += end - gapstart_;
+    gapstart_ -= gapstart_ - start;
   }
 
-  /* expand the gap to encompass the deleted characters */
-  gapend_ += end - gapstart_;
-  gapstart_ -= gapstart_ - start;
-
   /* update the length */
   length_ -= end - start;
 
@@ -1825,7 +3178,6 @@ void TextBuffer::remove_selection_(TextSelection *sel) {
     remove_rectangular(start, end, rectstart, rectend);
   else {
     remove(start, end);
-    //undoyankcut = undocut;
   }
 }
 
@@ -1884,6 +3236,14 @@ void TextBuffer::call_modify_callbacks(int pos, int ndeleted,
                                        int ninserted, int nRestyled, const char *deleted_text) {
   int i;
 
+  if (batchdepth_) {
+    if (pos || ndeleted || ninserted || nRestyled)
+      batch_change_(pos, ndeleted, ninserted, nRestyled, deleted_text);
+    else
+      batchnotify_ = true;
+    return;
+  }
+
   for (i = 0; i < nmodifyprocs_; i++)
     (*modifyprocs_[i])(pos, ninserted, ndeleted, nRestyled, deleted_text, modifycbargs_[i]);
 }
@@ -1895,10 +3255,220 @@ void TextBuffer::call_modify_callbacks(int pos, int ndeleted,
 void TextBuffer::call_predelete_callbacks(int pos, int ndeleted) {
     int i;
     
+    if (batchdepth_) return;
     for (i=0; i<npredeleteprocs_; i++)
     	(*predeleteprocs_[i])(pos, ndeleted, prepeletecbargs_[i]);
 }
 
+/**
+ * Start a batch of edits. Until the matching end_batch() the modify
+ * callbacks are not called for each change, instead end_batch() calls
+ * them once with a single range covering every change and the text that
+ * range held before the batch, so a display only has to lay itself out
+ * once. The predelete callbacks are not called for edits in a batch.
+ * Batches can nest, only the outermost one counts. All the edits in a
+ * batch are undone by one undo().
+ */
+void TextBuffer::begin_batch() {
+  if (!batchdepth_++) {
+    batchstart_ = -1;
+    batchchanged_ = batchnotify_ = false;
+  }
+  begin_undo_group_();
+}
+
+/**
+ * End a batch of edits started by begin_batch(), and call the modify
+ * callbacks for all of them.
+ */
+void TextBuffer::end_batch() {
+  if (!batchdepth_) return;
+  end_undo_group_();
+  if (--batchdepth_) return;
+  if (batchstart_ < 0) {
+    if (batchnotify_) call_modify_callbacks();
+    return;
+  }
+  /* reset before calling, in case a callback starts another batch */
+  int start = batchstart_, end = batchend_;
+  char *deleted = batchdeleted_;
+  int ndeleted = batchdeletedlength_;
+  batchstart_ = -1;
+  batchdeleted_ = 0;
+  batchdeletedsize_ = 0;
+  if (batchchanged_)
+    call_modify_callbacks(start, ndeleted, end - start, 0, deleted);
+  else
+    call_modify_callbacks(start, 0, 0, end - start, NULL);
+  free(deleted);
+}
+
+/* Add a change to the range end_batch() will report. Text outside the
+   range has not changed since the batch started, so when the range
+   grows its old text can be copied from the buffer, or from deletedText
+   for the part this change removed. */
+void TextBuffer::batch_change_(int pos, int ndeleted, int ninserted,
+                               int nrestyled, const char *deletedText) {
+  if (ndeleted || ninserted) batchchanged_ = true;
+  int span = ndeleted ? ndeleted : nrestyled;
+  int start = batchstart_, end = batchend_;
+  if (start < 0) {
+    start = end = pos;
+    batchdeletedlength_ = 0;
+  }
+  /* the new range, in positions from before this change */
+  int newstart = min(start, pos);
+  int newend = max(end, pos + span);
+  int left = start - newstart;
+  int n = batchdeletedlength_ + left + newend - end;
+  if (n >= batchdeletedsize_) {
+    batchdeletedsize_ = max(2 * batchdeletedsize_, n + 1);
+    batchdeleted_ = (char *)realloc(batchdeleted_, batchdeletedsize_);
+  }
+  memmove(batchdeleted_ + left, batchdeleted_, batchdeletedlength_);
+
+  /* copy the old text on the left of the range, then on the right */
+  char *to = batchdeleted_;
+  int a = newstart, b = start;
+  for (int side = 0; side < 2; side++) {
+    int x = min(b, pos);
+    if (a < x) {
+      copy_range_(to, a, x);
+      to += x - a;
+      a = x;
+    }
+    x = min(b, pos + ndeleted);
+    if (a < x) {
+      memcpy(to, deletedText + a - pos, x - a);
+      to += x - a;
+      a = x;
+    }
+    if (a < b) copy_range_(to, a + ninserted - ndeleted, b + ninserted - ndeleted);
+    to = batchdeleted_ + left + batchdeletedlength_;
+    a = end;
+    b = newend;
+  }
+
+  batchdeletedlength_ = n;
+  batchdeleted_[n] = 0;
+  batchstart_ = newstart;
+  batchend_ = newend + ninserted - ndeleted;
+}
+
+/**
+ * Add text to the end of the buffer, for a log or console that is written
+ * to many times a second. The text is collected and added to the buffer
+ * by flush_appends(), which is called once each time through the event
+ * loop before the display is redrawn, so the modify callbacks are called
+ * once for all the text appended since the last redraw rather than for
+ * every call. Until then length() and everything else do not include the
+ * appended text.
+ *
+ * After the text is added, whole lines are removed from the start of the
+ * buffer to keep it within max_bytes() and max_lines(). This is cheapest
+ * with storage(PIECE_TABLE), which frees the memory of the removed text
+ * without moving the rest of it. Removing lines throws away the undo
+ * history rather than keeping a copy of them in it.
+ *
+ * \a length is the number of bytes of \a text to add, or -1 to add all
+ * of it up to the nul.
+ */
+void TextBuffer::append_lines(const char *text, int length) {
+  if (length < 0) length = strlen(text);
+  else {
+    /* a text buffer cannot hold nul characters */
+    const char *nul = (const char *)memchr(text, 0, length);
+    if (nul) length = nul - text;
+  }
+  if (!length) return;
+  int n = appendedlength_ + length;
+  if (n >= appendedsize_) {
+    appendedsize_ = max(2 * appendedsize_, n + 1);
+    appended_ = (char *)realloc(appended_, appendedsize_);
+  }
+  memcpy(appended_ + appendedlength_, text, length);
+  appendedlength_ = n;
+  /* if the event loop is not keeping up, drop the lines that would be
+     removed anyway as soon as they were added */
+  if (maxbytes_ > 0 && n > maxbytes_ + maxbytes_ / 2) {
+    const char *p = (const char *)memchr(appended_ + n - maxbytes_ - 1, '\n',
+                                         maxbytes_ + 1);
+    int drop = p ? p + 1 - appended_ : n;
+    appendedlength_ = n - drop;
+    memmove(appended_, appended_ + drop, appendedlength_);
+  }
+  if (!has_check(flush_appends_cb, this)) add_check(flush_appends_cb, this);
+}
+
+/**
+ * Add the text given to append_lines() to the buffer now, and remove
+ * lines from the start to keep it within max_bytes() and max_lines().
+ * This calls the modify callbacks at most twice, once for the text added
+ * to the end and once for the text removed from the start. It is called
+ * automatically by the event loop, call it directly to see the text
+ * immediately or if the event loop is not running.
+ */
+void TextBuffer::flush_appends() {
+  remove_check(flush_appends_cb, this);
+  if (appendedlength_) {
+    appended_[appendedlength_] = 0;
+    appendedlength_ = 0;
+    insert(length_, appended_);
+  }
+  trim_();
+}
+
+void TextBuffer::flush_appends_cb(void *v) {
+  ((TextBuffer *)v)->flush_appends();
+}
+
+/**
+ * Limit the text to \a bytes, by removing whole lines from the start
+ * after append_lines() adds to the end. Zero, the default, is no limit.
+ * The buffer is trimmed to the new limit immediately.
+ */
+void TextBuffer::max_bytes(int bytes) {
+  maxbytes_ = bytes;
+  trim_();
+}
+
+/**
+ * Limit the text to \a lines lines, by removing lines from the start
+ * after append_lines() adds to the end. A partial last line counts as a
+ * line. Zero, the default, is no limit. The buffer is trimmed to the new
+ * limit immediately.
+ */
+void TextBuffer::max_lines(int lines) {
+  maxlines_ = lines;
+  trim_();
+}
+
+/* Remove whole lines from the start to fit max_bytes() and max_lines() */
+void TextBuffer::trim_() {
+  int start = 0;
+  if (maxlines_ > 0) {
+    int lines = count_lines(0, length_);
+    if (length_ && character(length_ - 1) != '\n') lines++;
+    if (lines > maxlines_) start = line_to_position(lines - maxlines_);
+  }
+  if (maxbytes_ > 0 && length_ - start > maxbytes_) {
+    start = length_ - maxbytes_;
+    if (character(start - 1) != '\n') {
+      if (findchar_forward(start, '\n', &start)) start++;
+      else start = length_;
+    }
+  }
+  if (start > 0) {
+    /* keeping a copy of the removed lines to undo would fill the journal
+       with text nobody edited, so the history is thrown away instead */
+    clear_undo();
+    char flag = mCanUndo;
+    mCanUndo = 0;
+    remove(0, start);
+    mCanUndo = flag;
+  }
+}
+
 /**
  * Call the stored redisplay procedure(s) for this buffer to update the
  * screen for a change in a selection.
@@ -1968,14 +3538,27 @@ void TextBuffer::redisplay_selection(TextSelection *old_selection,
 void TextBuffer::move_gap(int pos) {
   int gaplen = gapend_ - gapstart_;
 
-  if (pos > gapstart_)
+  if (pos > gapstart_) {
+    update_line_index_(gapend_, pos + gaplen, -1);
     memmove(&buf_[gapstart_], &buf_[gapend_], pos - gapstart_);
-  else
+    update_line_index_(gapstart_, pos, 1);
+  } else {
+    update_line_index_(pos, gapstart_, -1);
     memmove(&buf_[pos + gaplen], &buf_[pos], gapstart_ - pos);
+    update_line_index_(pos + gaplen, gapend_, 1);
+  }
   gapend_ += pos - gapstart_;
   gapstart_ += pos - gapstart_;
 }
 
+/**
+ * Tell the line index that text was put in the memory between "from"
+ * and "to" (sign is 1), or is about to be removed from it (sign is -1).
+ */
+void TextBuffer::update_line_index_(int from, int to, int sign) {
+  if (lineindex_) lineindex_->update(buf_, from, to, sign);
+}
+
 /**
  * reallocate the text storage in "buf" to have a gap starting at "newGapStart"
  * and a gap size of "newGapLen", preserving the buffer's current contents.
@@ -1999,6 +3582,8 @@ void TextBuffer::reallocate_with_gap(int newGapStart, int newGapLen) {
   buf_ = newBuf;
   gapstart_ = newGapStart;
   gapend_ = newGapEnd;
+  delete lineindex_;
+  lineindex_ = 0;
 #ifdef PURIFY
   { int i; for ( i = gapstart_; i < gapend_; i++ ) buf_[i] = '.'; }
 #endif
@@ -2011,6 +3596,10 @@ void TextBuffer::update_selections(int pos, int ndeleted, int ninserted) {
   primary_.update(pos, ndeleted, ninserted);
   secondary_.update(pos, ndeleted, ninserted);
   highlight_.update(pos, ndeleted, ninserted);
+  /* the column marks move the same way */
+  if (columns_)
+    for (int i = 0; i < COLUMN_MARK_LINES; i++)
+      columns_[i].changed(pos, ndeleted, ninserted);
 }
 
 /**
@@ -2022,7 +3611,8 @@ void TextBuffer::update_selections(int pos, int ndeleted, int ninserted) {
  * count lines quickly, hence searching for a single character: newline)
  */
 bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int pos, chunkstart, chunklength;
+  const char *c, *p;
 
   if (startpos < 0 || startpos >= length_) {
     *foundPos = length_;
@@ -2030,19 +3620,15 @@ bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos)
   }
 
   pos = startpos;
-  while (pos < gapstart_) {
-    if (buf_[pos] == searchChar) {
-      *foundPos = pos;
-      return true;
-    }
-    pos++;
-  }
   while (pos < length_) {
-    if (buf_[pos + gaplen] == searchChar) {
-      *foundPos = pos;
+    c = chunk(pos, &chunkstart, &chunklength);
+    p = (const char *)memchr(c + pos - chunkstart, searchChar,
+                             chunkstart + chunklength - pos);
+    if (p) {
+      *foundPos = chunkstart + (p - c);
       return true;
     }
-    pos++;
+    pos = chunkstart + chunklength;
   }
   *foundPos = length_;
   return false;
@@ -2057,7 +3643,8 @@ bool TextBuffer::findchar_forward(int startpos, char searchChar, int *foundPos)
  ** count lines quickly, hence searching for a single character: newline)
  */
 bool TextBuffer::findchar_backward(int startpos, char searchChar, int *foundPos) {
-  int pos, gaplen = gapend_ - gapstart_;
+  int i, pos, chunkstart, chunklength;
+  const char *c;
 
   if (startpos <= 0 || startpos > length_) {
     *foundPos = 0;
@@ -2065,19 +3652,15 @@ bool TextBuffer::findchar_backward(int startpos, char searchChar, int *foundPos)
   }
 
   pos = startpos - 1;
-  while (pos >= gapstart_) {
-    if (buf_[pos + gaplen] == searchChar) {
-      *foundPos = pos;
-      return true;
-    }
-    pos--;
-  }
   while (pos >= 0) {
-    if (buf_[pos] == searchChar) {
-      *foundPos = pos;
-      return true;
+    c = chunk(pos, &chunkstart, &chunklength);
+    for (i = pos - chunkstart; i >= 0; i--) {
+      if (c[i] == searchChar) {
+        *foundPos = chunkstart + i;
+        return true;
+      }
     }
-    pos--;
+    pos = chunkstart - 1;
   }
   *foundPos = 0;
   return false;
@@ -2319,6 +3902,13 @@ TextBuffer::insertfile(const char *file, int pos, int buflen) {
   FILE *fp;
   int r;
   if (!(fp = fopen(file, "r"))) return 1;
+  if (pieces_) return insertfile_pieces_(fp, pos);
+  if (pos > length_) pos = length_;
+  if (pos < 0) pos = 0;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  reserve_(pos, size);
   char *buffer = new char[buflen];
   for (; (r = fread(buffer, 1, buflen - 1, fp)) > 0; pos += r) {
     buffer[r] = '\0';
@@ -2331,9 +3921,155 @@ TextBuffer::insertfile(const char *file, int pos, int buflen) {
   return e;
 }
 
+/* Make the gap big enough for this many bytes inserted at pos, rather
+   than reallocating the entire buffer for every chunk of a file */
+void TextBuffer::reserve_(int pos, long size) {
+  if (!pieces_ && size > gapend_ - gapstart_ &&
+      size < INT_MAX - length_ - PREFERRED_GAP_SIZE)
+    reallocate_with_gap(pos, size + PREFERRED_GAP_SIZE);
+}
+
+/**
+ * Piece table version of insertfile(). The whole file is read into a
+ * block of memory the table keeps, and a piece pointing at it is
+ * inserted, so the contents are never copied again and the callbacks
+ * are only called once. A pipe or terminal, whose size cannot be found,
+ * is read until it ends. Nul characters are left out, as a text buffer
+ * cannot hold them. A file that would make the text longer than the
+ * largest int is not read, a pipe is cut off there, and 2 is returned.
+ */
+int
+TextBuffer::insertfile_pieces_(FILE *fp, int pos) {
+  if (pos > length_) pos = length_;
+  if (pos < 0) pos = 0;
+  long size = -1;
+  if (!fseek(fp, 0, SEEK_END)) size = ftell(fp);
+  if (size >= 0 && fseek(fp, 0, SEEK_SET)) size = -1;
+  /* the text must still fit in the int length */
+  int room = INT_MAX - length_;
+  if (size > room) {
+    fclose(fp);
+    return 2;
+  }
+  TextPieceTable::Block *b;
+  int n, e = 0;
+  if (size >= 0) {
+    b = pieces_->new_block(int(size));
+    n = fread(b->data, 1, size, fp);
+  } else {
+    b = pieces_->new_block(room < 65536 ? room : 65536);
+    n = 0;
+    for (;;) {
+      if (n == b->size) {
+	if (n == room) {e = 2; break;}
+	b->size = n > room / 2 ? room : 2 * n;
+	b->data = (char *)realloc(b->data, b->size);
+      }
+      int r = fread(b->data + n, 1, b->size - n, fp);
+      if (r <= 0) break;
+      n += r;
+    }
+    b->data = (char *)realloc(b->data, n ? n : 1);
+    b->size = b->used = n;
+  }
+  if (ferror(fp)) e = 2;
+  fclose(fp);
+  char *block = b->data;
+  /* a text buffer cannot hold nul characters */
+  char *nul = (char *)memchr(block, 0, n);
+  if (nul) {
+    char *q = nul;
+    for (char *p = nul; p < block + n; p++) if (*p) *q++ = *p;
+    n = q - block;
+  }
+
+  call_predelete_callbacks(pos, 0);
+  pieces_->insert_shared(pos, b, block, n);
+  length_ += n;
+  update_selections(pos, 0, n);
+  record_insert_(pos, n);
+  cursorposhint_ = pos + n;
+  call_modify_callbacks(pos, 0, n, 0, NULL);
+  return e;
+}
+
+/**
+ * Replace the entire contents of the buffer with a file, like loadfile()
+ * does, but without reading it.  The file is mapped into memory and
+ * storage() is switched to PIECE_TABLE, so the text is read straight
+ * from the mapping and the operating system only pages in the parts
+ * that are looked at.  Opening takes one pass over the file to count
+ * the lines, and uses no memory for a copy of the text.
+ *
+ * Edits never change the file or the mapping, the piece table keeps new
+ * text in memory of its own. Switching storage() to GAP_BUFFER copies
+ * the text into memory, as does outputfile() if it is asked to write
+ * the mapped file. Another program changing or truncating the file while
+ * it is mapped may change the text or crash this one, so this is meant
+ * for large files that are only read or written by this program.
+ *
+ * The undo history is cleared. Text is cut off at the first nul
+ * character, and files larger than the largest int cannot be mapped.
+ * Where mapping is not supported this reads the file into the piece
+ * table instead.
+ *
+ * Returns 0 on success, 1 if the file cannot be opened and 2 if it cannot
+ * be mapped or read.
+ */
+int TextBuffer::mapfile(const char *file) {
+#ifdef _WIN32
+  storage(PIECE_TABLE);
+  select(0, length());
+  remove_selection();
+  clear_undo();
+  return appendfile(file);
+#else
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return 1;
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size > INT_MAX) {close(fd); return 2;}
+  int size = int(st.st_size);
+  char *data = 0;
+  if (size) {
+    void *p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {close(fd); return 2;}
+    data = (char *)p;
+  }
+  close(fd);
+  /* a text buffer cannot hold nul characters */
+  int n = size;
+  char *nul = data ? (char *)memchr(data, 0, size) : 0;
+  if (nul) n = nul - data;
+
+  call_predelete_callbacks(0, length_);
+  int deleted_length = length_;
+  char *deleted_text = deleted_length ? text_range(0, deleted_length) : 0;
+  storage(PIECE_TABLE);
+  if (data) pieces_->map(data, size, n, st.st_dev, st.st_ino);
+  else pieces_->clear();
+  length_ = n;
+  update_selections(0, deleted_length, 0);
+  clear_undo();
+  cursorposhint_ = 0;
+  call_modify_callbacks(0, deleted_length, n, 0, deleted_text);
+  free(deleted_text);
+  return 0;
+#endif
+}
+
+/* Opening a mapped file for writing would truncate it under the text,
+   so copy the text from it into memory first */
+void TextBuffer::unmap_(const char *file) {
+#ifndef _WIN32
+  struct stat st;
+  if (pieces_ && !stat(file, &st)) pieces_->unmap(st.st_dev, st.st_ino);
+#endif
+}
+
 int
 TextBuffer::outputfile(const char *file, int start, int end, int buflen) {
   FILE *fp;
+  unmap_(file);
   if (!(fp = fopen(file, "w"))) return 1;
   for (int n; (n = min(end - start, buflen)); start += n) {
     const char *p = text_range(start, start + n);
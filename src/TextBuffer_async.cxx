@@ -0,0 +1,464 @@
+//
+// "$Id$"
+//
+// Loading and saving files without blocking for the TextBuffer class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+/* The file is read or written by another thread, a block at a time.
+   Blocks that have been read are put in a queue, and a timeout in the
+   main thread takes them out and appends them to the buffer, so the
+   text can be looked at and scrolled while the rest is still loading.
+   The reading thread waits if the queue gets too long, so a slow
+   display does not make the whole file sit in memory twice.
+
+   Saving copies the text first, so the file gets the text as it was
+   when the save started even if it is edited while it is written.
+
+   Where there are no threads the timeout reads or writes one block
+   each time instead. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fltk/run.h>
+#include <fltk/TextBuffer.h>
+
+#if HAVE_PTHREAD || (defined(_WIN32) && !defined(__CYGWIN__))
+# define USE_IO_THREAD 1
+# include <fltk/Threads.h>
+#else
+# define USE_IO_THREAD 0
+#endif
+
+using namespace fltk;
+
+/* How often the main thread looks for more blocks, in seconds */
+#define IO_POLL_TIME .05f
+
+/* Most blocks read and not yet in the buffer */
+#define IO_QUEUE_BLOCKS 4
+
+namespace fltk {
+
+class TextBufferIO {
+public:
+  TextBufferIO(TextBuffer *buffer, FILE *fp, char *text, int size,
+               int buflen, Text_Progress_Cb cb, void *arg);
+  bool start();
+  void finish(int status, bool notify);
+  bool inserting() const { return inserting_; }
+  bool loading() const { return !text_; }
+
+private:
+  struct Block {
+    Block *next;
+    int length;
+    char data[1];
+  };
+
+  /* shared by both threads, protected by lock() */
+#if USE_IO_THREAD
+  SignalMutex mutex_;
+#endif
+  Block *first_, *last_;	/* blocks read and not yet in the buffer */
+  int queued_;			/* number of blocks in the queue */
+  int written_;			/* bytes saved so far */
+  int status_;			/* IO_RUNNING until the thread is done */
+  bool canceled_;
+  int refs_;			/* deleted when both threads let go */
+
+  /* used by the thread doing the reading or writing */
+  FILE *fp_;
+  char *text_;			/* copy of the text being saved, or NULL */
+  int buflen_;
+  Block *block_;		/* block being read */
+  int blocklength_;
+
+  /* used by the main thread */
+  TextBuffer *buffer_;
+  int size_;			/* size of the file or text */
+  int pos_;			/* where the next block is inserted */
+  int loaded_;			/* bytes inserted so far */
+  bool inserting_;
+  Text_Progress_Cb cb_;
+  void *arg_;
+
+  ~TextBufferIO();
+  void lock() {
+#if USE_IO_THREAD
+    mutex_.lock();
+#endif
+  }
+  void unlock() {
+#if USE_IO_THREAD
+    mutex_.unlock();
+#endif
+  }
+  void release();
+  bool step();
+  bool read_step();
+  bool write_step();
+  void poll();
+  static void *thread(void *v);
+  static void timeout_cb(void *v);
+  static void modified_cb(int pos, int nInserted, int nDeleted,
+                          int nRestyled, const char *deletedText, void *v);
+};
+
+} /* namespace fltk */
+
+TextBufferIO::TextBufferIO(TextBuffer *buffer, FILE *fp, char *text,
+                           int size, int buflen, Text_Progress_Cb cb,
+                           void *arg)
+  : first_(0), last_(0), queued_(0), written_(0),
+    status_(TextBuffer::IO_RUNNING),
+    canceled_(false), refs_(1), fp_(fp), text_(text),
+    buflen_(buflen > 1 ? buflen : 1), block_(0), blocklength_(0),
+    buffer_(buffer), size_(size), pos_(buffer->length()), loaded_(0),
+    inserting_(false), cb_(cb), arg_(arg) {
+  if (!text_) buffer_->add_modify_callback(modified_cb, this);
+}
+
+TextBufferIO::~TextBufferIO() {
+  while (first_) {
+    Block *b = first_;
+    first_ = b->next;
+    free(b);
+  }
+  free(block_);
+  free(text_);
+}
+
+/* Start the thread, or the timeout that does the work without one */
+bool TextBufferIO::start() {
+#if USE_IO_THREAD
+  Thread t;
+  refs_ = 2;
+# if defined(_WIN32) && !defined(__CYGWIN__)
+  if (create_thread(t, thread, this) == -1) {refs_ = 1; return false;}
+# else
+  if (create_thread(t, thread, this)) {refs_ = 1; return false;}
+  pthread_detach(t);
+# endif
+#endif
+  add_timeout(IO_POLL_TIME, timeout_cb, this);
+  return true;
+}
+
+/* Let go of this in the thread that calls it, it is deleted when both
+   threads have let go */
+void TextBufferIO::release() {
+  lock();
+  canceled_ = true;
+#if USE_IO_THREAD
+  mutex_.signal();
+#endif
+  bool last = !--refs_;
+  unlock();
+  if (last) delete this;
+}
+
+/* Read or write one block, returns false when there is no more to do */
+bool TextBufferIO::step() {
+  bool more = text_ ? write_step() : read_step();
+  if (!more) {
+    int e = ferror(fp_) ? TextBuffer::IO_ERROR : TextBuffer::IO_DONE;
+    if (fclose(fp_)) e = TextBuffer::IO_ERROR;
+    fp_ = 0;
+    lock();
+    status_ = e;
+    unlock();
+  }
+  return more;
+}
+
+/* Read a block and add it to the queue. Only whole lines are queued,
+   so the buffer never shows half a line or half a UTF-8 character,
+   unless a line is longer than a block. */
+bool TextBufferIO::read_step() {
+  if (!block_) {
+    block_ = (Block *)malloc(sizeof(Block) + 2 * buflen_);
+    blocklength_ = 0;
+  }
+  int r = fread(block_->data + blocklength_, 1, buflen_, fp_);
+  if (r > 0) blocklength_ += r;
+  int keep = blocklength_;
+  Block *next = 0;
+  if (r > 0) {
+    char *p = block_->data + blocklength_;
+    while (p > block_->data && p[-1] != '\n') p--;
+    if (p > block_->data) keep = p - block_->data;
+    next = (Block *)malloc(sizeof(Block) + 2 * buflen_);
+    memcpy(next->data, block_->data + keep, blocklength_ - keep);
+  }
+  int nextlength = blocklength_ - keep;
+  Block *b = block_;
+  block_ = next;
+  blocklength_ = nextlength;
+  if (keep) {
+    b->data[keep] = 0;
+    b->length = keep;
+    b->next = 0;
+    lock();
+#if USE_IO_THREAD
+    while (queued_ >= IO_QUEUE_BLOCKS && !canceled_) mutex_.wait();
+#endif
+    if (canceled_) {
+      unlock();
+      free(b);
+      return false;
+    }
+    if (last_) last_->next = b; else first_ = b;
+    last_ = b;
+    queued_++;
+    unlock();
+  } else {
+    free(b);
+  }
+  return r > 0;
+}
+
+/* Write a block of the copied text */
+bool TextBufferIO::write_step() {
+  int n = size_ - written_ < buflen_ ? size_ - written_ : buflen_;
+  if (n <= 0) return false;
+  if (int(fwrite(text_ + written_, 1, n, fp_)) != n) return false;
+  lock();
+  written_ += n;
+  bool canceled = canceled_;
+  unlock();
+  return !canceled;
+}
+
+void *TextBufferIO::thread(void *v) {
+  TextBufferIO *io = (TextBufferIO *)v;
+  while (io->step()) {
+    io->lock();
+    bool canceled = io->canceled_;
+    io->unlock();
+    if (canceled) {
+      if (io->fp_) fclose(io->fp_);
+      io->fp_ = 0;
+      break;
+    }
+  }
+  io->release();
+  return 0;
+}
+
+/* Keep inserting after the text already loaded when the buffer is
+   edited before it */
+void TextBufferIO::modified_cb(int pos, int nInserted, int nDeleted,
+                               int, const char *, void *v) {
+  TextBufferIO *io = (TextBufferIO *)v;
+  if (io->inserting_ || pos >= io->pos_) return;
+  if (pos + nDeleted <= io->pos_) io->pos_ += nInserted - nDeleted;
+  else io->pos_ = pos + nInserted;
+}
+
+void TextBufferIO::timeout_cb(void *v) {
+  ((TextBufferIO *)v)->poll();
+}
+
+/* Called in the main thread to move the blocks read into the buffer,
+   and to report the progress */
+void TextBufferIO::poll() {
+#if !USE_IO_THREAD
+  if (fp_) step();
+#endif
+  int inserted = 0;
+  for (;;) {
+    lock();
+    Block *b = first_;
+    if (b) {
+      first_ = b->next;
+      if (!first_) last_ = 0;
+      queued_--;
+#if USE_IO_THREAD
+      mutex_.signal();
+#endif
+    }
+    unlock();
+    if (!b) break;
+    if (pos_ > buffer_->length()) pos_ = buffer_->length();
+    int n = buffer_->length();
+    /* the loaded text is not something the user can undo */
+    char canundo = buffer_->mCanUndo;
+    buffer_->mCanUndo = 0;
+    inserting_ = true;
+    /* a text buffer cannot hold nul characters, so the text is cut
+       off at the first one, as insertfile() does with a piece table */
+    char *nul = (char *)memchr(b->data, 0, b->length);
+    buffer_->insert(pos_, b->data);
+    inserting_ = false;
+    buffer_->mCanUndo = canundo;
+    pos_ += buffer_->length() - n;
+    loaded_ += nul ? nul - b->data : b->length;
+    inserted++;
+    free(b);
+    if (nul) {
+      finish(TextBuffer::IO_DONE, true);
+      return;
+    }
+    /* let the display draw what is there, the rest is done next time */
+    if (inserted >= IO_QUEUE_BLOCKS) break;
+  }
+
+  lock();
+  int status = first_ ? TextBuffer::IO_RUNNING : status_;
+  int done = text_ ? written_ : loaded_;
+  unlock();
+  if (status != TextBuffer::IO_RUNNING) {
+    finish(status, true);
+    return;
+  }
+  repeat_timeout(IO_POLL_TIME, timeout_cb, this);
+  if (cb_) cb_(done, done > size_ ? done : size_, TextBuffer::IO_RUNNING, arg_);
+}
+
+/* Stop, and tell the callback how it ended. The callback is called
+   last as it may delete the buffer or start another load. */
+void TextBufferIO::finish(int status, bool notify) {
+  remove_timeout(timeout_cb, this);
+  if (!text_) buffer_->remove_modify_callback(modified_cb, this);
+  buffer_->io_ = 0;
+#if !USE_IO_THREAD
+  if (fp_) fclose(fp_);
+  fp_ = 0;
+#endif
+  Text_Progress_Cb cb = cb_;
+  void *arg = arg_;
+  lock();
+  int done = text_ ? written_ : loaded_;
+  unlock();
+  int total = status == TextBuffer::IO_DONE ? done : size_;
+  release();
+  if (notify && cb) cb(done, total, status, arg);
+}
+
+/**
+ * Replace the entire contents of the buffer with a file, like loadfile()
+ * does, but without waiting for it to be read. The file is read by
+ * another thread in blocks of \a buflen bytes, and the blocks are added
+ * to the end of the buffer as the program waits for events, so the text
+ * read so far can be displayed, scrolled and edited right away.
+ *
+ * \a cb is called with \a cbArg after each time text is added, with
+ * the number of bytes loaded so far, the size of the file, and a status
+ * of IO_RUNNING. When the loading stops it is called once more with a
+ * status of IO_DONE if the whole file was loaded, IO_ERROR if there was
+ * an error reading it, or IO_CANCELED if it was stopped by cancel_io().
+ * Text is cut off at the first nul character, like mapfile() does.
+ *
+ * The undo history is cleared, and the text loaded cannot be undone.
+ * Only one file is loaded or saved at a time, starting another one
+ * cancels the one running. Destroying the buffer cancels it without
+ * calling the callback.
+ *
+ * Returns 0 if the loading started, 1 if the file cannot be opened and
+ * 2 if the thread cannot be started.
+ */
+int TextBuffer::loadfile_async(const char *file, Text_Progress_Cb cb,
+                               void *cbArg, int buflen) {
+  cancel_io();
+  FILE *fp = fopen(file, "r");
+  if (!fp) return 1;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size < 0 || size > INT_MAX) size = 0;
+  select(0, length());
+  remove_selection();
+  clear_undo();
+  reserve_(0, size);
+  io_ = new TextBufferIO(this, fp, 0, int(size), buflen, cb, cbArg);
+  if (!io_->start()) {
+    fclose(fp);
+    delete_io_();
+    return 2;
+  }
+  return 0;
+}
+
+/**
+ * Write the buffer to a file, like savefile() does, but without waiting
+ * for it to be written. The text is copied, and the copy is written by
+ * another thread in blocks of \a buflen bytes, so the file gets the text
+ * as it was when this was called even if it is edited after that.
+ *
+ * \a cb is called with \a cbArg and the number of bytes written as the
+ * saving goes on, the same way as for loadfile_async().
+ *
+ * A save already running is canceled. While loadfile_async() is still
+ * running nothing is done and 3 is returned, as the buffer does not
+ * have all of the file yet and the file may be the one being read.
+ *
+ * Returns 0 if the saving started, 1 if the file cannot be opened, 2
+ * if the thread cannot be started and 3 if a file is being loaded.
+ */
+int TextBuffer::savefile_async(const char *file, Text_Progress_Cb cb,
+                               void *cbArg, int buflen) {
+  if (io_ && io_->loading()) return 3;
+  cancel_io();
+  unmap_(file);
+  FILE *fp = fopen(file, "w");
+  if (!fp) return 1;
+  char *text = text_range(0, length_);
+  io_ = new TextBufferIO(this, fp, text, length_, buflen, cb, cbArg);
+  if (!io_->start()) {
+    fclose(fp);
+    delete_io_();
+    return 2;
+  }
+  return 0;
+}
+
+/**
+ * Stop loadfile_async() or savefile_async(). The text already loaded
+ * stays in the buffer, and a file being saved is left with only part
+ * of the text in it. The callback is called with a status of
+ * IO_CANCELED.
+ */
+void TextBuffer::cancel_io() {
+  if (io_) io_->finish(IO_CANCELED, true);
+}
+
+/**
+ * True while loadfile_async() is adding text it has read to the buffer.
+ * A modify callback can use this to tell the text being loaded from
+ * edits made while it loads.
+ */
+bool TextBuffer::io_inserting() const {
+  return io_ && io_->inserting();
+}
+
+/* Stop without calling the callback, for the destructor */
+void TextBuffer::delete_io_() {
+  io_->finish(IO_CANCELED, false);
+}
+
+//
+// End of "$Id$".
+//
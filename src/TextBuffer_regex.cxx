@@ -0,0 +1,807 @@
+//
+// "$Id$"
+//
+// Regular expression searching for the TextBuffer class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+/* The pattern is parsed into a tree, which is compiled into a program
+   for a "Pike" virtual machine: every possible way the pattern could be
+   matching is kept as a thread, and all of them are moved forward one
+   character at a time. This never backs up, so the text can be read
+   straight out of the chunks of the buffer without copying it, and the
+   time taken is proportional to the length of the text times the length
+   of the pattern, no matter what the pattern is. */
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <fltk/string.h>
+#include <fltk/TextBuffer.h>
+
+using namespace fltk;
+
+enum {
+  OP_CHAR,	/* x is the character */
+  OP_ANY,	/* any character but newline */
+  OP_CLASS,	/* x is the index of the class bitmap */
+  OP_BOL,	/* start of a line */
+  OP_EOL,	/* end of a line */
+  OP_WORDB,	/* word boundary */
+  OP_NWORDB,	/* not a word boundary */
+  OP_SPLIT,	/* continue at both x and y, x is preferred */
+  OP_JMP,	/* continue at x */
+  OP_MATCH
+};
+
+struct RegexInst {
+  int op, x, y;
+};
+
+/* Largest program that will be compiled, so that a pattern like
+   a{1000}{1000} is an error rather than using all the memory */
+#define REGEX_MAX_PROGRAM 30000
+
+/* Largest count allowed in {m,n} */
+#define REGEX_MAX_REPEAT 1000
+
+namespace fltk {
+
+class TextRegexProgram {
+public:
+  TextRegexProgram() : code(0), length(0), size(0), classes(0), nclasses(0),
+		       firstchar(-1) {}
+  ~TextRegexProgram() { free(code); free(classes); }
+  RegexInst *code;
+  int length, size;
+  unsigned char (*classes)[32];
+  int nclasses;
+  int firstchar;	/* every match starts with this, or -1 */
+};
+
+} /* namespace fltk */
+
+enum {
+  N_EMPTY, N_CHAR, N_ANY, N_CLASS, N_BOL, N_EOL, N_WORDB, N_NWORDB,
+  N_CAT, N_ALT, N_REPEAT
+};
+
+struct RegexNode {
+  int type;
+  RegexNode *a, *b;	/* children, b of a N_CAT is the rest of the list */
+  int c;		/* character or class index */
+  int min, max;		/* for N_REPEAT, max is -1 for no limit */
+  RegexNode *allocated;	/* list of all nodes, to free them */
+};
+
+static bool is_word(int c) {
+  return c >= 0 && (isalnum(c) || c == '_');
+}
+
+static void set_bit(unsigned char *bits, int c) {
+  bits[c >> 3] |= 1 << (c & 7);
+}
+
+static bool test_bit(const unsigned char *bits, int c) {
+  return (bits[c >> 3] & (1 << (c & 7))) != 0;
+}
+
+/* Turns the pattern into a TextRegexProgram */
+class RegexCompiler {
+public:
+  RegexCompiler(const char *pattern, bool matchcase, TextRegexProgram *program)
+    : error(0), p(pattern), matchcase_(matchcase), program_(program),
+      nodes_(0) {}
+  ~RegexCompiler();
+  void compile();
+  const char *error;
+
+private:
+  const char *p;
+  bool matchcase_;
+  TextRegexProgram *program_;
+  RegexNode *nodes_;
+
+  RegexNode *node(int type, RegexNode *a = 0, RegexNode *b = 0);
+  RegexNode *alternation();
+  RegexNode *concatenation();
+  RegexNode *repetition();
+  RegexNode *atom();
+  RegexNode *bracket();
+  bool escape_class(int c, unsigned char *bits);
+  int escape_char(int c);
+  int add_class(unsigned char *bits);
+  int emit(int op, int x = 0, int y = 0);
+  void generate(RegexNode *n);
+};
+
+RegexCompiler::~RegexCompiler() {
+  while (nodes_) {
+    RegexNode *n = nodes_;
+    nodes_ = n->allocated;
+    delete n;
+  }
+}
+
+RegexNode *RegexCompiler::node(int type, RegexNode *a, RegexNode *b) {
+  RegexNode *n = new RegexNode;
+  n->type = type;
+  n->a = a;
+  n->b = b;
+  n->c = n->min = n->max = 0;
+  n->allocated = nodes_;
+  nodes_ = n;
+  return n;
+}
+
+RegexNode *RegexCompiler::alternation() {
+  RegexNode *n = concatenation();
+  while (!error && *p == '|') {
+    p++;
+    n = node(N_ALT, n, concatenation());
+  }
+  return n;
+}
+
+/* The list is built so that it runs down the b pointers, which lets
+   generate() walk it with a loop rather than recursion */
+RegexNode *RegexCompiler::concatenation() {
+  RegexNode *first = 0, *last = 0;
+  while (!error && *p && *p != '|' && *p != ')') {
+    RegexNode *n = node(N_CAT, repetition());
+    if (last) last->b = n; else first = n;
+    last = n;
+  }
+  return first ? first : node(N_EMPTY);
+}
+
+/* Parses the digits of a {m,n} count, returns -1 if there are none */
+static int parse_count(const char *&p) {
+  if (!isdigit((unsigned char)*p)) return -1;
+  int n = 0;
+  while (isdigit((unsigned char)*p)) {
+    if (n <= REGEX_MAX_REPEAT) n = n * 10 + *p - '0';
+    p++;
+  }
+  return n;
+}
+
+/* Returns true if p points at a valid {m}, {m,} or {m,n} */
+static bool is_count(const char *p) {
+  if (*p++ != '{' || parse_count(p) < 0) return false;
+  if (*p == ',') { p++; parse_count(p); }
+  return *p == '}';
+}
+
+RegexNode *RegexCompiler::repetition() {
+  RegexNode *n = atom();
+  while (!error) {
+    int min, max;
+    if (*p == '*') { min = 0; max = -1; p++; }
+    else if (*p == '+') { min = 1; max = -1; p++; }
+    else if (*p == '?') { min = 0; max = 1; p++; }
+    else if (is_count(p)) {
+      p++;
+      min = max = parse_count(p);
+      if (*p == ',') { p++; max = parse_count(p); }
+      p++;
+      if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) {
+	error = "Count in {} is too large";
+	break;
+      }
+      if (max >= 0 && max < min) {
+	error = "Counts in {} are out of order";
+	break;
+      }
+    } else break;
+    n = node(N_REPEAT, n);
+    n->min = min;
+    n->max = max;
+  }
+  return n;
+}
+
+/* Sets the bits for \d, \w, \s and their opposites, returns false if c
+   is not one of those */
+bool RegexCompiler::escape_class(int c, unsigned char *bits) {
+  int lower = tolower(c);
+  if (lower != 'd' && lower != 'w' && lower != 's') return false;
+  unsigned char set[32];
+  memset(set, 0, sizeof(set));
+  for (int i = 0; i < 256; i++)
+    if (lower == 'd' ? isdigit(i) : lower == 'w' ? is_word(i) : isspace(i))
+      set_bit(set, i);
+  for (int i = 0; i < 32; i++)
+    bits[i] |= c == lower ? set[i] : (unsigned char)~set[i];
+  return true;
+}
+
+int RegexCompiler::escape_char(int c) {
+  switch (c) {
+  case 'n': return '\n';
+  case 't': return '\t';
+  case 'r': return '\r';
+  case 'f': return '\f';
+  case 'v': return '\v';
+  case 'e': return 27;
+  default: return c;
+  }
+}
+
+RegexNode *RegexCompiler::atom() {
+  unsigned char bits[32];
+  RegexNode *n;
+  int c = (unsigned char)*p++;
+  switch (c) {
+  case '(':
+    n = alternation();
+    if (error) return n;
+    if (*p != ')') {
+      error = "Missing )";
+      return n;
+    }
+    p++;
+    return n;
+  case '.':
+    return node(N_ANY);
+  case '^':
+    return node(N_BOL);
+  case '$':
+    return node(N_EOL);
+  case '[':
+    return bracket();
+  case '*':
+  case '+':
+  case '?':
+    error = "Nothing to repeat";
+    return node(N_EMPTY);
+  case '{':
+    if (is_count(p - 1)) {
+      error = "Nothing to repeat";
+      return node(N_EMPTY);
+    }
+    break;
+  case '\\':
+    c = (unsigned char)*p++;
+    if (!c) {
+      p--;
+      error = "Trailing \\";
+      return node(N_EMPTY);
+    }
+    if (c == 'b') return node(N_WORDB);
+    if (c == 'B') return node(N_NWORDB);
+    memset(bits, 0, sizeof(bits));
+    if (escape_class(c, bits)) {
+      n = node(N_CLASS);
+      n->c = add_class(bits);
+      return n;
+    }
+    c = escape_char(c);
+    break;
+  }
+  n = node(N_CHAR);
+  n->c = c;
+  return n;
+}
+
+/* Parses a [...] character class, the [ has been skipped */
+RegexNode *RegexCompiler::bracket() {
+  unsigned char bits[32];
+  memset(bits, 0, sizeof(bits));
+  bool negate = false;
+  if (*p == '^') { negate = true; p++; }
+  bool first = true;
+  for (;;) {
+    int c = (unsigned char)*p++;
+    if (!c) {
+      p--;
+      error = "Missing ]";
+      return node(N_EMPTY);
+    }
+    if (c == ']' && !first) break;
+    first = false;
+    if (c == '\\' && *p) {
+      c = (unsigned char)*p++;
+      if (escape_class(c, bits)) continue;
+      c = escape_char(c);
+    }
+    int last = c;
+    if (*p == '-' && p[1] && p[1] != ']') {
+      p++;
+      last = (unsigned char)*p++;
+      if (last == '\\' && *p) last = escape_char((unsigned char)*p++);
+      if (last < c) {
+	error = "Range in [] is out of order";
+	return node(N_EMPTY);
+      }
+    }
+    for (; c <= last; c++) set_bit(bits, c);
+  }
+  RegexNode *n = node(N_CLASS);
+  if (negate) {
+    /* fold first so that [^a] does not match A when ignoring case */
+    if (!matchcase_) {
+      for (int i = 0; i < 256; i++)
+	if (test_bit(bits, i)) {
+	  set_bit(bits, tolower(i));
+	  set_bit(bits, toupper(i));
+	}
+    }
+    for (int i = 0; i < 32; i++) bits[i] = ~bits[i];
+  }
+  n->c = add_class(bits);
+  return n;
+}
+
+/* Adds a class bitmap to the program and returns its index. When
+   ignoring case the other case of every letter is added to it. */
+int RegexCompiler::add_class(unsigned char *bits) {
+  if (!matchcase_) {
+    for (int i = 0; i < 256; i++)
+      if (test_bit(bits, i)) {
+	set_bit(bits, tolower(i));
+	set_bit(bits, toupper(i));
+      }
+  }
+  program_->classes = (unsigned char (*)[32])
+    realloc(program_->classes, (program_->nclasses + 1) * 32);
+  memcpy(program_->classes[program_->nclasses], bits, 32);
+  return program_->nclasses++;
+}
+
+int RegexCompiler::emit(int op, int x, int y) {
+  TextRegexProgram *g = program_;
+  if (g->length >= REGEX_MAX_PROGRAM) error = "Pattern is too large";
+  if (g->length >= g->size) {
+    g->size = g->size ? 2 * g->size : 64;
+    g->code = (RegexInst *)realloc(g->code, g->size * sizeof(RegexInst));
+  }
+  g->code[g->length].op = op;
+  g->code[g->length].x = x;
+  g->code[g->length].y = y;
+  return g->length++;
+}
+
+/* Instructions are referred to by index, as the array moves when it
+   grows */
+void RegexCompiler::generate(RegexNode *n) {
+  TextRegexProgram *g = program_;
+  for (; n && !error; n = n->b) {
+    switch (n->type) {
+    case N_CAT:
+      generate(n->a);
+      continue;
+    case N_CHAR:
+      if (!matchcase_ && tolower(n->c) != toupper(n->c)) {
+	unsigned char bits[32];
+	memset(bits, 0, sizeof(bits));
+	set_bit(bits, n->c);
+	emit(OP_CLASS, add_class(bits));
+      } else {
+	emit(OP_CHAR, n->c);
+      }
+      break;
+    case N_ANY: emit(OP_ANY); break;
+    case N_CLASS: emit(OP_CLASS, n->c); break;
+    case N_BOL: emit(OP_BOL); break;
+    case N_EOL: emit(OP_EOL); break;
+    case N_WORDB: emit(OP_WORDB); break;
+    case N_NWORDB: emit(OP_NWORDB); break;
+    case N_ALT: {
+      int split = emit(OP_SPLIT);
+      g->code[split].x = g->length;
+      generate(n->a);
+      int jmp = emit(OP_JMP);
+      g->code[split].y = g->length;
+      generate(n->b);
+      g->code[jmp].x = g->length;
+      break;}
+    case N_REPEAT: {
+      int i;
+      for (i = 0; i < n->min && !error; i++) generate(n->a);
+      if (n->max < 0) {
+	int split = emit(OP_SPLIT);
+	g->code[split].x = split + 1;
+	generate(n->a);
+	emit(OP_JMP, split);
+	g->code[split].y = g->length;
+      } else {
+	for (; i < n->max && !error; i++) {
+	  int split = emit(OP_SPLIT);
+	  g->code[split].x = split + 1;
+	  generate(n->a);
+	  g->code[split].y = g->length;
+	}
+      }
+      break;}
+    }
+    break;
+  }
+}
+
+void RegexCompiler::compile() {
+  RegexNode *n = alternation();
+  if (!error && *p == ')') error = "Unmatched )";
+  if (error) return;
+  generate(n);
+  emit(OP_MATCH);
+  if (program_->code[0].op == OP_CHAR) program_->firstchar = program_->code[0].x;
+}
+
+/**
+ * Compile a regular expression. The syntax is the "extended" one used
+ * by egrep: . [] [^] * + ? {m,n} | () ^ $, plus \\d \\w \\s and their
+ * upper case opposites, \\b and \\B for word boundaries, and \\n \\t
+ * \\r \\f \\v \\e for control characters. "." does not match a newline,
+ * and ^ and $ match at the start and end of every line. If "matchCase"
+ * is false letters match either case. If the pattern is bad error()
+ * returns a message and all searches with it fail.
+ */
+TextRegex::TextRegex(const char *pattern, bool matchCase) {
+  program_ = new TextRegexProgram;
+  RegexCompiler compiler(pattern, matchCase, program_);
+  compiler.compile();
+  error_ = compiler.error;
+  if (error_) {
+    delete program_;
+    program_ = 0;
+  }
+}
+
+TextRegex::~TextRegex() {
+  delete program_;
+}
+
+enum {
+  RUN_FIRST,	/* leftmost match, preferring the way the pattern is written */
+  RUN_LAST,	/* match with the greatest start, end is not reliable */
+  RUN_ANCHORED	/* like RUN_FIRST but only a match at the start */
+};
+
+struct RegexThread {
+  int pc, start;
+};
+
+/* Memory for running a program, kept for all the searches done by one
+   call so that finding every match does not allocate for each one */
+class RegexRun {
+public:
+  RegexRun(TextBuffer *buffer, const TextRegexProgram *program);
+  ~RegexRun() { free(memory_); }
+  int run(int mode, int start, int end, int maxScan,
+	  int *matchStart, int *matchEnd);
+
+private:
+  TextBuffer *buffer_;
+  const TextRegexProgram *program_;
+  void *memory_;
+  RegexThread *clist_, *nlist_;
+  int *mark_, *stack_;
+  int gen_;
+  const char *chunk_;
+  int chunkstart_, chunkend_;
+
+  int at(int pos);
+  void add(RegexThread *list, int &n, int pc, int start, int prev, int cur);
+};
+
+RegexRun::RegexRun(TextBuffer *buffer, const TextRegexProgram *program) {
+  buffer_ = buffer;
+  program_ = program;
+  int n = program->length;
+  /* one block for both thread lists, the marks and the stack */
+  memory_ = malloc(2 * n * sizeof(RegexThread) + (3 * n + 1) * sizeof(int));
+  clist_ = (RegexThread *)memory_;
+  nlist_ = clist_ + n;
+  mark_ = (int *)(nlist_ + n);
+  stack_ = mark_ + n;
+  for (int i = 0; i < n; i++) mark_[i] = 0;
+  gen_ = 0;
+  chunk_ = 0;
+  chunkstart_ = chunkend_ = 0;
+}
+
+/* Character at pos, or -1 if it is outside the buffer */
+int RegexRun::at(int pos) {
+  if (pos < chunkstart_ || pos >= chunkend_) {
+    if (pos < 0 || pos >= buffer_->length()) return -1;
+    int n;
+    chunk_ = buffer_->chunk(pos, &chunkstart_, &n);
+    chunkend_ = chunkstart_ + n;
+  }
+  return (unsigned char)chunk_[pos - chunkstart_];
+}
+
+/* Add a thread to the list, following jumps and testing the assertions
+   between prev and cur, the characters either side of the position.
+   Only the first thread to reach an instruction is kept, as any others
+   would do exactly the same thing from then on. */
+void RegexRun::add(RegexThread *list, int &n, int pc, int start,
+		   int prev, int cur) {
+  int sp = 0;
+  stack_[sp++] = pc;
+  while (sp) {
+    pc = stack_[--sp];
+    if (mark_[pc] == gen_) continue;
+    mark_[pc] = gen_;
+    const RegexInst &inst = program_->code[pc];
+    switch (inst.op) {
+    case OP_JMP:
+      stack_[sp++] = inst.x;
+      break;
+    case OP_SPLIT:
+      stack_[sp++] = inst.y;
+      stack_[sp++] = inst.x;
+      break;
+    case OP_BOL:
+      if (prev < 0 || prev == '\n') stack_[sp++] = pc + 1;
+      break;
+    case OP_EOL:
+      if (cur < 0 || cur == '\n') stack_[sp++] = pc + 1;
+      break;
+    case OP_WORDB:
+      if (is_word(prev) != is_word(cur)) stack_[sp++] = pc + 1;
+      break;
+    case OP_NWORDB:
+      if (is_word(prev) == is_word(cur)) stack_[sp++] = pc + 1;
+      break;
+    default:
+      list[n].pc = pc;
+      list[n].start = start;
+      n++;
+    }
+  }
+}
+
+/* Look for a match lying between start and end. Returns 1 and sets
+   matchStart and matchEnd if one is found, 0 if not. If maxScan is not
+   zero and that many characters have been looked at, this may instead
+   return -1 and set matchStart to where the search should be resumed,
+   which is before any partial match. */
+int RegexRun::run(int mode, int start, int end, int maxScan,
+		  int *matchStart, int *matchEnd) {
+  int firstchar = mode == RUN_ANCHORED ? -1 : program_->firstchar;
+  int pos = start;
+  int cur = at(pos);
+  int cn = 0, nn = 0;
+  int beststart = -1, bestend = -1;
+  RegexThread *t;
+
+  gen_++;
+  if (firstchar < 0 || cur == firstchar)
+    add(clist_, cn, 0, pos, at(pos - 1), cur);
+  for (;;) {
+    if (!cn) {
+      if (mode == RUN_ANCHORED || pos >= end) break;
+      if (beststart >= 0 && mode == RUN_FIRST) break;
+      if (firstchar >= 0) {
+	/* skip straight to the next place a match could start */
+	if (maxScan && pos - start >= maxScan) {
+	  *matchStart = pos;
+	  return -1;
+	}
+	if (!buffer_->findchar_forward(pos, (char)firstchar, &pos) || pos >= end)
+	  break;
+	cur = firstchar;
+	gen_++;
+	add(clist_, cn, 0, pos, at(pos - 1), cur);
+      }
+    }
+    int c = pos < end ? cur : -1;
+    int next = pos < end ? at(pos + 1) : -1;
+    gen_++;
+    nn = 0;
+    /* When looking for the greatest start the new thread goes first, so
+       that it wins over older ones reaching the same instruction */
+    if (mode == RUN_LAST && c >= 0 && (firstchar < 0 || next == firstchar))
+      add(nlist_, nn, 0, pos + 1, c, next);
+    for (t = clist_; t < clist_ + cn; t++) {
+      const RegexInst &inst = program_->code[t->pc];
+      bool ok;
+      switch (inst.op) {
+      case OP_MATCH:
+	if (mode == RUN_LAST) {
+	  if (t->start > beststart) { beststart = t->start; bestend = pos; }
+	  continue;
+	}
+	/* threads after this one are less preferred, drop them */
+	beststart = t->start;
+	bestend = pos;
+	cn = 0;
+	continue;
+      case OP_CHAR:
+	ok = c == inst.x;
+	break;
+      case OP_ANY:
+	ok = c >= 0 && c != '\n';
+	break;
+      default:
+	ok = c >= 0 && test_bit(program_->classes[inst.x], c);
+	break;
+      }
+      if (ok) add(nlist_, nn, t->pc + 1, t->start, c, next);
+    }
+    if (c < 0) break;
+    if (mode == RUN_FIRST && beststart < 0 && (firstchar < 0 || next == firstchar))
+      add(nlist_, nn, 0, pos + 1, c, next);
+    t = clist_; clist_ = nlist_; nlist_ = t;
+    cn = nn;
+    pos++;
+    cur = next;
+    if (maxScan && beststart < 0 && pos - start >= maxScan && !(pos & 1023)) {
+      int resume = pos;
+      for (t = clist_; t < clist_ + cn; t++)
+	if (t->start < resume) resume = t->start;
+      /* always make progress, even if it means going past maxScan */
+      if (resume > start) {
+	*matchStart = resume;
+	return -1;
+      }
+    }
+  }
+  if (beststart < 0) return 0;
+  *matchStart = beststart;
+  *matchEnd = bestend;
+  return 1;
+}
+
+/**
+ * Search forward for the first match of "regex" that lies between
+ * "startPos" and "endPos". If found, return true and set "foundStart"
+ * and "foundEnd" to where it starts and ends. The text is read in place
+ * so this is fast even for a very large buffer, see regex_search_some()
+ * to search one a bit at a time.
+ */
+bool TextBuffer::regex_search_forward(int startPos, int endPos,
+                                      const TextRegex& regex,
+                                      int* foundStart, int* foundEnd) {
+  if (!regex.program_) return false;
+  if (startPos < 0) startPos = 0;
+  if (endPos > length_) endPos = length_;
+  if (startPos > endPos) return false;
+  RegexRun run(this, regex.program_);
+  return run.run(RUN_FIRST, startPos, endPos, 0, foundStart, foundEnd) > 0;
+}
+
+/**
+ * Search backward for the match of "regex" that starts closest to
+ * "endPos", and lies entirely between "startPos" and "endPos". If
+ * found, return true and set "foundStart" and "foundEnd" to where it
+ * starts and ends. The end is the same one regex_search_forward()
+ * would find starting at "foundStart".
+ */
+bool TextBuffer::regex_search_backward(int startPos, int endPos,
+                                       const TextRegex& regex,
+                                       int* foundStart, int* foundEnd) {
+  if (!regex.program_) return false;
+  if (startPos < 0) startPos = 0;
+  if (endPos > length_) endPos = length_;
+  if (startPos > endPos) return false;
+  RegexRun run(this, regex.program_);
+  /* Search forward through larger and larger pieces of the text before
+     endPos, until one of them has a match in it */
+  int window = 4096;
+  for (;;) {
+    if (window > endPos - startPos) window = endPos - startPos;
+    int from = endPos - window;
+    int start, end;
+    if (run.run(RUN_LAST, from, endPos, 0, &start, &end) > 0)
+      return run.run(RUN_ANCHORED, start, endPos, 0, foundStart, foundEnd) > 0;
+    if (from == startPos) return false;
+    window *= 2;
+  }
+}
+
+/* Where to search for the next match after one from start to end. An
+   empty match right where a non-empty one ended is skipped, like other
+   regex engines do, so "o*" finds "oo" in "xoox" but not the empty
+   string after it. */
+static int next_search(RegexRun& run, int start, int end, int endPos) {
+  if (end == start) return end + 1;
+  int s, e;
+  if (run.run(RUN_ANCHORED, end, endPos, 0, &s, &e) > 0 && e == end)
+    return end + 1;
+  return end;
+}
+
+/**
+ * Find every match of "regex" between "startPos" and "endPos", in order,
+ * and call "matchCB" with the start and end of each one and "cbArg".
+ * Matches do not overlap; after an empty match the search resumes one
+ * character later, and an empty match where the one before it ended is
+ * skipped. If "matchCB" returns zero the search stops. "matchCB"
+ * may be NULL to just count the matches. Returns the number of matches.
+ */
+int TextBuffer::regex_search_all(int startPos, int endPos,
+                                 const TextRegex& regex,
+                                 Text_Match_Cb matchCB, void* cbArg) {
+  if (!regex.program_) return 0;
+  if (startPos < 0) startPos = 0;
+  if (endPos > length_) endPos = length_;
+  RegexRun run(this, regex.program_);
+  int count = 0;
+  int start, end;
+  while (startPos <= endPos &&
+         run.run(RUN_FIRST, startPos, endPos, 0, &start, &end) > 0) {
+    count++;
+    if (matchCB && !matchCB(start, end, cbArg)) break;
+    startPos = next_search(run, start, end, endPos);
+  }
+  return count;
+}
+
+/**
+ * Do part of a regex_search_all(), so that a search through a very
+ * large buffer can be spread out over calls from an fltk::add_idle()
+ * callback. The search starts at "*pos" and looks at about "maxScan"
+ * characters (zero means no limit), calling "matchCB" for each match
+ * found. "*pos" is then set to where to continue from. Returns true
+ * if this should be called again, or false if the search reached
+ * "endPos" or "matchCB" returned zero to cancel it:
+
+\code
+int pos = 0;
+void search_idle(void *regex) {
+  if (!buffer->regex_search_some(&pos, buffer->length(),
+                                 *(TextRegex*)regex, found_cb, 0, 1<<20))
+    fltk::remove_idle(search_idle, regex);
+}
+\endcode
+
+ * The buffer must not be modified between calls, or the search should
+ * be started over.
+ */
+bool TextBuffer::regex_search_some(int* pos, int endPos,
+                                   const TextRegex& regex,
+                                   Text_Match_Cb matchCB, void* cbArg,
+                                   int maxScan) {
+  if (!regex.program_) return false;
+  if (*pos < 0) *pos = 0;
+  if (endPos > length_) endPos = length_;
+  RegexRun run(this, regex.program_);
+  int startPos = *pos;
+  while (*pos <= endPos) {
+    int budget = 0;
+    if (maxScan) {
+      budget = maxScan - (*pos - startPos);
+      if (budget <= 0) return true;
+    }
+    int start, end;
+    int found = run.run(RUN_FIRST, *pos, endPos, budget, &start, &end);
+    if (found < 0) {
+      *pos = start;
+      return true;
+    }
+    if (!found) break;
+    if (matchCB && !matchCB(start, end, cbArg)) {
+      *pos = end;
+      return false;
+    }
+    *pos = next_search(run, start, end, endPos);
+  }
+  *pos = endPos;
+  return false;
+}
+
+//
+// End of "$Id$".
+//
@@ -86,6 +86,7 @@ static int inline min( int i1, int i2) {
 #define PRIMARY_MASK      0x0400
 #define HIGHLIGHT_MASK    0x0800
 #define BG_ONLY_MASK      0x1000
+#define MATCH_MASK        0x2000
 #define STYLE_LOOKUP_MASK   0xff
 
 /* Maximum displayable line length (how many characters will fit across the
@@ -99,8 +100,6 @@ TextDisplay::TextDisplay(int X, int Y, int W, int H,  const char* l)
   : Group(X, Y, W, H, l), text_area(W,H) {
   int i;
 
-  damage_range1_start = damage_range1_end = -1;
-  damage_range2_start = damage_range2_end = -1;
   dragpos_ = dragtype_ = dragging_ = 0;
 
   begin();
@@ -144,11 +143,24 @@ TextDisplay::TextDisplay(int X, int Y, int W, int H,  const char* l)
   for (i=1; i<visiblelines_cnt_; i++) {
     linestarts_[i] = -1;
   }
+  linedamage_ = new int[2 * visiblelines_cnt_];
+  for (i=0; i<visiblelines_cnt_; i++) {
+    linedamage_[2*i] = INT_MAX;
+  }
+  linewidths_ = new int[2 * visiblelines_cnt_];
+  widthfont_ = 0;
+  widthsize_ = 0;
+  forget_widths_();
+  scrolldy_ = 0;
   suppressresync_ = false;
   nlinesdeleted_ = 0;
   unfinished_style_ = 0;
   unfinished_highlight_cb_ = 0;
   highlight_cbarg_ = 0;
+  highlighter_ = 0;
+  matcher_ = 0;
+  match_color_ = YELLOW;
+  wrapindex_ = 0;
   continuous_wrap_ = 0;
   wrapmargin_ = 0;
   nlinesdeleted_ = 0;
@@ -168,6 +180,9 @@ TextDisplay::TextDisplay(int X, int Y, int W, int H,  const char* l)
 ** freed, nor are the style buffer or style table.
 */
 TextDisplay::~TextDisplay() {
+  highlight_delete_(0);
+  matches_delete_();
+  wrap_delete_();
   if (own_buffer) {
     delete buffer_;
   } else if (buffer_) {
@@ -175,6 +190,8 @@ TextDisplay::~TextDisplay() {
     buffer_->remove_predelete_callback(buffer_predelete_cb, this);
   }
   if (linestarts_) delete[] linestarts_;
+  if (linedamage_) delete[] linedamage_;
+  if (linewidths_) delete[] linewidths_;
 }
 
 /*
@@ -185,6 +202,8 @@ void TextDisplay::buffer(TextBuffer *buf) {
 
   /* If the text display is already displaying a buffer, clear it off
      of the display and remove our callback from it */
+  highlight_buffer_(0);
+  matches_buffer_(0);
   if (own_buffer) {
     delete buffer_;
     own_buffer = 0;
@@ -201,6 +220,10 @@ void TextDisplay::buffer(TextBuffer *buf) {
   if (buffer_) {
     buffer_->add_modify_callback(buffer_modified_cb, this);
     buffer_->add_predelete_callback(buffer_predelete_cb, this);
+    highlight_buffer_(buffer_);
+    matches_buffer_(buffer_);
+    /* the lines are added to the index as though they were inserted */
+    if (continuous_wrap_) wrap_reset_(1);
 
     /* Update the display */
     buffer_modified_cb(0, buf->length(), 0, 0, 0, this);
@@ -228,6 +251,7 @@ void TextDisplay::highlight_data(TextBuffer *styleBuffer,
 				 StyleTableEntry *styleTable,
 				 int nStyles, char unfinishedStyle,
 				 UnfinishedStyleCb unfinishedHighlightCB, void *cbArg) {
+  highlight_delete_(styleBuffer);
   stylebuffer_ = styleBuffer;
   styletable_ = styleTable;
   numstyles_ = nStyles;
@@ -236,6 +260,7 @@ void TextDisplay::highlight_data(TextBuffer *styleBuffer,
   highlight_cbarg_ = cbArg;
 
   stylebuffer_->canUndo(0);
+  forget_widths_();
 
   /* Relayout/redraw widget */
   relayout();
@@ -244,11 +269,26 @@ void TextDisplay::highlight_data(TextBuffer *styleBuffer,
 
 int TextDisplay::longest_vline() {
   int longest = 0;
-  for (int i = 0; i < visiblelines_cnt_; i++)
-    longest = max(longest, measure_vline(i));
+  for (int i = 0; i < visiblelines_cnt_; i++) {
+    /* only measure the lines that changed since they were measured */
+    int *w = linewidths_ + 2 * i;
+    if (w[0] != linestarts_[i]) {
+      w[0] = linestarts_[i];
+      w[1] = measure_vline(i);
+    }
+    longest = max(longest, w[1]);
+  }
   return longest;
 }
 
+/* Measure all the visible lines again in the next longest_vline(), for
+   when the fonts change or too much of the text changed to keep track */
+void TextDisplay::forget_widths_() {
+  for (int i = 0; i < visiblelines_cnt_; i++) linewidths_[2*i] = -2;
+  widthfont_ = textfont();
+  widthsize_ = textsize();
+}
+
 /*
 ** Change the size of the displayed text area
 */
@@ -276,6 +316,9 @@ void TextDisplay::layout() {
     return;
   }
 
+  Rectangle oldarea(text_area);
+  int oldsize = maxsize_;
+
   text_area.set(area.x()+LEFT_MARGIN,
                 area.y()+TOP_MARGIN, 
                 area.w()-LEFT_MARGIN-RIGHT_MARGIN,
@@ -343,9 +386,10 @@ void TextDisplay::layout() {
        the top character no longer pointing at a valid line start */
     if (continuous_wrap_ && !wrapmargin_ && ldamage&LAYOUT_W) {
       int oldFirstChar = firstchar_;
-      bufferlines_cnt_ = count_lines(0, buffer()->length(), true);
+      forget_widths_();
+      wrap_reset_();
       firstchar_ = line_start(firstchar_);
-      topline_num_ = count_lines(0, firstchar_, true)+1;
+      wrap_sync_();
       absolute_top_line_number(oldFirstChar);
     }
  
@@ -356,8 +400,18 @@ void TextDisplay::layout() {
     if (visiblelines_cnt_ < nvlines) {
       if (linestarts_) delete[] linestarts_;
       linestarts_ = new int [nvlines];
+      if (linedamage_) delete[] linedamage_;
+      linedamage_ = new int [2 * nvlines];
+      if (linewidths_) delete[] linewidths_;
+      linewidths_ = new int [2 * nvlines];
     }
-    visiblelines_cnt_ = nvlines;
+    if (visiblelines_cnt_ != nvlines) {
+      for (i = 0; i < nvlines; i++) linedamage_[2*i] = INT_MAX;
+      redraw(DAMAGE_EXPOSE);
+      visiblelines_cnt_ = nvlines;
+      forget_widths_();
+    } else if (widthfont_ != textfont() || widthsize_ != textsize())
+      forget_widths_();
 
     calc_line_starts(0, visiblelines_cnt_);
     calc_last_char();
@@ -434,6 +488,12 @@ void TextDisplay::layout() {
     }
   }
 
+  // text drawn at the old place or size cannot be scrolled
+  if (text_area.x() != oldarea.x() || text_area.y() != oldarea.y() ||
+      text_area.w() != oldarea.w() || text_area.h() != oldarea.h() ||
+      maxsize_ != oldsize)
+    redraw(DAMAGE_EXPOSE);
+
   // everything will fit in the viewport
   if (bufferlines_cnt_ < visiblelines_cnt_-1 || buffer_ == NULL || buffer_->length() == 0) {
     scroll_(1, horiz_offset_);
@@ -474,28 +534,80 @@ void TextDisplay::draw_text(int left, int top, int width, int height) {
   }
 }
 
+/*
+ * Mark the text between buffer positions "start" and "end" to be redrawn
+ * by the next draw().  Each visible line remembers the range of its
+ * characters that changed, so only the lines that changed are drawn, no
+ * matter how many separate places in the display are marked.
+ */
 void TextDisplay::redisplay_range(int startpos, int endpos) {
+  int i, startLine, lastLine, startIndex, endIndex;
 
   startpos = find_prev_char(startpos-1);
   endpos   = find_next_char(endpos+1);
 
-  if (damage_range1_start == -1 && damage_range1_end == -1) {
-    damage_range1_start = startpos;
-    damage_range1_end = endpos;
-  } else if ((startpos >= damage_range1_start && startpos <= damage_range1_end) ||
-	     (endpos >= damage_range1_start && endpos <= damage_range1_end)) {
-    damage_range1_start = min(damage_range1_start, startpos);
-    damage_range1_end = max(damage_range1_end, endpos);
-  } else if (damage_range2_start == -1 && damage_range2_end == -1) {
-    damage_range2_start = startpos;
-    damage_range2_end = endpos;
+  /* If the range is outside of the displayed text, just return */
+  if (endpos < firstchar_ || ( startpos > lastchar_ &&
+			       !empty_vlines())) return;
+
+  /* Clean up the starting and ending values */
+  if (startpos < 0) startpos = 0;
+  if (startpos > buffer_->length()) startpos = buffer_->length();
+  if (endpos < 0) endpos = 0;
+  if (endpos > buffer_->length()) endpos = buffer_->length();
+
+  /* Get the starting and ending lines */
+  if (startpos < firstchar_)
+    startpos = firstchar_;
+  if (!position_to_line(startpos, &startLine))
+    startLine = visiblelines_cnt_ - 1;
+  if (endpos >= lastchar_) {
+    lastLine = visiblelines_cnt_ - 1;
+  } else {
+    if (!position_to_line( endpos, &lastLine)) {
+      /* shouldn't happen */
+      lastLine = visiblelines_cnt_ - 1;
+    }
+  }
+
+  /* Get the starting and ending positions within the lines */
+  startIndex = linestarts_[ startLine ] == -1 ? 0 :
+    startpos - linestarts_[ startLine ];
+  if (endpos >= lastchar_)
+    endIndex = INT_MAX;
+  else if (linestarts_[lastLine] == -1)
+    endIndex = 0;
+  else
+    endIndex = endpos - linestarts_[lastLine];
+
+  /* The lines drawn differently may also be a different width */
+  for (i = startLine; i <= lastLine; i++)
+    linewidths_[2*i] = -2;
+
+  if (startLine == lastLine) {
+    damage_vline_(startLine, startIndex, endIndex);
   } else {
-    damage_range2_start = min(damage_range2_start, startpos);
-    damage_range2_end = max(damage_range2_end, endpos);
+    damage_vline_(startLine, startIndex, INT_MAX);
+    for (i = startLine + 1; i < lastLine; i++)
+      damage_vline_(i, 0, INT_MAX);
+    damage_vline_(lastLine, 0, endIndex);
   }
   redraw(DAMAGE_SCROLL);
 }
 
+/* Add characters of a visible line to the ones draw() will redraw */
+void TextDisplay::damage_vline_(int visLineNum, int leftCharIndex,
+				int rightCharIndex) {
+  int *d = linedamage_ + 2 * visLineNum;
+  if (d[0] == INT_MAX) {
+    d[0] = leftCharIndex;
+    d[1] = rightCharIndex;
+  } else {
+    d[0] = min(d[0], leftCharIndex);
+    d[1] = max(d[1], rightCharIndex);
+  }
+}
+
 /*
  * Refresh all of the text between buffer positions "start" and "end"
  * not including the character at the position "end".
@@ -604,18 +716,27 @@ void TextDisplay::wrap_mode(bool wrap, int wrapMargin) {
   continuous_wrap_ = wrap;
 
   /* wrapping can change change the total number of lines, re-count */
-  bufferlines_cnt_ = count_lines(0, buffer()->length(), true);
+  if (wrap)
+    wrap_reset_();
+  else {
+    wrap_delete_();
+    bufferlines_cnt_ = count_lines(0, buffer()->length(), true);
+  }
 
   /* changing wrap margins wrap or changing from wrapped mode to non-wrapped
      can leave the character at the top no longer at a line start, and/or
      change the line number */
   firstchar_ = line_start(firstchar_);
-  topline_num_ = count_lines(0, firstchar_, true) + 1;
+  if (wrap)
+    wrap_sync_();
+  else
+    topline_num_ = count_lines(0, firstchar_, true) + 1;
   reset_absolute_top_line_number();
 
   /* update the line starts array */
   calc_line_starts(0, visiblelines_cnt_);
   calc_last_char();
+  forget_widths_();
 
   relayout();
   redraw();
@@ -868,11 +989,16 @@ void TextDisplay::display_insert() {
   topLine = topline_num_;
 
   if (cursor_pos_ < firstchar_) {
-    topLine -= count_lines(cursor_pos_, firstchar_, false);
+    if (continuous_wrap_)
+      topLine = wrap_row_(cursor_pos_) + 1;
+    else
+      topLine -= count_lines(cursor_pos_, firstchar_, false);
   } else if (cursor_pos_ > lastChar && !empty_vlines()) {
-    topLine += count_lines(lastChar -
-            (wrap_uses_character(lastChar) ? 0 : 1),
-            cursor_pos_, false);
+    int from = lastChar - (wrap_uses_character(lastChar) ? 0 : 1);
+    if (continuous_wrap_)
+      topLine += wrap_row_(cursor_pos_) - wrap_row_(from);
+    else
+      topLine += count_lines(from, cursor_pos_, false);
   } else if (cursor_pos_ == lastChar && !empty_vlines() &&
             !wrap_uses_character(lastChar)) {
     topLine++;
@@ -1214,6 +1340,39 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   if (nInserted != 0 || nDeleted != 0)
     textD->cursor_preferred_col_ = -1;
 
+  if (textD->continuous_wrap_ && (nInserted != 0 || nDeleted != 0))
+    textD->wrap_modified_(pos, nInserted, nDeleted, deletedText);
+
+  /* The deleted lines can only be counted in continuous wrap mode with
+     proportional fonts if buffer_predelete_cb() measured them first. It
+     is not called for a batch of edits (see TextBuffer::begin_batch()),
+     so find the display lines again as wrap_mode() does. */
+  if (textD->continuous_wrap_ && textD->fixed_fontwidth_ == -1 &&
+      !textD->suppressresync_ && (nInserted != 0 || nDeleted != 0)) {
+    if (textD->cursor_hint_ != NO_HINT) {
+      textD->cursor_pos_ = textD->cursor_hint_;
+      textD->cursor_hint_ = NO_HINT;
+    } else if (textD->cursor_pos_ > pos) {
+      if (textD->cursor_pos_ < pos + nDeleted)
+	textD->cursor_pos_ = pos;
+      else
+	textD->cursor_pos_ += nInserted - nDeleted;
+    }
+    if (pos + nDeleted <= oldFirstChar)
+      textD->firstchar_ += nInserted - nDeleted;
+    else if (pos < oldFirstChar)
+      textD->firstchar_ = pos;
+    textD->firstchar_ = textD->line_start(textD->firstchar_);
+    textD->wrap_sync_();
+    textD->reset_absolute_top_line_number();
+    textD->calc_line_starts(0, textD->visiblelines_cnt_);
+    textD->calc_last_char();
+    textD->forget_widths_();
+    textD->relayout();
+    textD->redraw();
+    return;
+  }
+
   /* Count the number of lines inserted and deleted, and in the case
      of continuous wrap mode, how much has changed */
   if (textD->continuous_wrap_) {
@@ -1250,6 +1409,8 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
 
   /* Update the line count for the whole buffer */
   textD->bufferlines_cnt_ += linesInserted - linesDeleted;
+  if (textD->continuous_wrap_ && (nInserted != 0 || nDeleted != 0))
+    textD->wrap_sync_();
 
   /* Update the cursor position */
   if (textD->cursor_hint_ != NO_HINT) {
@@ -1266,10 +1427,14 @@ void TextDisplay::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   textD->relayout();
 
   // don't need to do anything else if not visible?
-  if (!textD->visible_r()) return;
+  if (!textD->visible_r()) {
+    textD->forget_widths_();
+    return;
+  }
 
   /* If the changes caused scrolling, re-paint everything and we're done. */
   if (scrolled) {
+    textD->forget_widths_();
     textD->redraw();
     if (textD->stylebuffer_) {   /* See comments in extendRangeForStyleMods */
       textD->stylebuffer_->primary_selection()->selected(false);
@@ -1630,6 +1795,8 @@ void TextDisplay::draw_string( int style, int X, int Y, int toX,
     } else {
       background = lerp(color(), selection_color(), 0.5f);
     }
+  } else if (style & MATCH_MASK) {
+    background = match_color_;
   } else {
     background = color();
   }
@@ -1650,7 +1817,7 @@ void TextDisplay::draw_string( int style, int X, int Y, int toX,
     font  = styleRec->font;
     fsize = styleRec->size;
     foreground = contrast(styleRec->color, background);
-  } else if (style & (HIGHLIGHT_MASK | PRIMARY_MASK)) {
+  } else if (style & (HIGHLIGHT_MASK | PRIMARY_MASK | MATCH_MASK)) {
     foreground = contrast(textcolor(), background);
   } else {
     foreground = textcolor();
@@ -1830,6 +1997,8 @@ int TextDisplay::position_style( int lineStartPos,
     style |= HIGHLIGHT_MASK;
   if (buf->secondary_selection()->includes(pos, lineStartPos, dispIndex))
     style |= SECONDARY_MASK;
+  if (matcher_ && lineIndex < lineLen && in_match_(pos))
+    style |= MATCH_MASK;
 
   return style;
 }
@@ -1970,33 +2139,53 @@ void TextDisplay::offset_line_starts(int newTopLineNum) {
      known line start (start or end of buffer, or the closest value in the
      lineStarts array) */
   lastLineNum = oldTopLineNum + nVisLines - 1;
-  if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
-    firstchar_ = skip_lines(0, newTopLineNum - 1, true);
-  } else if (newTopLineNum < oldTopLineNum) {
-    firstchar_ = rewind_lines(firstchar_, -lineDelta);
-  } else if (newTopLineNum < lastLineNum) {
+  if (newTopLineNum > oldTopLineNum && newTopLineNum < lastLineNum) {
     firstchar_ = lineStarts[newTopLineNum - oldTopLineNum];
-  } else if (newTopLineNum - lastLineNum < bufferlines_cnt_ - newTopLineNum) {
+  } else if (!continuous_wrap_) {
+    /* The buffer's line index finds any line without counting */
+    firstchar_ = buf->line_to_position(newTopLineNum - 1);
+  } else if (newTopLineNum < oldTopLineNum && -lineDelta < nVisLines) {
+    firstchar_ = rewind_lines(firstchar_, -lineDelta);
+  } else if (newTopLineNum > oldTopLineNum &&
+	     newTopLineNum - lastLineNum < nVisLines &&
+	     lineStarts[nVisLines - 1] != -1) {
     firstchar_ = skip_lines(lineStarts[ nVisLines - 1 ], newTopLineNum - lastLineNum, true);
   } else {
-    firstchar_ = rewind_lines(buf->length(), bufferlines_cnt_ - newTopLineNum + 1);
+    /* The wrapped line index finds any row without measuring the text
+       before it */
+    firstchar_ = wrap_row_start_(newTopLineNum - 1);
   }
 
-  /* Fill in the line starts array */
+  /* Fill in the line starts array, the lines waiting to be redrawn move
+     with them */
   if (lineDelta < 0 && -lineDelta < nVisLines) {
     for (i = nVisLines - 1; i >= -lineDelta; i--)
       lineStarts[i] = lineStarts[i + lineDelta];
+    memmove(linedamage_ - 2 * lineDelta, linedamage_,
+	    2 * (nVisLines + lineDelta) * sizeof(int));
+    memmove(linewidths_ - 2 * lineDelta, linewidths_,
+	    2 * (nVisLines + lineDelta) * sizeof(int));
+    for (i = 0; i < -lineDelta; i++) linedamage_[2*i] = INT_MAX;
     calc_line_starts(0, -lineDelta);
   } else if (lineDelta > 0 && lineDelta < nVisLines) {
     for (i = 0; i < nVisLines - lineDelta; i++)
       lineStarts[i] = lineStarts[ i + lineDelta ];
+    memmove(linedamage_, linedamage_ + 2 * lineDelta,
+	    2 * (nVisLines - lineDelta) * sizeof(int));
+    memmove(linewidths_, linewidths_ + 2 * lineDelta,
+	    2 * (nVisLines - lineDelta) * sizeof(int));
+    for (i = nVisLines - lineDelta; i < nVisLines; i++)
+      linedamage_[2*i] = INT_MAX;
     calc_line_starts(nVisLines - lineDelta, nVisLines - 1);
-  } else
+  } else {
+    for (i = 0; i < nVisLines; i++) linedamage_[2*i] = INT_MAX;
     calc_line_starts(0, nVisLines);
+  }
 
   /* Set lastChar and topline_num_ */
   calc_last_char();
   topline_num_ = newTopLineNum;
+  if (continuous_wrap_) wrap_sync_();
 
   /* If we're numbering lines or being asked to maintain an absolute line
      number, re-calculate the absolute line number */
@@ -2042,7 +2231,9 @@ void TextDisplay::update_line_starts(int pos, int charsInserted,
       if (topline_num_ > bufferlines_cnt_ + lineDelta) {
 	topline_num_ = 1;
 	firstchar_ = 0;
-      } else
+      } else if (continuous_wrap_)
+	firstchar_ = wrap_row_start_(topline_num_ - 1);
+      else
 	firstchar_ = skip_lines(0, topline_num_ - 1, true);
     }
     calc_line_starts(0, nVisLines - 1);
@@ -2201,8 +2392,20 @@ void TextDisplay::scroll_(int topLineNum, int horizOffset) {
 
   /* If the vertical scroll position has changed, update the line
      starts array and related counters in the text display */
+  int lineDelta = topLineNum - topline_num_;
   offset_line_starts(topLineNum);
 
+  /* If only the top line changed, and by less than a screen, draw() moves
+     the text already drawn and draws only the lines scrolled into view.
+     The cursor is drawn again, as its protrusions are not moved. */
+  if (horiz_offset_ == horizOffset && lineDelta > -visiblelines_cnt_ &&
+      lineDelta < visiblelines_cnt_ && !(damage() & (DAMAGE_ALL|DAMAGE_EXPOSE))) {
+    scrolldy_ -= lineDelta * maxsize_;
+    redisplay_range(cursor_pos_ - 1, cursor_pos_ + 1);
+    redraw(DAMAGE_VALUE);
+    return;
+  }
+
   /* Just setting horiz_offset_ is enough information for redisplay */
   horiz_offset_ = horizOffset;
 
@@ -2974,7 +3177,7 @@ void TextDisplay::draw(void) {
   update_child(*vscrollbar);
   update_child(*hscrollbar);
 
-  if (damage() & (DAMAGE_ALL | DAMAGE_EXPOSE | DAMAGE_SCROLL)) {
+  if (damage() & (DAMAGE_ALL | DAMAGE_EXPOSE | DAMAGE_SCROLL | DAMAGE_VALUE)) {
     // erase cursor artifacts
     blank_cursor_protrusions();
   }
@@ -2989,20 +3192,41 @@ void TextDisplay::draw(void) {
     if (linenumwidth_ != 0) {
       draw_line_numbers(false);
     }
+    scrolldy_ = 0;
+    for (int i = 0; i < visiblelines_cnt_; i++) linedamage_[2*i] = INT_MAX;
+    return;
+  }
+
+  if (scrolldy_) {
+    // move the text that is still visible, draw the lines scrolled in
+    fltk::scrollrect(text_area, 0, scrolldy_, draw_area_cb, this);
+    scrolldy_ = 0;
+    if (linenumwidth_ != 0) {
+      draw_line_numbers(false);
+    }
   }
-  else if (damage() & DAMAGE_SCROLL) {
+
+  if (damage() & DAMAGE_SCROLL) {
     fltk::push_clip(text_area);
-    // draw some lines of text
-    draw_range(damage_range1_start, damage_range1_end);
-    if (damage_range2_end != -1) {
-      draw_range(damage_range2_start, damage_range2_end);
+    // draw the changed parts of the lines
+    for (int i = 0; i < visiblelines_cnt_; i++) {
+      int *d = linedamage_ + 2 * i;
+      if (d[0] == INT_MAX) continue;
+      draw_vline(i, 0, INT_MAX, d[0], d[1]);
+      d[0] = INT_MAX;
     }
-    damage_range1_start = damage_range1_end = -1;
-    damage_range2_start = damage_range2_end = -1;
     fltk::pop_clip();
   }
 }
 
+// Called by scrollrect() to draw the text scrolled into view.
+void TextDisplay::draw_area_cb(void *v, const Rectangle &r) {
+  TextDisplay *d = (TextDisplay *)v;
+  fltk::push_clip(r);
+  d->draw_text(r.x(), r.y(), r.w(), r.h());
+  fltk::pop_clip();
+}
+
 // this processes drag events due to mouse for TextDisplay and
 // also drags due to cursor movement with shift held down for
 // TextEditor
@@ -0,0 +1,340 @@
+//
+// "$Id$"
+//
+// Incremental syntax highlighting for the TextDisplay class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+/* The text is styled one line at a time by a function that is given
+   the state the previous line ended in (such as "inside a comment") and
+   returns the state this line ends in.  The state at the start of every
+   line is kept, so after an edit the lines can be restyled starting at
+   the edited one, and the work stops as soon as a line after the edit
+   ends in the same state it did before, because every line after that
+   must be styled the same as it was.
+
+   The work is done from a check callback, which fltk calls before it
+   redraws the screen, and from an idle callback if there is too much to
+   do at once.  Only the lines up to a screen below the visible ones are
+   styled, lines further down are left until they are scrolled to. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fltk/run.h>
+#include <fltk/TextDisplay.h>
+
+using namespace fltk;
+
+/* Most bytes of text styled each time the check callback is called,
+   before the screen is redrawn */
+#define HIGHLIGHT_CHECK_BYTES (256*1024)
+
+/* Most bytes of text styled each time the idle callback is called */
+#define HIGHLIGHT_IDLE_BYTES (32*1024)
+
+namespace fltk {
+
+class TextHighlighter {
+public:
+  TextHighlighter(TextDisplay *display, TextHighlightCb cb, void *arg);
+  ~TextHighlighter();
+  void attach(TextBuffer *buffer);
+
+  TextBuffer style;	/* the style buffer given to the display */
+
+private:
+  TextDisplay *display_;
+  TextBuffer *buffer_;
+  TextHighlightCb cb_;
+  void *arg_;
+  int *states_;		/* state at the start of each line */
+  int lines_, statessize_;
+  int dirty_;		/* first line that may be styled wrong, or -1 */
+  int changed_;		/* no line from here on was changed since it was
+			   styled, and states_ follow from each other */
+  int unstyled_;	/* lines from here on were never styled, lines_
+			   once the whole text has been */
+  char *text_, *styles_; /* one line, if it is not contiguous in memory */
+  int scratchsize_;
+
+  static void modified_cb(int pos, int nInserted, int nDeleted,
+                          int nRestyled, const char *deletedText, void *v);
+  static void check_cb(void *v);
+  static void idle_cb(void *v);
+  void reset();
+  void modified(int pos, int nInserted, int nDeleted, const char *deleted);
+  int limit();
+  void work(int bytes);
+  const char *range(TextBuffer *b, int start, int end, char *scratch);
+};
+
+} /* namespace fltk */
+
+TextHighlighter::TextHighlighter(TextDisplay *display, TextHighlightCb cb,
+                                 void *arg)
+  : display_(display), buffer_(0), cb_(cb), arg_(arg),
+    states_(0), lines_(0), statessize_(0), dirty_(-1), changed_(0),
+    unstyled_(0), text_(0), styles_(0), scratchsize_(0) {
+  style.canUndo(0);
+}
+
+TextHighlighter::~TextHighlighter() {
+  attach(0);
+  free(states_);
+  free(text_);
+  free(styles_);
+}
+
+/* Stop styling the current buffer, and start styling this one */
+void TextHighlighter::attach(TextBuffer *buffer) {
+  if (buffer_) {
+    buffer_->remove_modify_callback(modified_cb, this);
+    remove_check(check_cb, this);
+    remove_idle(idle_cb, this);
+  }
+  buffer_ = buffer;
+  if (buffer_) {
+    buffer_->add_modify_callback(modified_cb, this);
+    reset();
+  }
+}
+
+/* Forget all the styles, everything will be styled again */
+void TextHighlighter::reset() {
+  int n = buffer_->length();
+  char *s = (char *)malloc(n + 1);
+  memset(s, 'A', n);
+  s[n] = 0;
+  style.text(s);
+  free(s);
+  lines_ = buffer_->count_lines(0, n) + 1;
+  if (lines_ > statessize_) {
+    statessize_ = lines_;
+    states_ = (int *)realloc(states_, statessize_ * sizeof(int));
+  }
+  memset(states_, 0, lines_ * sizeof(int));
+  dirty_ = 0;
+  changed_ = lines_;
+  unstyled_ = 0;
+  if (!has_check(check_cb, this)) add_check(check_cb, this);
+}
+
+void TextHighlighter::modified_cb(int pos, int nInserted, int nDeleted,
+                                  int, const char *deletedText, void *v) {
+  ((TextHighlighter *)v)->modified(pos, nInserted, nDeleted, deletedText);
+}
+
+/* Make the style buffer match the edit, move the states of the lines
+   after it, and mark the edited lines as needing to be styled */
+void TextHighlighter::modified(int pos, int nInserted, int nDeleted,
+                               const char *deleted) {
+  if (!nInserted && !nDeleted) return;
+  if (nDeleted && !deleted) {reset(); return;}
+
+  char *s = (char *)malloc(nInserted + 1);
+  memset(s, 'A', nInserted);
+  s[nInserted] = 0;
+  style.replace(pos, pos + nDeleted, s);
+  free(s);
+
+  int line = buffer_->position_to_line(pos);
+  int del = 0;
+  for (int i = 0; i < nDeleted; i++)
+    if (deleted[i] == '\n') del++;
+  int ins = buffer_->count_lines(pos, pos + nInserted);
+
+  int n = lines_ + ins - del;
+  if (n > statessize_) {
+    statessize_ = n > 2 * statessize_ ? n : 2 * statessize_;
+    states_ = (int *)realloc(states_, statessize_ * sizeof(int));
+  }
+  memmove(states_ + line + 1 + ins, states_ + line + 1 + del,
+          (lines_ - line - 1 - del) * sizeof(int));
+  lines_ = n;
+
+  if (unstyled_ > line + del) unstyled_ += ins - del;
+  else if (unstyled_ > line) unstyled_ = line;
+  if (line >= unstyled_) {
+    /* styling the rest of the text will get to it */
+    if (dirty_ < 0 || dirty_ > line) dirty_ = line;
+  } else if (dirty_ < 0 || dirty_ >= unstyled_) {
+    /* only the lines never styled were left, so stop at the first line
+       after the edit that ends the same as before, then go on with them */
+    dirty_ = line;
+    changed_ = line + ins + 1;
+  } else {
+    if (dirty_ > line) dirty_ = line;
+    if (changed_ > line + del) changed_ += ins - del;
+    if (changed_ < line + ins + 1) changed_ = line + ins + 1;
+  }
+  if (!has_check(check_cb, this)) add_check(check_cb, this);
+}
+
+/* Lines starting after this position are not styled yet */
+int TextHighlighter::limit() {
+  int n = display_->lastchar_ - display_->firstchar_;
+  if (n > INT_MAX - display_->lastchar_) return INT_MAX;
+  return display_->lastchar_ + n;
+}
+
+/* Return the text between start and end, which is contiguous in the
+   buffer's memory, or is copied to scratch */
+const char *TextHighlighter::range(TextBuffer *b, int start, int end,
+                                   char *scratch) {
+  int chunkstart, chunklength;
+  const char *c = b->chunk(start, &chunkstart, &chunklength);
+  if (end <= chunkstart + chunklength) return c + start - chunkstart;
+  for (int pos = start; pos < end; pos = chunkstart + chunklength) {
+    c = b->chunk(pos, &chunkstart, &chunklength);
+    int n = chunkstart + chunklength < end ? chunkstart + chunklength : end;
+    memcpy(scratch + pos - start, c + pos - chunkstart, n - pos);
+  }
+  return scratch;
+}
+
+/* Style the dirty lines that are not past limit(), until about this
+   many bytes have been styled */
+void TextHighlighter::work(int bytes) {
+  if (dirty_ < 0) return;
+  int line = dirty_;
+  int pos = buffer_->line_to_position(line);
+  int state = states_[line];
+  int lim = limit();
+  int redrawstart = -1, redrawend = -1;
+  while (pos <= lim && bytes > 0) {
+    int end = buffer_->line_end(pos);
+    bool last = end >= buffer_->length();
+    if (!last) end++;		/* the newline is styled too */
+    int n = end - pos;
+    if (n >= scratchsize_) {
+      scratchsize_ = n + 1 > 2 * scratchsize_ ? n + 1 : 2 * scratchsize_;
+      text_ = (char *)realloc(text_, scratchsize_);
+      styles_ = (char *)realloc(styles_, scratchsize_);
+    }
+    if (n) {
+      const char *text = range(buffer_, pos, end, text_);
+      state = cb_(text, n, styles_, state, arg_);
+      char *old = text_;		/* text is not needed any more */
+      if (memcmp(range(&style, pos, end, old), styles_, n)) {
+        styles_[n] = 0;
+        style.replace(pos, end, styles_);
+        if (redrawstart < 0) redrawstart = pos;
+        redrawend = end;
+      }
+      bytes -= n;
+    }
+    if (last) {line = -1; break;}
+    line++;
+    pos = end;
+    if (line >= changed_ && line < unstyled_ && states_[line] == state) {
+      /* the rest was styled before, go on with what never was */
+      line = unstyled_ < lines_ ? unstyled_ : -1;
+      break;
+    }
+    states_[line] = state;
+  }
+  if (line < 0) unstyled_ = lines_;
+  else if (line > unstyled_) unstyled_ = line;
+  dirty_ = line;
+  if (line >= 0 && line > changed_) changed_ = line;
+  if (redrawstart >= 0) display_->redisplay_range(redrawstart, redrawend);
+}
+
+/* Called before the screen is redrawn */
+void TextHighlighter::check_cb(void *v) {
+  TextHighlighter *h = (TextHighlighter *)v;
+  h->work(HIGHLIGHT_CHECK_BYTES);
+  if (h->dirty_ < 0) {
+    remove_check(check_cb, v);
+    remove_idle(idle_cb, v);
+  } else if (h->buffer_->line_to_position(h->dirty_) <= h->limit()) {
+    /* there is more to do on the screen, do it without waiting */
+    if (!has_idle(idle_cb, v)) add_idle(idle_cb, v);
+  }
+  /* otherwise the check stays, so scrolling starts the work again */
+}
+
+void TextHighlighter::idle_cb(void *v) {
+  TextHighlighter *h = (TextHighlighter *)v;
+  h->work(HIGHLIGHT_IDLE_BYTES);
+  if (h->dirty_ < 0 || h->buffer_->line_to_position(h->dirty_) > h->limit())
+    remove_idle(idle_cb, v);
+}
+
+/**
+ * Style the text with a function that styles one line at a time. This
+ * is an easier and much faster alternative to highlight_data() for
+ * syntax highlighting.
+ *
+ * \a cb is called with the text of a line, including the newline at the
+ * end, and must put a style character ('A' for the first entry in
+ * \a styleTable, 'B' for the next and so on) for each byte into \a style.
+ * It is also given the state the previous line ended in, which is zero for
+ * the first line, and must return the state this line ends in. The
+ * state is any number the function wants, such as one meaning the line
+ * ended inside a comment.
+ *
+ * After each edit the lines are styled again from the edited one until
+ * a line ends in the same state it did before, so typing only restyles
+ * the line it is on. This is done before the screen is redrawn, and if
+ * there is a lot to do it is continued in idle callbacks, so the display
+ * does not stop responding. Lines more than a screen below the visible
+ * ones are not styled until they are scrolled to.
+ *
+ * The style buffer is created and kept by the display. Passing NULL for
+ * \a cb turns the highlighting off.
+ */
+void TextDisplay::highlight(StyleTableEntry *styleTable, int nStyles,
+                            TextHighlightCb cb, void *arg) {
+  delete highlighter_;
+  highlighter_ = 0;
+  if (!cb) {
+    stylebuffer_ = 0;
+    forget_widths_();
+    relayout();
+    redraw();
+    return;
+  }
+  highlighter_ = new TextHighlighter(this, cb, arg);
+  highlighter_->attach(buffer_);
+  highlight_data(&highlighter_->style, styleTable, nStyles, 0, 0, 0);
+}
+
+/* Called when the buffer is changed */
+void TextDisplay::highlight_buffer_(TextBuffer *buf) {
+  if (highlighter_) highlighter_->attach(buf);
+}
+
+/* Called when highlight_data() is given a different style buffer, and
+   with NULL by the destructor */
+void TextDisplay::highlight_delete_(TextBuffer *styleBuffer) {
+  if (highlighter_ && styleBuffer != &highlighter_->style) {
+    delete highlighter_;
+    highlighter_ = 0;
+  }
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,565 @@
+//
+// "$Id$"
+//
+// Highlighting every match of a string in the TextDisplay class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+/* The matches are kept as a sorted array of where each one starts, all
+   of them are as long as the string, so drawing and finding the next
+   or previous match are binary searches.  Matches may overlap, so each
+   one only depends on the text it covers, and an edit only changes the
+   matches near it.
+
+   The buffer is searched in slices.  A timeout in the main thread copies
+   the next few slices into jobs, and threads search the copies, so the
+   buffer itself is only ever touched by the main thread.  The timeout
+   adds the matches of the finished jobs in order, so everything before
+   the first unfinished job has been searched, and redraws the visible
+   ones.
+
+   When the buffer is edited the matches after the edit are moved, the
+   ones it broke are removed and the text around it is searched again
+   right away.  The jobs after the edit are moved too, and a job whose
+   copy of the text was edited is searched again by the main thread
+   when its turn comes. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fltk/run.h>
+#include <fltk/TextDisplay.h>
+#include "TextSearch.h"
+
+#if HAVE_PTHREAD || (defined(_WIN32) && !defined(__CYGWIN__))
+# define USE_MATCH_THREADS 1
+# include <fltk/Threads.h>
+# if !defined(_WIN32) || defined(__CYGWIN__)
+#  include <unistd.h>
+# endif
+#else
+# define USE_MATCH_THREADS 0
+#endif
+
+using namespace fltk;
+
+/* Bytes of text searched by each job */
+#define MATCH_SLICE (1024*1024)
+
+/* Most jobs waiting for a thread or for the ones before them */
+#define MATCH_JOBS 32
+
+/* Most threads searching for one display */
+#define MATCH_THREADS 8
+
+/* How often the main thread collects the matches found, in seconds */
+#define MATCH_POLL_TIME .02f
+
+namespace fltk {
+
+class TextMatcher {
+public:
+  TextMatcher(TextDisplay *display, TextBuffer *buffer, const char *string,
+              bool matchcase, Text_Progress_Cb cb, void *arg);
+  void release();
+  void detach();
+
+  bool includes(int pos);
+  int find(int pos) const;
+  int count() const { return count_; }
+  int start(int i) const { return starts_[i]; }
+  int length() const { return search_.length(); }
+
+  char *string;
+  bool matchcase;
+  Text_Progress_Cb cb;
+  void *arg;
+
+private:
+  enum { WAITING, SEARCHING, DONE };
+  struct Job {
+    Job *next;
+    int state;		/* shared, protected by lock() */
+    /* used by the main thread */
+    int start, end;	/* where the matches can start in the buffer now */
+    bool stale;		/* the copied text was edited */
+    /* used by the thread searching it */
+    char *text;		/* copy of the text */
+    int size;		/* matches start in the first size bytes */
+    int length;		/* bytes copied, size plus enough for a match */
+    int *found;		/* where each match starts in the copy */
+    int nfound, foundsize;
+  };
+
+#if USE_MATCH_THREADS
+  Mutex mutex_;
+#endif
+  /* shared by the threads, protected by lock() */
+  Job *first_, *last_;	/* in order of where they are in the buffer */
+  Job *waiting_;	/* first job no thread has taken */
+  int running_;		/* threads searching */
+  bool quit_;
+  int refs_;		/* deleted when the display and all the threads
+			   have let go */
+
+  /* used by the main thread */
+  TextDisplay *display_;
+  TextBuffer *buffer_;
+  TextSearch search_;
+  int *starts_;		/* start of each match, sorted */
+  int count_, size_;
+  int hint_;		/* match includes() looked at last */
+  int searched_;	/* matches before here have all been found */
+  int queued_;		/* jobs have been made up to here */
+  int jobs_;		/* jobs in the list */
+  int threads_;		/* most threads to start */
+
+  ~TextMatcher();
+  void lock() {
+#if USE_MATCH_THREADS
+    mutex_.lock();
+#endif
+  }
+  void unlock() {
+#if USE_MATCH_THREADS
+    mutex_.unlock();
+#endif
+  }
+  bool add(int pos);
+  void search(Job *job) const;
+  void research(int start, int end);
+  void queue();
+  void merge();
+  void start_threads();
+  void poll();
+  void modified(int pos, int nInserted, int nDeleted);
+  static void *thread(void *v);
+  static void timeout_cb(void *v);
+  static void modified_cb(int pos, int nInserted, int nDeleted,
+                          int nRestyled, const char *deletedText, void *v);
+};
+
+} /* namespace fltk */
+
+#if USE_MATCH_THREADS
+/* Number of threads to search with, one for each processor */
+static int cpu_count() {
+# if defined(_WIN32) && !defined(__CYGWIN__)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = info.dwNumberOfProcessors;
+# elif defined(_SC_NPROCESSORS_ONLN)
+  int n = sysconf(_SC_NPROCESSORS_ONLN);
+# else
+  int n = 1;
+# endif
+  if (n < 1) n = 1;
+  return n > MATCH_THREADS ? MATCH_THREADS : n;
+}
+#else
+# define cpu_count() 0
+#endif
+
+TextMatcher::TextMatcher(TextDisplay *display, TextBuffer *buffer,
+                         const char *s, bool mc, Text_Progress_Cb c,
+                         void *a)
+  : matchcase(mc), cb(c), arg(a),
+    first_(0), last_(0), waiting_(0), running_(0), quit_(false), refs_(1),
+    display_(display), buffer_(buffer), search_(s, mc, false),
+    starts_(0), count_(0), size_(0), hint_(0), searched_(0), queued_(0),
+    jobs_(0), threads_(cpu_count()) {
+  string = strdup(s);
+  buffer_->add_modify_callback(modified_cb, this);
+  add_timeout(0, timeout_cb, this);
+}
+
+TextMatcher::~TextMatcher() {
+  while (first_) {
+    Job *job = first_;
+    first_ = job->next;
+    free(job->text);
+    free(job->found);
+    delete job;
+  }
+  free(starts_);
+  free(string);
+}
+
+/* Stop using the buffer, the matches are forgotten */
+void TextMatcher::detach() {
+  if (!buffer_) return;
+  buffer_->remove_modify_callback(modified_cb, this);
+  remove_timeout(timeout_cb, this);
+  buffer_ = 0;
+  count_ = 0;
+  lock();
+  quit_ = true;
+  unlock();
+}
+
+/* Called by the display instead of deleting this, the threads still
+   searching delete it when they are done */
+void TextMatcher::release() {
+  detach();
+  lock();
+  bool last = !--refs_;
+  unlock();
+  if (last) delete this;
+}
+
+/* Return the index of the first match that starts at or after pos */
+int TextMatcher::find(int pos) const {
+  int a = 0, b = count_;
+  while (a < b) {
+    int i = (a + b) / 2;
+    if (starts_[i] < pos) a = i + 1; else b = i;
+  }
+  return a;
+}
+
+/* Return true if a match includes the character at pos. This is called
+   for each character drawn, so it remembers the match it found and
+   tries that and the next one before searching. */
+bool TextMatcher::includes(int pos) {
+  if (!count_) return false;
+  int i = hint_;
+  if (i >= count_ || starts_[i] > pos) {
+    i = find(pos + 1) - 1;
+  } else if (i + 1 < count_ && starts_[i + 1] <= pos) {
+    i++;
+    if (i + 1 < count_ && starts_[i + 1] <= pos) i = find(pos + 1) - 1;
+  }
+  if (i < 0) return false;
+  hint_ = i;
+  return pos < starts_[i] + length();
+}
+
+/* Add a match, unless it was already found, and redraw it if it is
+   visible */
+bool TextMatcher::add(int pos) {
+  int m = length();
+  int i = find(pos);
+  if (i < count_ && starts_[i] == pos) return false;
+  if (count_ >= size_) {
+    size_ = size_ ? 2 * size_ : 1024;
+    starts_ = (int *)realloc(starts_, size_ * sizeof(int));
+  }
+  memmove(starts_ + i + 1, starts_ + i, (count_ - i) * sizeof(int));
+  starts_[i] = pos;
+  count_++;
+  if (pos < display_->lastchar_ && pos + m > display_->firstchar_)
+    display_->redisplay_range(pos, pos + m);
+  return true;
+}
+
+/* Find the matches in the copied text. This is called by the threads,
+   and only uses the job and the constant search_. */
+void TextMatcher::search(Job *job) const {
+  int m = search_.length();
+  int last = job->length - m;
+  if (last > job->size - 1) last = job->size - 1;
+  for (int w = 0; w <= last; w++) {
+    w = search_.find(job->text, w, last);
+    if (w < 0) break;
+    if (job->nfound >= job->foundsize) {
+      job->foundsize = job->foundsize ? 2 * job->foundsize : 256;
+      job->found = (int *)realloc(job->found, job->foundsize * sizeof(int));
+    }
+    job->found[job->nfound++] = w;
+  }
+  free(job->text);
+  job->text = 0;
+}
+
+/* Search the buffer for the matches that start between start and end,
+   in the main thread */
+void TextMatcher::research(int start, int end) {
+  int m = length();
+  int n = buffer_->length();
+  if (start < 0) start = 0;
+  if (end > n - m + 1) end = n - m + 1;
+  if (end <= start) return;
+  Job job;
+  job.text = buffer_->text_range(start, end + m - 1);
+  job.size = end - start;
+  job.length = end + m - 1 - start;
+  job.found = 0;
+  job.nfound = job.foundsize = 0;
+  search(&job);
+  for (int i = 0; i < job.nfound; i++) add(start + job.found[i]);
+  free(job.found);
+}
+
+/* Copy the next slices of the buffer into jobs */
+void TextMatcher::queue() {
+  int m = length();
+  int n = buffer_->length();
+  while (jobs_ < MATCH_JOBS && queued_ < n) {
+    Job *job = new Job;
+    job->next = 0;
+    job->state = WAITING;
+    job->start = queued_;
+    job->end = n - queued_ > MATCH_SLICE ? queued_ + MATCH_SLICE : n;
+    job->stale = false;
+    int copyend = n - job->end > m - 1 ? job->end + m - 1 : n;
+    job->text = buffer_->text_range(job->start, copyend);
+    job->size = job->end - job->start;
+    job->length = copyend - job->start;
+    job->found = 0;
+    job->nfound = job->foundsize = 0;
+    queued_ = job->end;
+    jobs_++;
+    lock();
+    if (last_) last_->next = job; else first_ = job;
+    last_ = job;
+    if (!waiting_) waiting_ = job;
+    unlock();
+  }
+}
+
+/* Add the matches of the jobs that are done, in order */
+void TextMatcher::merge() {
+  for (;;) {
+    lock();
+    Job *job = first_;
+    if (job && job->state == DONE) {
+      first_ = job->next;
+      if (!first_) last_ = 0;
+    } else {
+      job = 0;
+    }
+    unlock();
+    if (!job) break;
+    if (job->stale) {
+      research(job->start, job->end);
+    } else {
+      for (int i = 0; i < job->nfound; i++) add(job->start + job->found[i]);
+    }
+    searched_ = job->end;
+    jobs_--;
+    free(job->text);
+    free(job->found);
+    delete job;
+  }
+}
+
+void *TextMatcher::thread(void *v) {
+  TextMatcher *t = (TextMatcher *)v;
+  t->lock();
+  for (;;) {
+    Job *job = t->quit_ ? 0 : t->waiting_;
+    if (!job) break;
+    t->waiting_ = job->next;
+    job->state = SEARCHING;
+    t->unlock();
+    t->search(job);
+    t->lock();
+    job->state = DONE;
+  }
+  t->running_--;
+  bool last = !--t->refs_;
+  t->unlock();
+  if (last) delete t;
+  return 0;
+}
+
+/* Start threads for the waiting jobs. The threads end when there are
+   none left, so none are left running while nothing is searched. */
+void TextMatcher::start_threads() {
+  lock();
+#if USE_MATCH_THREADS
+  while (waiting_ && running_ < threads_) {
+    Thread t;
+# if defined(_WIN32) && !defined(__CYGWIN__)
+    bool ok = create_thread(t, thread, this) != -1;
+# else
+    bool ok = !create_thread(t, thread, this);
+    if (ok) pthread_detach(t);
+# endif
+    if (!ok) {
+      threads_ = running_;
+      break;
+    }
+    /* the thread waits for the lock, so this is counted before it runs */
+    running_++;
+    refs_++;
+  }
+#endif
+  /* without threads the main thread searches a job each time */
+  Job *job = running_ ? 0 : waiting_;
+  if (job) waiting_ = job->next;
+  unlock();
+  if (job) {
+    search(job);
+    job->state = DONE;
+  }
+}
+
+void TextMatcher::timeout_cb(void *v) {
+  ((TextMatcher *)v)->poll();
+}
+
+void TextMatcher::poll() {
+  merge();
+  queue();
+  start_threads();
+  int n = buffer_->length();
+  Text_Progress_Cb c = cb;
+  void *a = arg;
+  if (!jobs_ && searched_ >= n) {
+    remove_timeout(timeout_cb, this);
+    if (c) c(n, n, TextBuffer::IO_DONE, a);
+  } else {
+    repeat_timeout(MATCH_POLL_TIME, timeout_cb, this);
+    if (c) c(searched_, n, TextBuffer::IO_RUNNING, a);
+  }
+}
+
+void TextMatcher::modified_cb(int pos, int nInserted, int nDeleted,
+                              int, const char *, void *v) {
+  ((TextMatcher *)v)->modified(pos, nInserted, nDeleted);
+}
+
+/* Where a position before the edit is after it. The text inserted
+   belongs to the range that ends at pos. */
+static inline int moved(int x, int pos, int nInserted, int nDeleted) {
+  if (x < pos) return x;
+  if (x >= pos + nDeleted) return x + nInserted - nDeleted;
+  return pos;
+}
+
+void TextMatcher::modified(int pos, int nInserted, int nDeleted) {
+  if (!nInserted && !nDeleted) return;
+  int m = length();
+
+  /* remove the matches the edit broke and move the ones after it */
+  int i = find(pos - m + 1);
+  int j = find(pos + nDeleted);
+  if (j > i) {
+    memmove(starts_ + i, starts_ + j, (count_ - j) * sizeof(int));
+    count_ -= j - i;
+    display_->redisplay_range(pos - m + 1, pos);
+  }
+  for (int k = i; k < count_; k++) starts_[k] += nInserted - nDeleted;
+
+  /* move the jobs, and mark the ones whose copy was edited */
+  for (Job *job = first_; job; job = job->next) {
+    if (pos + nDeleted > job->start &&
+        (pos < job->end + m - 1 || pos == job->end))
+      job->stale = true;
+    job->start = moved(job->start, pos, nInserted, nDeleted);
+    job->end = moved(job->end, pos, nInserted, nDeleted);
+  }
+  searched_ = moved(searched_, pos, nInserted, nDeleted);
+  queued_ = moved(queued_, pos, nInserted, nDeleted);
+
+  /* search the edited text if it is where everything has been searched */
+  if (pos - m + 1 < searched_)
+    research(pos - m + 1, searched_ < pos + nInserted ? searched_ : pos + nInserted);
+}
+
+/**
+ * Highlight every place \a string is found in the text, and keep them
+ * highlighted as the text is edited. Matches may overlap, so "aa" is
+ * found twice in "aaa". They are drawn with match_color() behind them.
+ * Passing NULL or an empty string turns this off.
+ *
+ * The buffer is searched by several threads in the background, and
+ * the matches are drawn as they are found, so this returns right away
+ * even for a huge buffer. match_count(), next_match() and
+ * previous_match() only know about the matches found so far.
+ *
+ * \a cb is called with \a arg as the search goes on, with how many
+ * bytes of the buffer have been searched, the size of the buffer,
+ * and a status of TextBuffer::IO_RUNNING, and with a status of
+ * TextBuffer::IO_DONE when all of it has been searched.
+ */
+void TextDisplay::highlight_matches(const char *string, bool matchCase,
+                                    Text_Progress_Cb cb, void *arg) {
+  matches_delete_();
+  redraw();
+  if (!string || !*string || !buffer_) return;
+  matcher_ = new TextMatcher(this, buffer_, string, matchCase, cb, arg);
+}
+
+/** Return how many matches highlight_matches() has found so far */
+int TextDisplay::match_count() const {
+  return matcher_ ? matcher_->count() : 0;
+}
+
+/**
+ * Find the first match found by highlight_matches() that starts at or
+ * after \a pos, and set \a start and \a end to where it starts and
+ * ends. Returns false if there is none.
+ */
+bool TextDisplay::next_match(int pos, int *start, int *end) const {
+  if (!matcher_) return false;
+  int i = matcher_->find(pos);
+  if (i >= matcher_->count()) return false;
+  *start = matcher_->start(i);
+  *end = *start + matcher_->length();
+  return true;
+}
+
+/**
+ * Find the last match found by highlight_matches() that starts before
+ * \a pos, and set \a start and \a end to where it starts and ends.
+ * Returns false if there is none.
+ */
+bool TextDisplay::previous_match(int pos, int *start, int *end) const {
+  if (!matcher_) return false;
+  int i = matcher_->find(pos) - 1;
+  if (i < 0) return false;
+  *start = matcher_->start(i);
+  *end = *start + matcher_->length();
+  return true;
+}
+
+/* Called by position_style() */
+bool TextDisplay::in_match_(int pos) {
+  return matcher_->includes(pos);
+}
+
+/* Called with NULL before the buffer is changed, and with the new buffer
+   after, to search the new one for the same string */
+void TextDisplay::matches_buffer_(TextBuffer *buf) {
+  if (!matcher_) return;
+  if (!buf) {
+    matcher_->detach();
+    return;
+  }
+  TextMatcher *old = matcher_;
+  matcher_ = new TextMatcher(this, buf, old->string, old->matchcase,
+                             old->cb, old->arg);
+  old->release();
+}
+
+/* Called by the destructor */
+void TextDisplay::matches_delete_() {
+  if (matcher_) matcher_->release();
+  matcher_ = 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,463 @@
+//
+// "$Id$"
+//
+// Wrapped line index for the TextDisplay class.
+//
+// Copyright 2001-2006 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+/* In continuous wrap mode the display scrolls by wrapped rows, so
+   finding the top row number, the number of rows in the buffer, or the
+   position of a row far away means measuring all the text in between.
+   To avoid this the number of rows each line of the buffer wraps into
+   is remembered.  The lines are kept in blocks of up to
+   WRAP_INDEX_BLOCK_MAX lines, and Fenwick trees of the number of lines
+   and of rows in each block find the row of a line, or the line of a
+   row, in O(log n) plus a scan of one block.
+
+   When the width changes every line is forgotten, and until a line is
+   measured again it is counted as one row.  The lines around the
+   displayed text are measured right away and the rest are measured a
+   few at a time from an idle callback, adjusting the top line number and
+   the scrollbar as they are done.  An edit only forgets the lines it
+   changed. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fltk/run.h>
+#include <fltk/TextDisplay.h>
+
+using namespace fltk;
+
+/* Lines in each block made when the blocks are rebuilt */
+#define WRAP_INDEX_BLOCK 512
+
+/* Most lines a block can hold before it is split */
+#define WRAP_INDEX_BLOCK_MAX (2*WRAP_INDEX_BLOCK)
+
+/* Most bytes of text measured each time the idle callback is called */
+#define WRAP_IDLE_BYTES (64*1024)
+
+/* Edits that change fewer bytes than this have their lines measured
+   right away, so the row numbers stay exact */
+#define WRAP_EDIT_BYTES (64*1024)
+
+namespace fltk {
+
+class TextWrapIndex {
+public:
+  TextWrapIndex(int lines) : blocks_(0), nblocks_(0), blocksize_(0),
+    linetree_(0), rowtree_(0), treesize_(0) { reset(lines); }
+  ~TextWrapIndex();
+  void reset(int lines);
+  void replace(int line, int del, int ins);
+  int lines() const { return lines_; }
+  int rows() const { return rows_; }
+  int unmeasured() const { return unmeasured_; }
+  int get(int line);
+  void set(int line, int rows);
+  int rows_before(int line);
+  int find(int row, int *before);
+  int next_unmeasured(int line);
+
+  int next;		/* where the idle callback looks for lines */
+  bool lastempty;	/* the last line ends with an empty row */
+
+private:
+  struct Block {
+    int lines;		/* lines in this block */
+    int rows;		/* their rows, counting unmeasured ones as 1 */
+    int unmeasured;	/* how many have not been measured */
+    int count[WRAP_INDEX_BLOCK_MAX]; /* rows of each line, 0 if unknown */
+  };
+  Block *blocks_;
+  int nblocks_, blocksize_;
+  int *linetree_;	/* Fenwick tree of the lines in each block */
+  int *rowtree_;	/* Fenwick tree of the rows in each block */
+  int treesize_;
+  int lines_, rows_, unmeasured_;
+  int locate(int *line);
+  void build_trees();
+};
+
+} /* namespace fltk */
+
+TextWrapIndex::~TextWrapIndex() {
+  free(blocks_);
+  delete[] linetree_;
+  delete[] rowtree_;
+}
+
+/* Forget the rows of every line, and make it have this many lines */
+void TextWrapIndex::reset(int lines) {
+  int n = (lines + WRAP_INDEX_BLOCK - 1) / WRAP_INDEX_BLOCK;
+  if (n < 1) n = 1;
+  if (n > blocksize_) {
+    blocksize_ = n;
+    blocks_ = (Block *)realloc(blocks_, blocksize_ * sizeof(Block));
+  }
+  nblocks_ = n;
+  for (int k = 0; k < n; k++) {
+    Block &b = blocks_[k];
+    b.lines = lines > WRAP_INDEX_BLOCK ? WRAP_INDEX_BLOCK : lines;
+    lines -= b.lines;
+    b.rows = b.unmeasured = b.lines;
+    memset(b.count, 0, b.lines * sizeof(int));
+  }
+  build_trees();
+  next = 0;
+  lastempty = false;
+}
+
+/* Remake the Fenwick trees and the totals from the blocks */
+void TextWrapIndex::build_trees() {
+  if (nblocks_ + 1 > treesize_) {
+    delete[] linetree_;
+    delete[] rowtree_;
+    treesize_ = 2 * nblocks_ + 1;
+    linetree_ = new int[treesize_];
+    rowtree_ = new int[treesize_];
+  }
+  lines_ = rows_ = unmeasured_ = 0;
+  for (int k = 0; k < nblocks_; k++) {
+    linetree_[k + 1] = blocks_[k].lines;
+    rowtree_[k + 1] = blocks_[k].rows;
+    lines_ += blocks_[k].lines;
+    rows_ += blocks_[k].rows;
+    unmeasured_ += blocks_[k].unmeasured;
+  }
+  for (int i = 1; i <= nblocks_; i++) {
+    int j = i + (i & -i);
+    if (j <= nblocks_) {
+      linetree_[j] += linetree_[i];
+      rowtree_[j] += rowtree_[i];
+    }
+  }
+}
+
+/* Return the block the line is in, and change line to the index in
+   that block.  Returns nblocks_ if line is lines() or more. */
+int TextWrapIndex::locate(int *line) {
+  int k = 0;
+  int step = 1;
+  while (step * 2 <= nblocks_) step *= 2;
+  for (; step; step /= 2) {
+    if (k + step <= nblocks_ && linetree_[k + step] <= *line) {
+      k += step;
+      *line -= linetree_[k];
+    }
+  }
+  return k;
+}
+
+/* Return the rows of a line, or 0 if it has not been measured */
+int TextWrapIndex::get(int line) {
+  int k = locate(&line);
+  if (k >= nblocks_) return 0;
+  return blocks_[k].count[line];
+}
+
+/* Set how many rows a line has been measured to have */
+void TextWrapIndex::set(int line, int rows) {
+  int k = locate(&line);
+  if (k >= nblocks_) return;
+  Block &b = blocks_[k];
+  int old = b.count[line];
+  b.count[line] = rows;
+  int delta = (rows ? rows : 1) - (old ? old : 1);
+  b.unmeasured += (!rows) - (!old);
+  unmeasured_ += (!rows) - (!old);
+  if (!delta) return;
+  b.rows += delta;
+  rows_ += delta;
+  for (int i = k + 1; i <= nblocks_; i += i & -i) rowtree_[i] += delta;
+}
+
+/* Return the number of rows in the lines before this one */
+int TextWrapIndex::rows_before(int line) {
+  int k = 0, n = 0;
+  int step = 1;
+  while (step * 2 <= nblocks_) step *= 2;
+  for (; step; step /= 2) {
+    if (k + step <= nblocks_ && linetree_[k + step] <= line) {
+      k += step;
+      line -= linetree_[k];
+      n += rowtree_[k];
+    }
+  }
+  if (k < nblocks_) {
+    const int *c = blocks_[k].count;
+    for (int i = 0; i < line; i++) n += c[i] ? c[i] : 1;
+  }
+  return n;
+}
+
+/* Return the line that contains a row, and set before to the number of
+   rows before that line.  Rows past the end are in the last line. */
+int TextWrapIndex::find(int row, int *before) {
+  if (row >= rows_) {
+    *before = rows_before(lines_ - 1);
+    return lines_ - 1;
+  }
+  int k = 0, line = 0, n = 0;
+  int step = 1;
+  while (step * 2 <= nblocks_) step *= 2;
+  for (; step; step /= 2) {
+    if (k + step <= nblocks_ && rowtree_[k + step] <= row) {
+      k += step;
+      row -= rowtree_[k];
+      n += rowtree_[k];
+      line += linetree_[k];
+    }
+  }
+  const int *c = blocks_[k].count;
+  int i = 0;
+  for (;; i++) {
+    int r = c[i] ? c[i] : 1;
+    if (row < r || i + 1 >= blocks_[k].lines) break;
+    row -= r;
+    n += r;
+  }
+  *before = n;
+  return line + i;
+}
+
+/* Return the first line at or after this one that has not been
+   measured, or -1 if there are none */
+int TextWrapIndex::next_unmeasured(int line) {
+  if (!unmeasured_) return -1;
+  int first = line;
+  int k = locate(&line);
+  first -= line;
+  for (; k < nblocks_; first += blocks_[k].lines, k++, line = 0) {
+    if (!blocks_[k].unmeasured) continue;
+    for (int i = line; i < blocks_[k].lines; i++)
+      if (!blocks_[k].count[i]) return first + i;
+  }
+  return -1;
+}
+
+/* Lines line through line+del were replaced by ins+1 lines that have not
+   been measured */
+void TextWrapIndex::replace(int line, int del, int ins) {
+  int first = line;
+  int k = locate(&first);
+  int last = line + del;
+  int k2 = locate(&last);
+  if (k >= nblocks_ || k2 >= nblocks_) {reset(lines_ + ins - del); return;}
+  Block &b = blocks_[k];
+
+  if (k == k2 && b.lines + ins - del <= WRAP_INDEX_BLOCK_MAX) {
+    /* the usual case, all in one block */
+    int rows = 0, unmeasured = 0;
+    for (int i = first; i <= last; i++) {
+      rows += b.count[i] ? b.count[i] : 1;
+      if (!b.count[i]) unmeasured++;
+    }
+    memmove(b.count + first + ins + 1, b.count + last + 1,
+            (b.lines - last - 1) * sizeof(int));
+    memset(b.count + first, 0, (ins + 1) * sizeof(int));
+    b.lines += ins - del;
+    lines_ += ins - del;
+    int drows = ins + 1 - rows;
+    b.rows += drows;
+    rows_ += drows;
+    b.unmeasured += ins + 1 - unmeasured;
+    unmeasured_ += ins + 1 - unmeasured;
+    for (int i = k + 1; i <= nblocks_; i += i & -i) {
+      linetree_[i] += ins - del;
+      rowtree_[i] += drows;
+    }
+    return;
+  }
+
+  /* Otherwise make new blocks out of the start of block k, the new lines,
+     and the end of block k2, and put them in place of blocks k..k2 */
+  int tail = blocks_[k2].lines - last - 1;
+  int n = first + ins + 1 + tail;
+  int *c = (int *)malloc(n * sizeof(int));
+  memcpy(c, b.count, first * sizeof(int));
+  memset(c + first, 0, (ins + 1) * sizeof(int));
+  memcpy(c + first + ins + 1, blocks_[k2].count + last + 1, tail * sizeof(int));
+  int made = (n + WRAP_INDEX_BLOCK - 1) / WRAP_INDEX_BLOCK;
+  int total = nblocks_ - (k2 - k + 1) + made;
+  if (total > blocksize_) {
+    blocksize_ = total > 2 * blocksize_ ? total : 2 * blocksize_;
+    blocks_ = (Block *)realloc(blocks_, blocksize_ * sizeof(Block));
+  }
+  memmove(blocks_ + k + made, blocks_ + k2 + 1,
+          (nblocks_ - k2 - 1) * sizeof(Block));
+  nblocks_ = total;
+  for (int j = 0; j < made; j++) {
+    Block &d = blocks_[k + j];
+    int from = j * WRAP_INDEX_BLOCK;
+    d.lines = n - from > WRAP_INDEX_BLOCK ? WRAP_INDEX_BLOCK : n - from;
+    memcpy(d.count, c + from, d.lines * sizeof(int));
+    d.rows = d.unmeasured = 0;
+    for (int i = 0; i < d.lines; i++) {
+      d.rows += d.count[i] ? d.count[i] : 1;
+      if (!d.count[i]) d.unmeasured++;
+    }
+  }
+  free(c);
+  build_trees();
+}
+
+////////////////////////////////////////////////////////////////
+// Use of the index by TextDisplay
+
+/* Measure how many rows a line of the buffer wraps into, remember it,
+   and return the position of the next line.  start is the position of
+   the line if the caller knows it, or -1. */
+int TextDisplay::wrap_measure_(int line, int start) {
+  int retPos, retLines, retLineStart, retLineEnd;
+  if (start < 0) start = buffer_->line_to_position(line);
+  int end = buffer_->line_end(start);
+  wrapped_line_counter(buffer_, start, end, INT_MAX, true, 0, &retPos,
+                       &retLines, &retLineStart, &retLineEnd, false);
+  wrapindex_->set(line, retLines + 1);
+  if (end >= buffer_->length()) wrapindex_->lastempty = retLineStart >= end;
+  return end + 1;
+}
+
+/* Return the wrapped row, counting from 0, that pos is displayed on */
+int TextDisplay::wrap_row_(int pos) {
+  int line = buffer_->position_to_line(pos);
+  /* measure the line so the rows after it are counted after its end */
+  if (!wrapindex_->get(line)) wrap_measure_(line);
+  int start = buffer_->line_to_position(line);
+  int row = wrapindex_->rows_before(line);
+  if (pos > start) {
+    int retPos, retLines, retLineStart, retLineEnd;
+    wrapped_line_counter(buffer_, start, pos, INT_MAX, true, 0, &retPos,
+                         &retLines, &retLineStart, &retLineEnd, false);
+    row += retLines;
+  }
+  return row;
+}
+
+/* Return the position of the start of a wrapped row */
+int TextDisplay::wrap_row_start_(int row) {
+  for (;;) {
+    int before;
+    int line = wrapindex_->find(row, &before);
+    /* the rows before a line do not change when it is measured, so if it
+       was not measured the row may now be in a later line */
+    if (!wrapindex_->get(line)) {wrap_measure_(line); continue;}
+    int start = buffer_->line_to_position(line);
+    int n = row - before;
+    /* rows past the end are the last row */
+    if (n >= wrapindex_->get(line)) n = wrapindex_->get(line) - 1;
+    if (!n) return start;
+    return skip_lines(start, n, true);
+  }
+}
+
+/* Forget how every line wraps, after the width changed.  The index is
+   made to have this many lines, or as many as the buffer if zero. */
+void TextDisplay::wrap_reset_(int lines) {
+  if (!lines) lines = buffer_->position_to_line(buffer_->length()) + 1;
+  if (!wrapindex_) wrapindex_ = new TextWrapIndex(lines);
+  else wrapindex_->reset(lines);
+}
+
+/* Stop keeping the index, when wrapping is turned off */
+void TextDisplay::wrap_delete_() {
+  remove_idle(wrap_idle_cb, this);
+  delete wrapindex_;
+  wrapindex_ = 0;
+}
+
+/* Update the index for an edit of the buffer.  The changed lines are
+   measured now if there are not too many, otherwise they are left for
+   the idle callback. */
+void TextDisplay::wrap_modified_(int pos, int nInserted, int nDeleted,
+                                 const char *deletedText) {
+  if (nDeleted && !deletedText) {wrap_reset_(); return;}
+  int line = buffer_->position_to_line(pos);
+  int del = 0;
+  for (int i = 0; i < nDeleted; i++)
+    if (deletedText[i] == '\n') del++;
+  int ins = nInserted ? buffer_->count_lines(pos, pos + nInserted) : 0;
+  wrapindex_->replace(line, del, ins);
+  if (nInserted < WRAP_EDIT_BYTES)
+    for (int i = line, start = -1; i <= line + ins; i++)
+      start = wrap_measure_(i, start);
+}
+
+/* Measure the lines around the displayed text, and make the top line
+   number and the number of lines in the buffer agree with the index */
+void TextDisplay::wrap_sync_() {
+  int line = buffer_->position_to_line(firstchar_);
+  int last = line + 2 * visiblelines_cnt_;
+  if (last > wrapindex_->lines()) last = wrapindex_->lines();
+  int start = -1;
+  for (int i = line > visiblelines_cnt_ ? line - visiblelines_cnt_ : 0;
+       i < last; i++) {
+    if (wrapindex_->get(i)) start = -1;
+    else start = wrap_measure_(i, start);
+  }
+
+  topline_num_ = wrap_row_(firstchar_) + 1;
+  /* like count_lines(0, length, true), this does not count an empty
+     last row */
+  int length = buffer_->length();
+  bufferlines_cnt_ = wrapindex_->rows();
+  if (wrapindex_->get(wrapindex_->lines() - 1) ? wrapindex_->lastempty :
+      !length || buffer_->character(length - 1) == '\n')
+    bufferlines_cnt_--;
+
+  if (wrapindex_->unmeasured() && !has_idle(wrap_idle_cb, this))
+    add_idle(wrap_idle_cb, this);
+}
+
+/* Measure lines that have not been measured yet, a few at a time */
+void TextDisplay::wrap_idle_cb(void *v) {
+  TextDisplay *d = (TextDisplay *)v;
+  TextWrapIndex *index = d->wrapindex_;
+  if (!index || !index->unmeasured() || !d->buffer_) {
+    remove_idle(wrap_idle_cb, v);
+    return;
+  }
+  int oldtop = d->topline_num_, oldlines = d->bufferlines_cnt_;
+  int start = -1;
+  for (int bytes = 0; bytes < WRAP_IDLE_BYTES;) {
+    int line = index->next_unmeasured(index->next);
+    if (line < 0) line = index->next_unmeasured(0);
+    if (line < 0) break;
+    if (line != index->next || start < 0)
+      start = d->buffer_->line_to_position(line);
+    int end = d->wrap_measure_(line, start);
+    bytes += end - start;
+    start = end;
+    index->next = line + 1;
+  }
+  d->wrap_sync_();
+  if (d->topline_num_ != oldtop || d->bufferlines_cnt_ != oldlines)
+    d->update_v_scrollbar();
+  if (!index->unmeasured()) remove_idle(wrap_idle_cb, v);
+}
+
+//
+// End of "$Id$".
+//
@@ -108,6 +108,8 @@ static struct {
     //{ Clear,    0,                        TextEditor::delete_to_eol },
     { 'z',          CTRL,                 TextEditor::kf_undo      },
     { '/',          CTRL,                 TextEditor::kf_undo      },
+    { 'z',          CTRL|SHIFT,           TextEditor::kf_redo      },
+    { 'y',          CTRL,                 TextEditor::kf_redo      },
     { 'x',          CTRL,                 TextEditor::kf_cut        },
     { DeleteKey,    SHIFT,                TextEditor::kf_cut        },
     { 'c',          CTRL,                 TextEditor::kf_copy       },
@@ -119,6 +121,7 @@ static struct {
 #ifdef __APPLE__
     // Define CMD+key accelerators...
     { 'z',          COMMAND,              TextEditor::kf_undo       },
+    { 'z',          COMMAND|SHIFT,        TextEditor::kf_redo       },
     { 'x',          COMMAND,              TextEditor::kf_cut        },
     { 'c',          COMMAND,              TextEditor::kf_copy       },
     { 'v',          COMMAND,              TextEditor::kf_paste      },
@@ -386,7 +389,7 @@ int TextEditor::kf_select_all(int, TextEditor* e) {
 
 int TextEditor::kf_undo(int , TextEditor* e) {
   e->buffer()->unselect();
-  int crsr;
+  int crsr = e->insert_position();
   int ret = e->buffer()->undo(&crsr);
   e->insert_position(crsr);
   e->show_insert_position();
@@ -394,6 +397,16 @@ int TextEditor::kf_undo(int , TextEditor* e) {
   return ret;
 }
 
+int TextEditor::kf_redo(int , TextEditor* e) {
+  e->buffer()->unselect();
+  int crsr = e->insert_position();
+  int ret = e->buffer()->redo(&crsr);
+  e->insert_position(crsr);
+  e->show_insert_position();
+  e->maybe_do_callback();
+  return ret;
+}
+
 int TextEditor::handle_key() {
   // Call FLTK's rules to try to turn this into a printing character.
   // This uses the right-hand ctrl key as a "compose prefix" and returns
@@ -0,0 +1,30 @@
+/* Boyer-Moore-Horspool string search, shared by the TextBuffer searches
+   and the TextDisplay match highlighting.  This is not a public header.
+   The const functions can be called by several threads at once. */
+
+#ifndef fltk_TextSearch_h
+#define fltk_TextSearch_h
+
+#include <stdlib.h>
+
+namespace fltk {
+
+class TextSearch {
+public:
+  TextSearch(const char *s, bool matchcase, bool backward);
+  ~TextSearch() { free(pattern_); }
+  int length() const { return length_; }
+  int find(const char *text, int first, int last) const;
+  int rfind(const char *text, int first, int last) const;
+  char *window;		/* room for 2*length() characters */
+
+private:
+  unsigned char *pattern_; /* case folded if fold_ is set */
+  const unsigned char *fold_;
+  int length_;
+  int skip_[256];
+};
+
+} /* namespace fltk */
+
+#endif
@@ -34,6 +34,7 @@
 #include <fltk/string.h> // for newstring
 #include <stdlib.h> // for free
 #include <config.h>
+#include "GroupLabels.h"
 
 using namespace fltk;
 
@@ -82,6 +83,7 @@ Widget::Widget(int X, int Y, int W, int H, const char* L) :
   damage_	= DAMAGE_ALL;
   layout_damage_= LAYOUT_DAMAGE;
   when_		= WHEN_RELEASE;
+  index_	= 0;
   if (Group::current()) Group::current()->add(this);
 }
 
@@ -147,6 +149,7 @@ void Widget::get_absolute_rect( Rectangle *rect ) const
 */
 void Widget::label(const char* s) {
   if (label_ == s) return; // Avoid problems if label(label()) is called
+  GroupLabels::relabel(this, s);
   if (flags_&COPIED_LABEL) {
     delete[] const_cast<char*>( label_ );
     flags_ &= ~COPIED_LABEL;
@@ -163,6 +166,7 @@ void Widget::label(const char* s) {
 */
 void Widget::copy_label(const char* s) {
   if (label_ == s) return; // Avoid problems if label(label()) is called
+  GroupLabels::relabel(this, s);
   if (flags_&COPIED_LABEL) delete[] const_cast<char*>( label_ );
   label_ = newstring(s);
   flags_ |= COPIED_LABEL;
@@ -53,6 +53,18 @@ typedef struct _XftMatrix {
 
 using namespace fltk;
 
+// Advance widths of the characters measured so far in one font+size.
+// Xft does not kern, so the width of a string is the sum of these and
+// getwidth() does not have to ask Xft except for new characters:
+struct GlyphWidths {
+  short latin1[256]; // UNKNOWN_WIDTH if not measured yet
+  unsigned* keys;    // hash table of other characters, 0 is empty
+  short* values;
+  unsigned size, count;
+};
+
+#define UNKNOWN_WIDTH (-32768)
+
 // One of these is made for each combination of font+size:
 struct FontSize {
   float minsize, maxsize;
@@ -61,6 +73,7 @@ struct FontSize {
   unsigned opengl_id; // for OpenGL display lists
   unsigned texture; // for OpenGL display lists
   XFontStruct* xfont;
+  GlyphWidths* widths; // created by the first getwidth()
   //~FontSize();
 };
 
@@ -169,6 +182,7 @@ void fltk::setfont(fltk::Font* font, float size) {
   f->fonthash = fonthash;
   f->opengl_id = 0;
   f->xfont = 0; // figure this out later
+  f->widths = 0;
   current = f;
 }
 
@@ -231,28 +245,86 @@ float fltk::getdescent() { return current->font->descent; }
 // pain to track down!
 #define WCBUFLEN 256
 
-float fltk::getwidth(const char *str, int n) {
+// Ask Xft for the width of one character:
+static short measure(FontSize* f, unsigned ucs) {
   XGlyphInfo i;
-#if 0
-  XftTextExtentsUtf8(xdisplay, current->font, (XftChar8*)str, n, &i);
-#else
-  wchar_t localbuffer[WCBUFLEN];
-  wchar_t* buffer = localbuffer;
-  wchar_t* mallocbuffer = 0;
-  int count = utf8towc(str, n, buffer, WCBUFLEN);
-  if (count >= WCBUFLEN) {
-    buffer = mallocbuffer = new wchar_t[count+3];
-    count = utf8towc(str, n, buffer, count+3);
-  }
-  // fix some lengths that cause older Xft to crash (!):
-  if ((count&255)==253) buffer[count++] = 0;
-  if ((count&255)==254) buffer[count++] = 0;
-  XftTextExtents32(xdisplay, current->font, (XftChar32*)buffer, count, &i);
-  delete[] mallocbuffer;
-#endif
+  XftChar32 c = ucs;
+  XftTextExtents32(xdisplay, f->font, &c, 1, &i);
   return i.xOff;
 }
 
+// Return the width of a character other than Latin-1, looking it up
+// in the hash table and measuring and adding it if it is not there:
+static short hashedwidth(GlyphWidths* g, FontSize* f, unsigned ucs) {
+  unsigned mask = g->size-1;
+  unsigned i = (ucs*2654435761U) & mask;
+  if (g->size) for (;; i = (i+1) & mask) {
+    if (g->keys[i] == ucs) return g->values[i];
+    if (!g->keys[i]) break;
+  }
+  short w = measure(f, ucs);
+  if (2*(g->count+1) > g->size) {
+    // grow the table, and put the old entries back in:
+    unsigned oldsize = g->size;
+    unsigned* oldkeys = g->keys;
+    short* oldvalues = g->values;
+    g->size = oldsize ? 2*oldsize : 64;
+    g->keys = new unsigned[g->size];
+    g->values = new short[g->size];
+    memset(g->keys, 0, g->size*sizeof(unsigned));
+    mask = g->size-1;
+    for (unsigned j = 0; j < oldsize; j++) if (oldkeys[j]) {
+      unsigned k = (oldkeys[j]*2654435761U) & mask;
+      while (g->keys[k]) k = (k+1) & mask;
+      g->keys[k] = oldkeys[j];
+      g->values[k] = oldvalues[j];
+    }
+    delete[] oldkeys;
+    delete[] oldvalues;
+    i = (ucs*2654435761U) & mask;
+    while (g->keys[i]) i = (i+1) & mask;
+  }
+  g->keys[i] = ucs;
+  g->values[i] = w;
+  g->count++;
+  return w;
+}
+
+// The widths are remembered for each font+size, so after the first
+// time a character is measured this does not call Xft at all. This
+// makes measuring text one character at a time, as TextDisplay and
+// Input do, about as fast as measuring it all at once.
+float fltk::getwidth(const char *str, int n) {
+  GlyphWidths* g = current->widths;
+  if (!g) {
+    g = current->widths = new GlyphWidths;
+    for (int i = 0; i < 256; i++) g->latin1[i] = UNKNOWN_WIDTH;
+    g->keys = 0;
+    g->values = 0;
+    g->size = g->count = 0;
+  }
+  int width = 0;
+  const char* p = str;
+  const char* e = str+n;
+  while (p < e) {
+    unsigned ucs;
+    if (!(*p & 0x80)) {
+      ucs = *p++;
+    } else {
+      int len; ucs = utf8decode(p, e, &len);
+      p += len;
+    }
+    if (ucs < 256) {
+      short w = g->latin1[ucs];
+      if (w == UNKNOWN_WIDTH) w = g->latin1[ucs] = measure(current, ucs);
+      width += w;
+    } else {
+      width += hashedwidth(g, current, ucs);
+    }
+  }
+  return width;
+}
+
 ////////////////////////////////////////////////////////////////
 
 void fltk::drawtext_transformed(const char *str, int n, float x, float y) {
@@ -0,0 +1,66 @@
+// Test of resizing a Group while Group::defer_updates() is on.
+// Adds and removes children with the updates deferred, resizes the
+// group and lays it out in between, as a window being resized while a
+// long fill calls fltk::check() would, and checks that every child is
+// scaled from where it was put. Prints "ok" or what went wrong.
+
+#include <fltk/Group.h>
+#include <fltk/Widget.h>
+#include <stdio.h>
+
+using namespace fltk;
+
+static int errors = 0;
+
+// The children were all placed in a 100x100 group, child i at
+// x = y = i%50 and 10x10 in size. Check they were scaled to the group.
+static void check(Group& group, const char* when) {
+  for (int i = 0; i < group.children(); i++) {
+    Widget* o = group.child(i);
+    int p = (o->argument() % 50) * group.w() / 100;
+    int s = 10 * group.w() / 100;
+    if (o->x() != p || o->y() != p || o->w() != s || o->h() != s) {
+      printf("%s: child %d is %d,%d %dx%d, should be %d,%d %dx%d\n", when,
+	     i, o->x(), o->y(), o->w(), o->h(), p, p, s, s);
+      errors++;
+      return;
+    }
+  }
+}
+
+static void add(Group& group, int from, int to) {
+  for (int i = from; i < to; i++) {
+    Widget* o = new Widget(i%50, i%50, 10, 10);
+    o->argument(i);
+    group.add(o);
+  }
+}
+
+int main() {
+  Group::current(0);
+  Group group(0, 0, 100, 100);
+  group.resizable(group);
+  add(group, 0, 2);
+  group.layout();
+
+  group.defer_updates(true);
+  add(group, 2, 100);
+  group.resize(200, 200);
+  group.layout();
+  check(group, "after adding");
+
+  group.remove_range(10, 80);
+  group.remove(0);
+  group.resize(100, 100);
+  group.layout();
+  check(group, "after removing");
+
+  add(group, 100, 150);
+  group.defer_updates(false);
+  group.resize(300, 300);
+  group.layout();
+  check(group, "after defer_updates(false)");
+
+  if (!errors) printf("ok\n");
+  return errors != 0;
+}
@@ -57,7 +57,6 @@ fltk::TextBuffer     *textbuf = 0;
 
 
 // Syntax highlighting stuff...
-fltk::TextBuffer     *stylebuf = 0;
 fltk::TextDisplay::StyleTableEntry
                    styletable[] = {	// Style table
 		     { fltk::BLACK,           fltk::COURIER,        12 }, // A - Plain
@@ -158,10 +157,11 @@ extern "C" {
 }
 
 //
-// 'style_parse()' - Parse text and produce style data.
+// 'style_parse()' - Parse text and produce style data, returns the
+//                   style the text ends in.
 //
 
-void
+char
 style_parse(const char *text,
             char       *style,
 	    int        length) {
@@ -289,127 +289,25 @@ style_parse(const char *text,
       if (current == 'B' || current == 'E') current = 'A';
     }
   }
+  return current;
 }
 
 
 //
-// 'style_init()' - Initialize the style buffer...
+// 'style_line()' - Style one line for the editor's highlighting.
 //
 
-void
-style_init(void) {
-  char *style = new char[textbuf->length() + 1];
-  const char *text = textbuf->text();
-
-  memset(style, 'A', textbuf->length());
-  style[textbuf->length()] = '\0';
-
-  if (!stylebuf) stylebuf = new fltk::TextBuffer(textbuf->length());
-
-  style_parse(text, style, textbuf->length());
-
-  stylebuf->text(style);
-  delete[] style;
-}
-
-
-//
-// 'style_unfinished_cb()' - Update unfinished styles.
-//
-
-void
-style_unfinished_cb(int, void*) {
-}
-
-
-//
-// 'style_update()' - Update the style buffer...
-//
-
-void
-style_update(int        pos,		// I - Position of update
-             int        nInserted,	// I - Number of inserted chars
-	     int        nDeleted,	// I - Number of deleted chars
-             int        /*nRestyled*/,	// I - Number of restyled chars
-	     const char * /*deletedText*/,// I - Text that was deleted
-             void       *cbArg) {	// I - Callback data
-  int	start,				// Start of text
-	end;				// End of text
-  char	last,				// Last style on line
-	*style,				// Style data
-	*text;				// Text data
-
-
-  // If this is just a selection change, just unselect the style buffer...
-  if (nInserted == 0 && nDeleted == 0) {
-    stylebuf->unselect();
-    return;
-  }
-
-  // Track changes in the text buffer...
-  if (nInserted > 0) {
-    // Insert characters into the style buffer...
-    style = new char[nInserted + 1];
-    memset(style, 'A', nInserted);
-    style[nInserted] = '\0';
-
-    stylebuf->replace(pos, pos + nDeleted, style);
-    delete[] style;
-  } else {
-    // Just delete characters in the style buffer...
-    stylebuf->remove(pos, pos + nDeleted);
-  }
-
-  // Select the area that was just updated to avoid unnecessary
-  // callbacks...
-  stylebuf->select(pos, pos + nInserted - nDeleted);
-
-  // Re-parse the changed region; we do this by parsing from the
-  // beginning of the previous line of the changed region to the end of
-  // the line of the changed region...  Then we check the last
-  // style character and keep updating if we have a multi-line
-  // comment character...
-  start = textbuf->line_start(pos);
-//  if (start > 0) start = textbuf->line_start(start - 1);
-  end   = textbuf->line_end(pos + nInserted);
-  text  = textbuf->text_range(start, end);
-  style = stylebuf->text_range(start, end);
-  if (start==end)
-    last = 0;
-  else
-    last  = style[end - start - 1];
-
-//  printf("start = %d, end = %d, text = \"%s\", style = \"%s\", last='%c'...\n",
-//         start, end, text, style, last);
-
-  style_parse(text, style, end - start);
-
-//  printf("new style = \"%s\", new last='%c'...\n",
-//         style, style[end - start - 1]);
-
-  stylebuf->replace(start, end, style);
-  ((fltk::TextEditor *)cbArg)->redisplay_range(start, end);
-
-  if (start==end || last != style[end - start - 1]) {
-//    printf("Recalculate the rest of the buffer style\n");
-    // Either the user deleted some text, or the last character
-    // on the line changed styles, so reparse the
-    // remainder of the buffer...
-    free(text);
-    free(style);
-
-    end   = textbuf->length();
-    text  = textbuf->text_range(start, end);
-    style = stylebuf->text_range(start, end);
-
-    style_parse(text, style, end - start);
-
-    stylebuf->replace(start, end, style);
-    ((fltk::TextEditor *)cbArg)->redisplay_range(start, end);
-  }
-
-  free(text);
-  free(style);
+int
+style_line(const char *text,		// I - Text of the line
+           int        length,		// I - Length of the line
+           char       *style,		// O - Style data
+           int        state,		// I - Style the last line ended in
+           void       *) {
+  style[0] = state ? (char)state : 'A';
+  char current = style_parse(text, style, length);
+  if (current == 'B' || current == 'E' || current == 'F' || current == 'G')
+    current = 'A';
+  return current == 'A' ? 0 : current;
 }
 
 
@@ -464,7 +362,21 @@ EditorWindow::~EditorWindow() {
   delete replace_dlg;
 }
 
+int saving = 0;      // a file is being written by savefile_async()
+int saved_clean = 0; // the text was not edited since that save started
+
+// Let a file being saved finish, so it is not left half written
+void wait_for_save() {
+  while (saving) fltk::wait();
+}
+
+// Let a file being loaded or saved finish
+void wait_for_io() {
+  while (textbuf->io_busy()) fltk::wait();
+}
+
 int check_save(void) {
+  wait_for_save();
   if (!changed) return 1;
 
   int r = fltk::choice("The current file has not been saved.\n"
@@ -473,6 +385,7 @@ int check_save(void) {
 
   if (r == 1) {
     save_cb(); // Save the file...
+    wait_for_save();
     return !changed;
   }
 
@@ -480,14 +393,32 @@ int check_save(void) {
 }
 
 int loading = 0;
+void load_done_cb(int, int, int status, void* v) {
+  if (status == fltk::TextBuffer::IO_RUNNING) return;
+  if (status == fltk::TextBuffer::IO_ERROR)
+    fltk::alert("Error reading from file \'%s\'.", (const char*)v);
+  textbuf->call_modify_callbacks();
+}
+
 void load_file(const char *newfile, int ipos) {
-  loading = 1;
   int insert = (ipos != -1);
+  // a file inserted into one still loading goes after all of it,
+  // a new file replaces the one loading
+  if (insert) wait_for_io();
+  else {
+    wait_for_save();
+    textbuf->cancel_io();
+  }
   changed = insert;
   if (!insert) strcpy(filename, "");
   int r;
-  if (!insert) r = textbuf->loadfile(newfile);
-  else r = textbuf->insertfile(newfile, ipos);
+  // a new file is read in the background, so the start of a large one
+  // can be looked at while the rest is still being read
+  if (!insert) r = textbuf->loadfile_async(newfile, load_done_cb, filename);
+  else {
+    loading = 1;
+    r = textbuf->insertfile(newfile, ipos);
+  }
   if (r) {
     if (fltk::ask("File '%s' does not exit. Do you want to create one?", newfile))
       strcpy(filename, newfile);
@@ -495,17 +426,32 @@ void load_file(const char *newfile, int ipos) {
       strcpy(filename, "");
   } // if
   else
-    if (!insert) strcpy(filename, newfile);
+    if (!insert) {strcpy(filename, newfile); return;}
   loading = 0;
   textbuf->call_modify_callbacks();
 }
 
+void save_done_cb(int, int, int status, void* v) {
+  if (status == fltk::TextBuffer::IO_RUNNING) return;
+  saving = 0;
+  // the file only matches the text if it was all written and the
+  // text was not edited while it was
+  if (status == fltk::TextBuffer::IO_DONE && saved_clean) changed = 0;
+  if (status == fltk::TextBuffer::IO_ERROR)
+    fltk::alert("Error writing to file \'%s\'.", (const char*)v);
+  textbuf->call_modify_callbacks();
+}
+
 void save_file(const char *newfile) {
-  if (textbuf->savefile(newfile))
+  // the text is not all there until the file loading is done
+  wait_for_io();
+  if (textbuf->savefile_async(newfile, save_done_cb, filename)) {
     fltk::alert("Error writing to file \'%s\':\n%s.", newfile, strerror(errno));
-  else
-    strcpy(filename, newfile);
-  changed = 0;
+    return;
+  }
+  strcpy(filename, newfile);
+  saving = 1;
+  saved_clean = 1;
   textbuf->call_modify_callbacks();
 }
 
@@ -572,10 +518,12 @@ void set_title(fltk::Window* w) {
 }
 
 void changed_cb(int, int nInserted, int nDeleted,int, const char*, void* v) {
-  if ((nInserted || nDeleted) && !loading) changed = 1;
+  // text added by loadfile_async() is not an edit
+  int load = loading || textbuf->io_inserting();
+  if ((nInserted || nDeleted) && !load) {changed = 1; saved_clean = 0;}
   EditorWindow *w = (EditorWindow *)v;
   set_title(w);
-  if (loading) w->editor->show_insert_position();
+  if (load) w->editor->show_insert_position();
 }
 
 void new_cb(fltk::Widget*, void*) {
@@ -622,7 +570,7 @@ void close_cb(fltk::Widget*, void* v) {
 }
 
 void quit_cb(fltk::Widget*, void*) {
-  if (changed && !check_save())
+  if (!check_save())
     return;
 
   exit(0);
@@ -766,9 +714,8 @@ fltk::Window* new_view() {
     build_menus(m,w);
     w->editor = new fltk::TextEditor(0, 21, 660, 379);
     w->editor->buffer(textbuf);
-    w->editor->highlight_data(stylebuf, styletable,
-      sizeof(styletable) / sizeof(styletable[0]),
-     'A', style_unfinished_cb, 0);
+    w->editor->highlight(styletable,
+      sizeof(styletable) / sizeof(styletable[0]), style_line);
     w->editor->textfont(fltk::COURIER);
   w->end();
   w->resizable(w->editor);
@@ -779,7 +726,6 @@ fltk::Window* new_view() {
   w->editor->cursor_style(fltk::TextDisplay::BLOCK_CURSOR);
   // w->editor->insert_mode(false);
 
-  textbuf->add_modify_callback(style_update, w->editor);
   textbuf->add_modify_callback(changed_cb, w);
   textbuf->call_modify_callbacks();
   num_windows++;
@@ -789,7 +735,6 @@ fltk::Window* new_view() {
 int main(int argc, char **argv) {
 
   textbuf = new fltk::TextBuffer(0);
-  style_init();
 
   fltk::Window* window = new_view();
 
@@ -0,0 +1,58 @@
+// Test of TextBuffer::regex_search_all() and regex_search_some().
+// Searches some short texts and checks the matches found, both all at
+// once and a few characters at a time. Prints "ok" or what went wrong.
+
+#include <fltk/TextBuffer.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace fltk;
+
+static char found[256];
+
+static int found_cb(int start, int end, void*) {
+  sprintf(found + strlen(found), "%d-%d ", start, end);
+  return 1;
+}
+
+struct Case {
+  const char *pattern, *text, *matches;
+};
+
+static const Case cases[] = {
+  {"o*", "..oo.", "0-0 1-1 2-4 5-5 "},
+  {"o*", "oo", "0-2 "},
+  {"o*", "", "0-0 "},
+  {"x*", "ab", "0-0 1-1 2-2 "},
+  {"o+", "..oo.o", "2-4 5-6 "},
+  {"a|b*", "abba", "0-1 1-3 3-4 "},
+  {"[0-9]*", "12ab3", "0-2 3-3 4-5 "},
+  {0, 0, 0}
+};
+
+int main() {
+  int errors = 0;
+  for (const Case *c = cases; c->pattern; c++) {
+    TextRegex regex(c->pattern);
+    TextBuffer buffer;
+    buffer.text(c->text);
+    found[0] = 0;
+    buffer.regex_search_all(0, buffer.length(), regex, found_cb, 0);
+    if (strcmp(found, c->matches)) {
+      printf("regex_search_all(\"%s\") in \"%s\" found %s, should be %s\n",
+	     c->pattern, c->text, found, c->matches);
+      errors++;
+    }
+    found[0] = 0;
+    int pos = 0;
+    while (buffer.regex_search_some(&pos, buffer.length(), regex,
+				    found_cb, 0, 2)) {}
+    if (strcmp(found, c->matches)) {
+      printf("regex_search_some(\"%s\") in \"%s\" found %s, should be %s\n",
+	     c->pattern, c->text, found, c->matches);
+      errors++;
+    }
+  }
+  if (!errors) printf("ok\n");
+  return errors != 0;
+}
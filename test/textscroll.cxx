@@ -0,0 +1,64 @@
+// Test of how long TextDisplay takes to redraw when it is scrolled.
+// Scrolls a text display down one line at a time, first redrawing all
+// the text each time as it was done before the text already drawn was
+// moved, then the normal way, and prints the time taken per scroll step
+// for each.
+
+#include <fltk/run.h>
+#include <fltk/Window.h>
+#include <fltk/TextDisplay.h>
+#include <fltk/TextBuffer.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace fltk;
+
+static void test(Window& window, TextDisplay& display, bool redraw_all,
+		 int steps) {
+  display.scroll(1, 0);
+  display.redraw();
+  while (window.damage()) fltk::wait();
+
+  double dt = get_time_secs();
+  for (int i = 0; i < steps; i++) {
+    display.scroll(i + 2, 0);
+    if (redraw_all) display.redraw();
+    fltk::flush();
+  }
+  dt = get_time_secs() - dt;
+  printf("%-14s %8.3f ms per step\n", redraw_all ? "redraw all" : "scroll",
+	 dt * 1000 / steps);
+}
+
+int main(int argc, char** argv) {
+  int m; int n = fltk::args(argc, argv, m);
+  int steps = n < argc ? atoi(argv[n]) : 1000;
+  if (n < argc - 1 || steps < 1) {
+    fprintf(stderr, "%s\nAdd the number of scroll steps, default is 1000\n",
+	    fltk::help);
+    exit(1);
+  }
+
+  TextBuffer buffer;
+  Window window(600, 800);
+  window.begin();
+  TextDisplay display(0, 0, 600, 800);
+  window.end();
+  window.resizable(display);
+
+  int lines = steps + 200;
+  char* text = (char*)malloc(lines * 80 + 1);
+  char* p = text;
+  for (int i = 0; i < lines; i++)
+    p += sprintf(p, "%6d The quick brown fox jumps over the lazy dog\n", i + 1);
+  buffer.text(text);
+  free(text);
+  display.buffer(buffer);
+
+  window.show(argc, argv);
+  while (window.damage()) fltk::wait();
+
+  test(window, display, true, steps);
+  test(window, display, false, steps);
+  return 0;
+}
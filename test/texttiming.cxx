@@ -0,0 +1,122 @@
+// Test of how fast TextBuffer is at editing very large buffers.
+// Fills a buffer with many megabytes of text and then inserts and
+// deletes at random positions, once for each storage type, then looks
+// up random line numbers, searches for a string and a regular
+// expression that are not there, and replaces a word on every line.
+// Finally writes the text to a file and times reading it back with
+// loadfile() and with mapfile().
+
+#include <fltk/TextBuffer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace fltk;
+
+static const char* storage_name(TextBuffer::Storage s) {
+  return s == TextBuffer::PIECE_TABLE ? "piece table" : "gap buffer";
+}
+
+static double seconds(clock_t start) {
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void test(TextBuffer::Storage storage, const char* text, int edits) {
+  TextBuffer buffer;
+  buffer.canUndo(0);
+  buffer.storage(storage);
+
+  clock_t start = clock();
+  buffer.text(text);
+  printf("%-12s load   %8.3f seconds\n", storage_name(storage), seconds(start));
+
+  srand(1);
+  start = clock();
+  for (int i = 0; i < edits; i++) {
+    int pos = int(rand() / (RAND_MAX + 1.0) * buffer.length());
+    if (i & 1)
+      buffer.remove(pos, pos + 10);
+    else
+      buffer.insert(pos, "0123456789");
+  }
+  double t = seconds(start);
+  printf("%-12s %d random edits %8.3f seconds (%.1f us per edit)\n",
+	 storage_name(storage), edits, t, t * 1e6 / edits);
+
+  start = clock();
+  int lines = buffer.count_lines(0, buffer.length());
+  printf("%-12s count %d lines %8.3f seconds\n",
+	 storage_name(storage), lines, seconds(start));
+
+  start = clock();
+  int sum = 0;
+  for (int i = 0; i < edits; i++) {
+    int line = int(rand() / (RAND_MAX + 1.0) * lines);
+    sum += buffer.position_to_line(buffer.line_to_position(line)) - line;
+  }
+  t = seconds(start);
+  printf("%-12s %d random line lookups %8.3f seconds (%.1f us each)%s\n",
+	 storage_name(storage), edits, t, t * 1e6 / edits,
+	 sum ? " WRONG" : "");
+
+  int pos;
+  start = clock();
+  bool found = buffer.search_forward(0, "lazy cat", &pos, true);
+  printf("%-12s search %s %8.3f seconds\n", storage_name(storage),
+	 found ? "found" : "missed", seconds(start));
+  start = clock();
+  found = buffer.search_forward(0, "LAZY CAT", &pos, false);
+  printf("%-12s search ignoring case %s %8.3f seconds\n", storage_name(storage),
+	 found ? "found" : "missed", seconds(start));
+
+  TextRegex regex("l[a-z]+y +cat");
+  int end;
+  start = clock();
+  found = buffer.regex_search_forward(0, buffer.length(), regex, &pos, &end);
+  printf("%-12s regex search %s %8.3f seconds\n", storage_name(storage),
+	 found ? "found" : "missed", seconds(start));
+
+  start = clock();
+  int n = buffer.replace_all(0, buffer.length(), "fox", "cat");
+  printf("%-12s replace %d %8.3f seconds\n", storage_name(storage), n,
+	 seconds(start));
+}
+
+int main(int argc, char** argv) {
+  if (argc > 3) {
+    fprintf(stderr, "usage: %s [megabytes [edits]]\n"
+	    " Default is a 500 megabyte buffer and 2000 edits\n", argv[0]);
+    exit(1);
+  }
+  int megabytes = argc > 1 ? atoi(argv[1]) : 500;
+  int edits = argc > 2 ? atoi(argv[2]) : 2000;
+
+  int length = megabytes * 1024 * 1024;
+  char* text = (char*)malloc(length + 1);
+  static const char line[] = "The quick brown fox jumps over the lazy dog\n";
+  for (int i = 0; i < length; i++) text[i] = line[i % (sizeof(line) - 1)];
+  text[length] = 0;
+
+  test(TextBuffer::GAP_BUFFER, text, edits);
+  test(TextBuffer::PIECE_TABLE, text, edits);
+
+  const char* file = "texttiming.tmp";
+  FILE* fp = fopen(file, "w");
+  if (fp) {
+    fwrite(text, 1, length, fp);
+    fclose(fp);
+    TextBuffer loaded, mapped;
+    loaded.canUndo(0);
+    clock_t start = clock();
+    loaded.loadfile(file);
+    printf("loadfile %8.3f seconds\n", seconds(start));
+    start = clock();
+    mapped.mapfile(file);
+    printf("mapfile  %8.3f seconds\n", seconds(start));
+    remove(file);
+  }
+
+  free(text);
+  return 0;
+}